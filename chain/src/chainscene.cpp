@@ -37,7 +37,7 @@ ChainScene::updateGraphicsObject (const NodeId qtnode)
             " - Executes any command-line program in a shell environment.\n"
             " - Shell variables can be passed in using the global variables panel.\n"
             " - When batch is checked, execution is deferred until all inputs are read.\n"
-            " - Batched inputs are concatenated into a single string.\n"
+            " - Batched inputs are sorted into a list file named by INPUT_LIST.\n"
             " - SANDBOX variable is set to the temp location created for each graph.\n"
             " - INPUT variable is set automatically for reference in the command field.\n"
             " - DIRNAME, FILENAME, STEM and EXT variables are defined for each input.\n"
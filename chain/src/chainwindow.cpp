@@ -852,7 +852,8 @@ ChainWindow::load()
 void
 ChainWindow::load (QString& filename)
 {
-    if (!filename.isEmpty()) {
+    // a refused graph leaves the open one as it is.
+    if (!filename.isEmpty() && model_->acceptGraph (filename)) {
         clearGraph();
         model_->loadGraph (filename);
         fitInView();
@@ -13,6 +13,50 @@
 #include <fstream>
 
 
+// node types the editor has a model for. The others (remote, subgraph, router, dirscan, dedup,
+// throttle, window, groupby, join, split) are left to hand-written graphs run with daisy.
+static bool
+has_model (daisychain::DaisyNodeType type)
+{
+    switch (type) {
+    case daisychain::DC_COMMANDLINE:
+    case daisychain::DC_FILTER:
+    case daisychain::DC_CONCAT:
+    case daisychain::DC_DISTRO:
+    case daisychain::DC_FILELIST:
+    case daisychain::DC_WATCH:
+        return true;
+    default:
+        return false;
+    }
+} // has_model
+
+
+// names the nodes of a graph the editor cannot show, so the load is refused instead of
+// dropping them and losing them on the next save.
+static QStringList
+unsupported_nodes (const json& json_graph)
+{
+    QStringList unsupported;
+
+    if (!json_graph.contains ("nodes")) {
+        return unsupported;
+    }
+
+    for (const auto& [id, data] : json_graph["nodes"].items()) {
+        auto type = data.value ("type", daisychain::DC_INVALID);
+        if (type != daisychain::DC_INVALID && has_model (type)) {
+            continue;
+        }
+
+        auto name = data.value ("name", id);
+        auto typestr = data.contains ("type") && data["type"].is_string() ? data["type"].get<string>() : "invalid";
+        unsupported << QString::fromStdString (name + " (" + typestr + ")");
+    }
+
+    return unsupported;
+} // unsupported_nodes
+
 
 GraphModel::GraphModel (std::shared_ptr<QtNodes::NodeDelegateModelRegistry> registry) :
     DataFlowGraphModel (std::move (registry)),
@@ -255,6 +299,10 @@ GraphModel::saveGraph (QString& filename)
 void
 GraphModel::loadGraphJSON (const json& json_graph)
 {
+    if (!acceptGraph (json_graph)) {
+        return;
+    }
+
     graph_->Parse (json_graph);
     Q_EMIT (clearSelection());
 
@@ -307,17 +355,26 @@ GraphModel::loadGraph (const QString& filename, bool import)
         return;
     }
 
-    if (import) {
-        std::ifstream filein (filename.toStdString());
+    std::ifstream filein (filename.toStdString());
+
+    if (!filein.is_open()) {
+        return;
+    }
+
+    json json_graph = json::parse (filein, nullptr, false);
+    filein.close();
+
+    // a file that does not parse is left to Initialize() to report.
+    if (!json_graph.is_discarded() && !acceptGraph (json_graph)) {
+        return;
+    }
 
-        if (!filein.is_open()) {
+    if (import) {
+        if (json_graph.is_discarded()) {
+            LERROR << "Cannot parse graph: " << filename.toStdString();
             return;
         }
 
-        json json_graph;
-        filein >> json_graph;
-        filein.close();
-
         graph_->Parse (json_graph);
         Q_EMIT (clearSelection());
     }
@@ -374,6 +431,41 @@ GraphModel::loadGraph (const QString& filename, bool import)
 } // GraphModel::loadGraph
 
 
+bool
+GraphModel::acceptGraph (const json& json_graph)
+{
+    auto unsupported = unsupported_nodes (json_graph);
+
+    if (unsupported.isEmpty()) {
+        return true;
+    }
+
+    LERROR << "Graph has nodes the editor cannot show: " << unsupported.join (", ").toStdString();
+    QMessageBox::warning (nullptr, tr ("Daisy"),
+                          tr ("This graph cannot be edited here, it has nodes of types the editor does not support:\n\n")
+                          + unsupported.join ("\n")
+                          + tr ("\n\nThe graph was not loaded. It can still be run with the daisy command."));
+
+    return false;
+} // GraphModel::acceptGraph
+
+
+bool
+GraphModel::acceptGraph (const QString& filename)
+{
+    std::ifstream filein (filename.toStdString());
+
+    if (!filein.is_open()) {
+        return true;
+    }
+
+    json json_graph = json::parse (filein, nullptr, false);
+
+    // a file that does not parse is left to loadGraph() to report.
+    return json_graph.is_discarded() || acceptGraph (json_graph);
+} // GraphModel::acceptGraph
+
+
 void
 GraphModel::emitAll()
 {
@@ -411,8 +503,6 @@ GraphModel::createNodeFromNode (const std::shared_ptr<daisychain::Node>& node)
         widget->findChild<QLineEdit*> ("_outputEdit")->setText (outputfile);
         widget->findChild<QCheckBox*> ("_batchChk")->setChecked (batch);
     } break;
-    case daisychain::DC_REMOTE:
-        return -1;
     case daisychain::DC_FILTER: {
         qtnode = addNode("Filter");
 
@@ -470,6 +560,10 @@ GraphModel::createNodeFromNode (const std::shared_ptr<daisychain::Node>& node)
     } break;
     case daisychain::DC_INVALID:
         return -1;
+    default:
+        // refused by acceptGraph() when loading; other callers get nothing to show.
+        LERROR << "No editor model for node type: " << daisychain::DaisyNodeNameByType[node->type()];
+        return -1;
     } // switch
 
     if (!datamodel) return -1;
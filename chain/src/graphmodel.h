@@ -49,6 +49,12 @@ public:
 
     int createNodeFromNode (const std::shared_ptr<daisychain::Node>&);
 
+    // false, with a message box, if the graph has nodes the editor has no model for.
+    bool acceptGraph (const json& json_graph);
+
+    // the same for a graph file, so a caller can keep the open graph when it is refused.
+    bool acceptGraph (const QString& filename);
+
     void emitAll();
 
     const std::string& input();
@@ -4,6 +4,9 @@
 // See LICENSE file for full license text.
 
 #include "graph.h"
+#include "signalhandler.h"
+#include "worker.h"
+#include <csignal>
 #include <iostream>
 #include <string>
 #include <tclap/CmdLine.h>
@@ -22,12 +25,16 @@ main (int argc, const char* argv[])
     bool use_stdinput = false;
     string loglevel;
     vector<string> input_files;
+    bool worker_mode = false;
+    int port = DAISY_WORKER_PORT;
+    string bind_address;
+    string secret_file;
 
     try {
         TCLAP::CmdLine cmd (
             "DaisyChain - node-based dependency graph for file processing.", ' ', DAISYCHAIN_VERSION);
         TCLAP::ValueArg<string> graph_arg (
-            "g", "graph", "DaisyChain graph file to execute.", true, "", "graph *.dcg", cmd);
+            "g", "graph", "DaisyChain graph file to execute.", false, "", "graph *.dcg", cmd);
         TCLAP::ValueArg<string> sandbox_arg (
             "s", "sandbox", "Working directory used for I/O and available as a shell"
                             " variable during execution ${SANDBOX}.", false, "",
@@ -39,6 +46,16 @@ main (int argc, const char* argv[])
         TCLAP::SwitchArg stdinput_arg ("", "stdin", "read from STDIN", cmd, false);
         TCLAP::ValueArg<string> loglevel_arg (
             "l", "loglevel", "off, info, warn, error, debug", false, "error", "level", cmd);
+        TCLAP::SwitchArg worker_arg (
+            "", "worker", "run as a worker agent for remote nodes", cmd, false);
+        TCLAP::ValueArg<int> port_arg (
+            "p", "port", "worker port", false, DAISY_WORKER_PORT, "port", cmd);
+        TCLAP::ValueArg<string> bind_arg (
+            "", "bind", "worker address to listen on", false, "127.0.0.1", "address", cmd);
+        TCLAP::ValueArg<string> secret_arg (
+            "", "secret-file", "file holding the worker's shared secret (default:"
+                               " $DAISY_WORKER_SECRET or $DAISY_WORKER_SECRET_FILE)", false, "",
+            "secret file", cmd);
         TCLAP::UnlabeledMultiArg<string> inputs_arg (
             "inputs", "Inputs (typically files).", false, "filename", cmd);
 
@@ -51,6 +68,10 @@ main (int argc, const char* argv[])
         use_stdinput = stdinput_arg.getValue();
         loglevel = loglevel_arg.getValue();
         input_files = inputs_arg.getValue();
+        worker_mode = worker_arg.getValue();
+        port = port_arg.getValue();
+        bind_address = bind_arg.getValue();
+        secret_file = secret_arg.getValue();
     }
     catch (TCLAP::ArgException& e) {
         std::cout << "error: " << e.error() << " for arg " << e.argId() << '\n';
@@ -58,6 +79,19 @@ main (int argc, const char* argv[])
 
     configureLogger (loglevel);
 
+    if (worker_mode) {
+        Worker worker (port, bind_address, m_worker_secret (secret_file));
+        sigint_handler = [&] (int signal) { worker.Stop(); };
+        signal (SIGINT, signal_handler);
+
+        return !worker.Run();
+    }
+
+    if (graph_file.empty()) {
+        std::cout << "error: a graph file is required (-g)\n";
+        return 1;
+    }
+
     string stdinput;
     if (use_stdinput) {
         for (std::string line; std::getline (std::cin, line);) {
@@ -0,0 +1,203 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+// Times Matcher against std::regex_match on a corpus of paths, one pattern at a time and
+// with all patterns in one Matcher, and checks that both find the same matches.
+//
+//   matcher_bench [paths.txt] [repeat]
+//
+// Without a file, 500k paths are generated from source-tree, render-output and log layouts;
+// `find / -xdev > paths.txt` gives a corpus from a real machine.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "matcher.h"
+
+
+using namespace std;
+using namespace daisychain;
+using Clock = std::chrono::steady_clock;
+
+
+static vector<string>
+generate_paths (size_t count)
+{
+    std::mt19937 rng (7433);
+    auto pick = [&rng] (const vector<string>& from) -> const string& { return from[rng() % from.size()]; };
+
+    const vector<string> users = {"alice", "bob", "render", "svc_build", "jparker"};
+    const vector<string> projects = {"daisychain", "pipeline", "compositor", "assetdb", "tools"};
+    const vector<string> modules = {"src", "include", "test", "docs", "third_party/zlib", "python/src"};
+    const vector<string> stems = {"graph", "node", "main", "utils", "parser", "reader", "writer", "cache"};
+    const vector<string> code = {".cpp", ".h", ".hpp", ".py", ".txt", ".md", ".o", ".json"};
+    const vector<string> shows = {"ABC", "XYZ", "demo"};
+    const vector<string> tasks = {"comp", "lighting", "fx", "anim", "plate"};
+    const vector<string> images = {".exr", ".dpx", ".jpg", ".tif"};
+    const vector<string> services = {"nginx", "postgresql", "daisy", "cron"};
+
+    vector<string> paths;
+    paths.reserve (count);
+    char buffer[64];
+
+    while (paths.size() < count) {
+        switch (rng() % 3) {
+        case 0:
+            paths.push_back ("/home/" + pick (users) + "/projects/" + pick (projects) + "/" + pick (modules)
+                             + "/" + pick (stems) + std::to_string (rng() % 40) + pick (code));
+            break;
+        case 1:
+            std::snprintf (buffer, sizeof (buffer), "sq%03u/sh%04u/%s/v%03u/", rng() % 50 * 10,
+                           rng() % 100 * 10, pick (tasks).c_str(), rng() % 30 + 1);
+            paths.push_back ("/mnt/shows/" + pick (shows) + "/shots/" + buffer + "frame."
+                             + std::to_string (1001 + rng() % 240) + pick (images));
+            break;
+        default:
+            std::snprintf (buffer, sizeof (buffer), "%04u-%02u-%02u", 2020 + rng() % 6, rng() % 12 + 1,
+                           rng() % 28 + 1);
+            paths.push_back ("/var/log/" + pick (services) + "/" + buffer + (rng() % 2 ? ".log" : ".log.gz"));
+            break;
+        }
+    }
+
+    return paths;
+} // generate_paths
+
+
+template <typename F>
+static double
+best_of (int repeat, F&& run)
+{
+    double best = 0.0;
+
+    for (int i = 0; i < repeat; ++i) {
+        auto start = Clock::now();
+        run();
+        double seconds = std::chrono::duration<double> (Clock::now() - start).count();
+        best = i == 0 ? seconds : std::min (best, seconds);
+    }
+
+    return best;
+} // best_of
+
+
+int
+main (int argc, char* argv[])
+{
+    vector<string> paths;
+
+    if (argc > 1) {
+        std::ifstream file (argv[1]);
+        for (string line; std::getline (file, line);) {
+            paths.push_back (std::move (line));
+        }
+    }
+    else {
+        paths = generate_paths (500000);
+    }
+
+    int repeat = argc > 2 ? std::max (1, std::atoi (argv[2])) : 3;
+
+    const vector<string> patterns = {
+        R"(.*\.cpp)",
+        R"(.*/src/.*\.(cpp|h))",
+        R"(/home/[a-z_]+/projects/[^/]+/test/.*)",
+        R"(.*/sq\d{3}/sh\d{4}/comp/v\d+/frame\.\d{4}\.exr)",
+        R"(.*\.(exr|dpx|tif))",
+        R"(/var/log/(nginx|daisy)/\d{4}-\d{2}-\d{2}\.log(\.gz)?)",
+        R"(.*(parser|reader)[0-9]+\.(h|hpp))",
+        R"([^.]*)",
+        // escapes std::regex handles on its own, which the literal prefilter must not misread.
+        R"(.*\x2ecpp)",
+        R"(.*/frame\.\d{4}\u002eexr)",
+        R"(/var/log/.*\x67z)",
+        R"(.*\cJ)",
+    };
+
+    std::cout << paths.size() << " paths, best of " << repeat << "\n\n";
+    std::printf ("%-56s %10s %10s %8s %8s\n", "pattern", "std::regex", "Matcher", "speedup", "matches");
+
+    bool agree = true;
+    double regex_total = 0.0;
+    double matcher_total = 0.0;
+
+    for (const auto& pattern : patterns) {
+        std::regex expr (pattern);
+        Matcher matcher;
+        matcher.Add (pattern, true);
+
+        size_t expected = 0;
+        size_t found = 0;
+
+        double regex_time = best_of (repeat, [&] {
+            expected = 0;
+            for (const auto& path : paths) {
+                expected += std::regex_match (path, expr);
+            }
+        });
+
+        double matcher_time = best_of (repeat, [&] {
+            found = 0;
+            for (const auto& path : paths) {
+                found += matcher.First (path) == 0;
+            }
+        });
+
+        agree = agree && expected == found;
+        regex_total += regex_time;
+        matcher_total += matcher_time;
+
+        std::printf ("%-56s %9.3fs %9.3fs %7.1fx %8zu%s\n", pattern.c_str(), regex_time, matcher_time,
+                     regex_time / matcher_time, found, expected == found ? "" : "  MISMATCH");
+    }
+
+    // every pattern at once, as a router with one rule per pattern sees it.
+    vector<std::regex> exprs;
+    Matcher all;
+
+    for (const auto& pattern : patterns) {
+        exprs.emplace_back (pattern);
+        all.Add (pattern, true);
+    }
+
+    size_t expected = 0;
+    size_t found = 0;
+    vector<size_t> matches;
+
+    double regex_time = best_of (repeat, [&] {
+        expected = 0;
+        for (const auto& path : paths) {
+            for (const auto& expr : exprs) {
+                expected += std::regex_match (path, expr);
+            }
+        }
+    });
+
+    double matcher_time = best_of (repeat, [&] {
+        found = 0;
+        for (const auto& path : paths) {
+            matches.clear();
+            all.Match (path, matches);
+            found += matches.size();
+        }
+    });
+
+    agree = agree && expected == found;
+
+    std::printf ("%-56s %9.3fs %9.3fs %7.1fx %8zu%s\n", "(all patterns, one Matcher)", regex_time, matcher_time,
+                 regex_time / matcher_time, found, expected == found ? "" : "  MISMATCH");
+    std::printf ("%-56s %9.3fs %9.3fs %7.1fx\n", "(sum of single patterns)", regex_total, matcher_total,
+                 regex_total / matcher_total);
+
+    return agree ? 0 : 1;
+} // main
@@ -0,0 +1,289 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "batchspool.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <thread>
+#include "logger.h"
+#include "token.h"
+
+
+// most runs read by one merge; each holds a read buffer of IO_BUFFER_SIZE.
+#define MERGE_FAN_IN 64
+
+#define IO_BUFFER_SIZE (256 * 1024)
+
+
+namespace daisychain {
+using namespace std;
+
+
+namespace {
+// a file stream with a larger buffer than the default.
+template <typename Stream>
+struct BufferedStream
+{
+    explicit BufferedStream (const string& path, std::ios::openmode mode) :
+        buffer (new char[IO_BUFFER_SIZE])
+    {
+        stream.rdbuf()->pubsetbuf (buffer.get(), IO_BUFFER_SIZE);
+        stream.open (path, mode);
+    }
+
+    std::unique_ptr<char[]> buffer;
+    Stream stream;
+};
+} // namespace
+
+
+BatchSpool::BatchSpool (const string& directory, const string& prefix, size_t budget) :
+    path_ (directory + "/" + prefix + ".batch"),
+    // one buffer fills while the one before it is written out.
+    budget_ (std::max<size_t> (budget / 2, 1))
+{
+}
+
+
+BatchSpool::~BatchSpool()
+{
+    wait_();
+
+    std::error_code ec;
+    for (const auto& run : runs_) {
+        std::filesystem::remove (run, ec);
+    }
+}
+
+
+void
+BatchSpool::Add (string token)
+{
+    // a batch is a list of paths; attributes do not survive it.
+    token.resize (token_path (token).size());
+
+    buffered_ += token.size() + sizeof (string);
+    buffer_.push_back (std::move (token));
+    ++count_;
+
+    if (buffered_ >= budget_) {
+        spill_();
+    }
+} // BatchSpool::Add
+
+
+bool
+BatchSpool::Finish()
+{
+    if (runs_.empty()) {
+        // the whole batch fit in memory.
+        std::sort (buffer_.begin(), buffer_.end());
+        failed_ = !write_ (buffer_, path_) || failed_;
+        buffer_.clear();
+        buffered_ = 0;
+
+        return !failed_;
+    }
+
+    if (!buffer_.empty()) {
+        spill_();
+    }
+
+    if (!wait_()) {
+        return false;
+    }
+
+    // a run that failed to write is missing tokens; keep the runs for the destructor.
+    if (failed_) {
+        return false;
+    }
+
+    // merge passes until one merge can take every run.
+    while (runs_.size() > MERGE_FAN_IN) {
+        vector<vector<string>> groups;
+        vector<string> merged;
+
+        for (size_t i = 0; i < runs_.size(); i += MERGE_FAN_IN) {
+            auto end = std::min (i + MERGE_FAN_IN, runs_.size());
+            groups.emplace_back (runs_.begin() + long (i), runs_.begin() + long (end));
+            merged.push_back (run_path_());
+        }
+
+        auto workers = std::max<size_t> (std::thread::hardware_concurrency(), 1);
+
+        for (size_t i = 0; i < groups.size(); i += workers) {
+            vector<std::future<bool>> pending;
+
+            for (size_t j = i; j < std::min (i + workers, groups.size()); ++j) {
+                pending.push_back (std::async (std::launch::async, merge_, std::cref (groups[j]),
+                                               std::cref (merged[j])));
+            }
+
+            for (auto& result : pending) {
+                failed_ = !result.get() || failed_;
+            }
+        }
+
+        // runs of a failed pass are kept so the destructor removes them.
+        if (failed_) {
+            for (const auto& group : groups) {
+                merged.insert (merged.end(), group.begin(), group.end());
+            }
+        }
+
+        runs_.swap (merged);
+
+        if (failed_) {
+            return false;
+        }
+    }
+
+    if (!merge_ (runs_, path_)) {
+        return false;
+    }
+
+    runs_.clear();
+
+    return true;
+} // BatchSpool::Finish
+
+
+bool
+BatchSpool::Read (const string& path, vector<string>& tokens)
+{
+    BufferedStream<std::ifstream> input (path, std::ios::in | std::ios::binary);
+
+    if (!input.stream) {
+        LERROR << "Cannot open batch list: " << path;
+        return false;
+    }
+
+    string line;
+    while (std::getline (input.stream, line)) {
+        tokens.push_back (line);
+    }
+
+    return true;
+} // BatchSpool::Read
+
+
+void
+BatchSpool::spill_()
+{
+    // at most one run is written at a time, which bounds memory to two buffers.
+    failed_ = !wait_() || failed_;
+
+    auto path = run_path_();
+    runs_.push_back (path);
+    ++spilled_;
+
+    spilling_ = std::async (std::launch::async, [tokens = std::move (buffer_), path]() mutable {
+        std::sort (tokens.begin(), tokens.end());
+        return write_ (tokens, path);
+    });
+
+    buffer_ = vector<string>();
+    buffered_ = 0;
+} // BatchSpool::spill_
+
+
+bool
+BatchSpool::wait_()
+{
+    if (!spilling_.valid()) {
+        return true;
+    }
+
+    return spilling_.get();
+} // BatchSpool::wait_
+
+
+bool
+BatchSpool::merge_ (const vector<string>& inputs, const string& output)
+{
+    vector<std::unique_ptr<BufferedStream<std::ifstream>>> readers;
+
+    for (const auto& input : inputs) {
+        readers.push_back (std::make_unique<BufferedStream<std::ifstream>> (input, std::ios::in | std::ios::binary));
+
+        if (!readers.back()->stream) {
+            LERROR << "Cannot open batch run: " << input;
+            return false;
+        }
+    }
+
+    BufferedStream<std::ofstream> writer (output, std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (!writer.stream) {
+        LERROR << "Cannot write batch list: " << output;
+        return false;
+    }
+
+    // smallest head first; each run holds one line in the heap.
+    using Head = pair<string, size_t>;
+    std::priority_queue<Head, vector<Head>, std::greater<>> heads;
+
+    for (size_t i = 0; i < readers.size(); ++i) {
+        string line;
+        if (std::getline (readers[i]->stream, line)) {
+            heads.emplace (std::move (line), i);
+        }
+    }
+
+    while (!heads.empty()) {
+        auto head = std::move (const_cast<Head&> (heads.top()));
+        heads.pop();
+
+        writer.stream << head.first << '\n';
+
+        if (std::getline (readers[head.second]->stream, head.first)) {
+            heads.push (std::move (head));
+        }
+    }
+
+    writer.stream.flush();
+    bool stat = bool (writer.stream);
+    LERROR_IF (!stat) << "Cannot write batch list: " << output;
+
+    readers.clear();
+
+    std::error_code ec;
+    for (const auto& input : inputs) {
+        std::filesystem::remove (input, ec);
+    }
+
+    return stat;
+} // BatchSpool::merge_
+
+
+bool
+BatchSpool::write_ (vector<string>& tokens, const string& output)
+{
+    BufferedStream<std::ofstream> writer (output, std::ios::out | std::ios::binary | std::ios::trunc);
+
+    for (const auto& token : tokens) {
+        writer.stream << token << '\n';
+    }
+
+    writer.stream.flush();
+
+    if (!writer.stream) {
+        LERROR << "Cannot write batch list: " << output;
+        return false;
+    }
+
+    return true;
+} // BatchSpool::write_
+
+
+string
+BatchSpool::run_path_()
+{
+    return path_ + "." + std::to_string (named_++);
+} // BatchSpool::run_path_
+} // namespace daisychain
@@ -0,0 +1,81 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include <future>
+#include <string>
+#include <vector>
+
+
+namespace daisychain {
+using namespace std;
+
+
+// Collects the tokens of a batch in bounded memory and hands them back sorted, one per line, in
+// a list file. Tokens are held in memory up to the budget; past it, they are sorted and written
+// out as a run on a background thread while collection goes on, and the runs are merged at the
+// end. Merges take up to MERGE_FAN_IN runs at a time; wider merges are done in passes whose
+// groups merge in parallel.
+//
+// Tokens are added by their path; their attributes are dropped.
+//
+// Runs and the list go in directory, named after prefix. Runs are removed as they are merged;
+// the list stays until its owner removes it.
+class BatchSpool
+{
+public:
+    BatchSpool (const string& directory, const string& prefix, size_t budget);
+
+    ~BatchSpool();
+
+    BatchSpool (const BatchSpool&) = delete;
+
+    BatchSpool& operator= (const BatchSpool&) = delete;
+
+    void Add (string token);
+
+    // sorts everything added into path(); false if a file could not be written.
+    bool Finish();
+
+    [[nodiscard]] const string& path() const { return path_; }
+
+    // tokens added.
+    [[nodiscard]] size_t size() const { return count_; }
+
+    // runs written to disk; 0 when the batch fit in memory.
+    [[nodiscard]] size_t runs() const { return spilled_; }
+
+    // reads the tokens of a list file into tokens.
+    static bool Read (const string& path, vector<string>& tokens);
+
+private:
+    // sorts the buffer and writes it as the next run, in the background.
+    void spill_();
+
+    // false if the run being written failed.
+    bool wait_();
+
+    // merges sorted files into output, removing them.
+    static bool merge_ (const vector<string>& inputs, const string& output);
+
+    static bool write_ (vector<string>& tokens, const string& output);
+
+    string run_path_();
+
+    string path_;
+    size_t budget_;
+
+    vector<string> buffer_;
+    size_t buffered_ = 0;
+
+    vector<string> runs_;
+    std::future<bool> spilling_;
+    size_t spilled_ = 0;
+    size_t named_ = 0;
+    size_t count_ = 0;
+    bool failed_ = false;
+};
+} // namespace daisychain
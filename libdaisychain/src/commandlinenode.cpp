@@ -4,15 +4,27 @@
 // See LICENSE file for full license text.
 
 #include "commandlinenode.h"
+#include <cctype>
 #include <cstdlib>
+#include <fstream>
 #include <utility>
 
 
+// longest batch exported as INPUT; a longer variable cannot be passed to a child process
+// (MAX_ARG_STRLEN on Linux, 32767 characters on Windows). ${INPUT_LIST} has every batch.
+#ifdef _WIN32
+#define MAX_BATCH_INPUT 32000
+#else
+#define MAX_BATCH_INPUT 131000
+#endif
+
+
 namespace daisychain {
 using namespace std;
 
 
-CommandLineNode::CommandLineNode()
+CommandLineNode::CommandLineNode() :
+    batch_input_ ("env")
 {
     type_ = DaisyNodeType::DC_COMMANDLINE;
     set_name (DaisyNodeNameByType[type_]);
@@ -20,7 +32,8 @@ CommandLineNode::CommandLineNode()
 
 
 CommandLineNode::CommandLineNode (string cmd) :
-    command_ (std::move (cmd))
+    command_ (std::move (cmd)),
+    batch_input_ ("env")
 {
     type_ = DaisyNodeType::DC_COMMANDLINE;
     set_name (DaisyNodeNameByType[type_]);
@@ -40,6 +53,13 @@ CommandLineNode::Initialize (json& keydata, bool keep_uuid)
     set_command (data["command"]);
     set_outputfile (data.count ("outputfile") ? data["outputfile"] : "");
     set_batch_flag (data.count ("batch") != 0 && data["batch"].get<bool>());
+
+    if (data.count ("batch_memory")) {
+        set_batch_memory (data["batch_memory"].get<size_t>());
+    }
+
+    set_batch_input (data.count ("batch_input") ? data["batch_input"].get<string>() : "env");
+    set_attributes (data.count ("attributes") ? data["attributes"] : json::object());
 }
 
 
@@ -54,24 +74,33 @@ CommandLineNode::Execute (vector<string>& inputs, const string& sandbox, json& e
 
     bool stat = true;
 
-#ifndef _WIN32
-    // prepare the shell environment
-    for (auto& [key, value] : env.items()) {
-        if (setenv (key.c_str(), shell_expand (value.get<string>()).c_str(), true) < 0)
-            return false;
-    }
-#else
-    // prepare the shell environment
-    for (auto& [key, value] : env.items()) {
-        set_variable (key, value.get<string>());
+    if (!set_environment (env))
+        return false;
+
+    if (batch_ && batch_input_ != "env" && batch_input_ != "list" && batch_input_ != "stdin") {
+        LERROR << LOGNODE << "Unknown batch input: " << batch_input_;
+        CloseInputs();
+        OpenOutputs (sandbox);
+        WriteOutputs ("EOF");
+        CloseOutputs();
+        Reset();
+
+        return false;
     }
-#endif
 
     // root nodes are passed a single string of all inputs and these
     // inputs may need to be tokenized if batch == false.
     if (isroot_) {
         if (batch_) {
-            concat_inputs (inputs);
+            BatchSpool spool (sandbox, id_, batch_memory_);
+
+            for (auto& input : inputs) {
+                if (input != "EOF") {
+                    spool.Add (std::move (input));
+                }
+            }
+
+            stat = finish_batch_ (spool, inputs);
         }
 
         for (auto& input : inputs) {
@@ -128,8 +157,18 @@ CommandLineNode::Serialize()
     auto json_ = Node::Serialize();
     json_[id_]["command"] = command_;
     json_[id_]["batch"] = batch_;
+
+    if (batch_) {
+        json_[id_]["batch_memory"] = batch_memory_;
+        json_[id_]["batch_input"] = batch_input_;
+    }
+
     json_[id_]["outputfile"] = outputfile_;
 
+    if (!attributes_.empty()) {
+        json_[id_]["attributes"] = attributes_;
+    }
+
     if (size_ != std::pair<int, int>(0,0)) {json_[id_]["size"] = size_;}
 
     return json_;
@@ -150,6 +189,154 @@ CommandLineNode::command()
 } // CommandLineNode::command
 
 
+void
+CommandLineNode::set_batch_input (const string& delivery)
+{
+    batch_input_ = delivery;
+} // CommandLineNode::set_batch_input
+
+
+string
+CommandLineNode::batch_input() const
+{
+    return batch_input_;
+} // CommandLineNode::batch_input
+
+
+void
+CommandLineNode::set_attributes (const json& attributes)
+{
+    attributes_ = attributes.is_object() ? attributes : json::object();
+} // CommandLineNode::set_attributes
+
+
+json
+CommandLineNode::attributes() const
+{
+    return attributes_;
+} // CommandLineNode::attributes
+
+
+void
+CommandLineNode::set_attributes_ (const string& input, vector<string>& outputs)
+{
+    if (!has_attributes (input) && attributes_.empty()) {
+        return;
+    }
+
+    // outputs derived from the input keep its attributes unless they set their own.
+    for (auto& output : outputs) {
+        if (output == input) {
+            continue;
+        }
+
+        for_each_attribute (input, [&output] (std::string_view name, std::string_view value) {
+            std::string_view own;
+
+            if (!token_attribute (output, name, own)) {
+                set_token_attribute (output, name, value);
+            }
+        });
+    }
+
+    for (auto& [name, expression] : attributes_.items()) {
+        if (!expression.is_string()) {
+            continue;
+        }
+
+        auto value = shell_expand (expression.get<string>());
+
+        for (auto& output : outputs) {
+            set_token_attribute (output, name, value);
+        }
+    }
+} // CommandLineNode::set_attributes_
+
+
+string
+CommandLineNode::attribute_variable_ (std::string_view name)
+{
+    string variable = "ATTR_";
+
+    for (auto c : name) {
+        variable += std::isalnum ((unsigned char) c) ? c : '_';
+    }
+
+    return variable;
+} // CommandLineNode::attribute_variable_
+
+
+bool
+CommandLineNode::read_batch_ (const string& list, string& tokens)
+{
+    tokens.clear();
+
+    std::error_code ec;
+    auto size = fs::file_size (list, ec);
+
+    if (ec) {
+        LERROR << LOGNODE << "Cannot read batch list: " << list;
+        return false;
+    }
+
+    // running the command with an empty INPUT would succeed on no data.
+    if (size > MAX_BATCH_INPUT) {
+        LERROR << LOGNODE << "Batch of " << size << " bytes is too large for INPUT; use INPUT_LIST, "
+               << "or batch_input \"list\" or \"stdin\".";
+        return false;
+    }
+
+    std::ifstream stream (list, std::ios::in | std::ios::binary);
+    tokens.assign (std::istreambuf_iterator<char> (stream), std::istreambuf_iterator<char>());
+
+    if (!tokens.empty() && tokens.back() == '\n') {
+        tokens.pop_back();
+    }
+
+    return true;
+} // CommandLineNode::read_batch_
+
+
+void
+CommandLineNode::write_list_ (const string& list)
+{
+    std::ifstream stream (list, std::ios::in | std::ios::binary);
+    vector<string> tokens;
+    string line;
+
+    while (std::getline (stream, line)) {
+        tokens.push_back (std::move (line));
+
+        if (tokens.size() == 4096) {
+            WriteTokens (tokens);
+            tokens.clear();
+        }
+    }
+
+    WriteTokens (tokens);
+} // CommandLineNode::write_list_
+
+
+bool
+CommandLineNode::set_environment (json& env)
+{
+#ifndef _WIN32
+    // prepare the shell environment
+    for (auto& [key, value] : env.items()) {
+        if (setenv (key.c_str(), shell_expand (value.get<string>()).c_str(), true) < 0)
+            return false;
+    }
+#else
+    // prepare the shell environment
+    for (auto& [key, value] : env.items()) {
+        set_variable (key, value.get<string>());
+    }
+#endif
+
+    return true;
+} // CommandLineNode::set_environment
+
+
 #ifdef _WIN32
 #include <windows.h>
 #include <string>
@@ -160,32 +347,81 @@ namespace fs = std::filesystem;
 
 bool
 CommandLineNode::run_command (const std::string& input, const std::string& sandbox)
+{
+    // a cancelled run only passes EOF along.
+    if (cancelled_.load())
+        return true;
+
+    set_variable ("SANDBOX", sandbox);
+
+    std::vector<std::string> outputs;
+    bool stat = Process (input, outputs);
+
+    // a batch passes its tokens on rather than the path of its list.
+    if (stat && batch_ && outputfile_.empty()) {
+        write_list_ (input);
+        return stat;
+    }
+
+    for (const auto& output : outputs) {
+        WriteOutputs (output);
+    }
+
+    return stat;
+} // CommandLineNode::run_command
+
+
+bool
+CommandLineNode::Process (const std::string& input, std::vector<std::string>& outputs)
 {
     // Set up variables
     bool stat = false;
     bool use_std_out = false;
+    std::string scratch;
+    const auto& path = token_path (input, scratch);
     std::string output = input;
 
-    set_variable ("SANDBOX", sandbox);
-
     if (!batch_) {
-        auto dirname = fs::path(input).parent_path().string();
-        set_variable ("DIRNAME", dirname);
-        auto filename = fs::path(input).filename().string();
-        set_variable ("FILENAME", filename);
-        auto stem = fs::path(input).stem().string();
-        set_variable ("STEM", stem);
-        auto extension = fs::path(input).extension().string();
-        set_variable ("EXT", extension);
-        set_variable ("INPUT", input);
+        fs::path file (path);
+        set_variable ("DIRNAME", file.parent_path().string());
+        set_variable ("FILENAME", file.filename().string());
+        set_variable ("STEM", file.stem().string());
+        set_variable ("EXT", file.extension().string());
+        set_variable ("INPUT", path);
     }
     else {
+        // input is the batch's sorted list; with env delivery INPUT holds the tokens too, and
+        // a batch too large for it fails the node.
+        set_variable ("INPUT_LIST", input);
+
+        std::string input_;
+        if (batch_input_ == "env" && !read_batch_ (input, input_)) {
+            return false;
+        }
+
         // Replace newline delimiters with spaces before shell expansion
-        std::string input_ = input;
         std::ranges::replace (input_, '\n', ' ');
         set_variable ("INPUT", input_);
     }
 
+    // the previous token's attributes must not leak into this one.
+    for (const auto& name : exported_) {
+        environment_.erase (name);
+    }
+
+    exported_.clear();
+
+    for_each_attribute (input, [this] (std::string_view name, std::string_view value) {
+        exported_.push_back (attribute_variable_ (name));
+        set_variable (exported_.back(), std::string (value));
+
+        // the byte range of a split file also goes by its own name.
+        if (name == "chunk_offset" || name == "chunk_length") {
+            exported_.push_back (name == "chunk_offset" ? "CHUNK_OFFSET" : "CHUNK_LENGTH");
+            set_variable (exported_.back(), std::string (value));
+        }
+    });
+
     if (!outputfile_.empty()) {
         if (outputfile_.find ("STDOUT") != std::string::npos) {
             use_std_out = true;
@@ -193,6 +429,7 @@ CommandLineNode::run_command (const std::string& input, const std::string& sandb
         else {
             output = shell_expand (outputfile_);
             set_variable ("OUTPUT", output);
+            output += token_attributes (input);
         }
     }
 
@@ -200,9 +437,8 @@ CommandLineNode::run_command (const std::string& input, const std::string& sandb
 
     if (test_) {
         LTEST << LOGNODE << "\n" << expanded_command_;
-        OpenOutputs (sandbox);
-        WriteOutputs (output);
-        CloseOutputs();
+        outputs.push_back (output);
+        set_attributes_ (input, outputs);
         return true;
     }
 
@@ -210,7 +446,7 @@ CommandLineNode::run_command (const std::string& input, const std::string& sandb
     LDEBUG << LOGNODE << "Executing command line: " << expanded_command_;
 
     std::string std_out;
-    stat = create_process (command_, std_out);
+    stat = create_process (command_, std_out, batch_ && batch_input_ == "stdin" ? input : "");
 
     // Log the output from the child process
     if (!std_out.empty()) {
@@ -224,49 +460,105 @@ CommandLineNode::run_command (const std::string& input, const std::string& sandb
         LDEBUG << LOGNODE << "run_command succeeded.";
 
         if (use_std_out) {
-            std::vector<std::string> tokens;
             set_variable ("STDOUT", std_out);
             output = shell_expand (outputfile_);
-            m_split_input (output, tokens);
-
-            for (const auto& token : tokens) {
-                WriteOutputs (token);
-            }
+            m_split_input (output, outputs);
         } else {
-            WriteOutputs (output);
+            outputs.push_back (output);
         }
+
+        set_attributes_ (input, outputs);
     }
 
     return stat;
-} // CommandLineNode::run_command
+} // CommandLineNode::Process
 
 #else
 
 bool
 CommandLineNode::run_command (const string& input, const string& sandbox)
+{
+    // a cancelled run only passes EOF along.
+    if (cancelled_.load())
+        return true;
+
+    vector<string> outputs;
+    bool stat = Process (input, outputs);
+
+    if (stat) {
+        OpenOutputs (sandbox);
+
+        // a batch passes its tokens on rather than the path of its list.
+        if (batch_ && outputfile_.empty()) {
+            write_list_ (input);
+        }
+        else {
+            for (auto const& output : outputs) {
+                WriteOutputs (output);
+            }
+        }
+
+        CloseOutputs();
+    }
+
+    return stat;
+} // CommandLineNode::run_command
+
+
+bool
+CommandLineNode::Process (const string& input, vector<string>& outputs)
 {
     //setbuf (stdout, nullptr);
     bool stat = false;
     bool use_std_out = false;
     string std_out;
-    vector<string> tokens;
 
+    string scratch;
+    const auto& path = token_path (input, scratch);
     auto output = input;
 
-    if (setenv ("INPUT", shell_expand (input).c_str(), true) < 0)
+    if (batch_) {
+        // input is the batch's sorted list; with env delivery INPUT holds the tokens too, and
+        // a batch too large for it fails the node.
+        if (setenv ("INPUT_LIST", input.c_str(), true) < 0)
+            return false;
+
+        string tokens;
+        if (batch_input_ == "env" && !read_batch_ (input, tokens))
+            return false;
+
+        if (setenv ("INPUT", tokens.empty() ? "" : shell_expand (tokens).c_str(), true) < 0)
+            return false;
+    }
+    else if (setenv ("INPUT", shell_expand (path).c_str(), true) < 0)
         return false;
 
     if (!batch_) {
-        auto dirname = fs::path(input).parent_path().c_str();
-        setenv ("DIRNAME", dirname, true);
-        auto filename = fs::path(input).filename().c_str();
-        setenv ("FILENAME", filename, true);
-        auto stem = fs::path(input).stem().c_str();
-        setenv ("STEM", stem, true);
-        auto extension = fs::path(input).extension().c_str();
-        setenv ("EXT", extension, true);
+        fs::path file (path);
+        setenv ("DIRNAME", file.parent_path().c_str(), true);
+        setenv ("FILENAME", file.filename().c_str(), true);
+        setenv ("STEM", file.stem().c_str(), true);
+        setenv ("EXT", file.extension().c_str(), true);
+    }
+
+    // the previous token's attributes must not leak into this one.
+    for (const auto& name : exported_) {
+        unsetenv (name.c_str());
     }
 
+    exported_.clear();
+
+    for_each_attribute (input, [this] (std::string_view name, std::string_view value) {
+        exported_.push_back (attribute_variable_ (name));
+        setenv (exported_.back().c_str(), string (value).c_str(), true);
+
+        // the byte range of a split file also goes by its own name.
+        if (name == "chunk_offset" || name == "chunk_length") {
+            exported_.push_back (name == "chunk_offset" ? "CHUNK_OFFSET" : "CHUNK_LENGTH");
+            setenv (exported_.back().c_str(), string (value).c_str(), true);
+        }
+    });
+
     if (!outputfile_.empty()) {
         if (outputfile_.find ("STDOUT") != string::npos) {
             use_std_out = true;
@@ -274,14 +566,14 @@ CommandLineNode::run_command (const string& input, const string& sandbox)
         else {
             output = shell_expand (outputfile_);
             setenv ("OUTPUT", output.c_str(), true);
+            output += token_attributes (input);
         }
     }
 
     if (test_) {
         LTEST << LOGNODE << "\n" << shell_expand (command_);
-        OpenOutputs (sandbox);
-        WriteOutputs (output);
-        CloseOutputs();
+        outputs.push_back (output);
+        set_attributes_ (input, outputs);
 
         return true;
     }
@@ -289,6 +581,11 @@ CommandLineNode::run_command (const string& input, const string& sandbox)
     // setting IFS explicitly to newline-only facilitates handling paths with spaces.
     // redirecting stderr to stdout for log capture.
     string cmd = "IFS=\"\n\";" + command_ + " 2>&1";
+
+    // the child reads the batch straight from its list.
+    if (batch_ && batch_input_ == "stdin") {
+        cmd = "IFS=\"\n\";{ " + command_ + "\n} < \"$INPUT_LIST\" 2>&1";
+    }
     FILE* fp = popen (cmd.c_str(), "r");
 
     if (fp == nullptr) {
@@ -320,32 +617,27 @@ CommandLineNode::run_command (const string& input, const string& sandbox)
             LDEBUG << LOGNODE << '\n' << std_out;
         }
 
-        OpenOutputs (sandbox);
-
         // capture program output and use for output var.
         if (use_std_out) {
             setenv ("STDOUT", std_out.c_str(), true);
             output = shell_expand (outputfile_);
-            m_split_input (output, tokens);
-
-            for (auto const& token : tokens) {
-                WriteOutputs (token);
-            }
+            m_split_input (output, outputs);
         }
         else {
-            WriteOutputs (output);
+            outputs.push_back (output);
         }
-        CloseOutputs();
+
+        set_attributes_ (input, outputs);
     }
 
     return stat;
-} // CommandLineNode::run_command
+} // CommandLineNode::Process
 #endif
 
 #ifdef _WIN32
 
 bool
-CommandLineNode::create_process (const std::string& command, std::string& output)
+CommandLineNode::create_process (const std::string& command, std::string& output, const std::string& input)
 {
     std::string pipename = R"(\\.\pipe\)" + name_ + "_" + id_;
     std::string cmd = "cmd.exe /V:ON /S /C \"call " + command + "\"";
@@ -405,18 +697,43 @@ CommandLineNode::create_process (const std::string& command, std::string& output
         return false;
     }
 
-    HANDLE inherited_handles[] = {write_handle};
+    // the child reads its stdin straight from the batch list when one is given.
+    HANDLE input_handle = nullptr;
+
+    if (!input.empty()) {
+        input_handle = CreateFileA (input.c_str(),
+                                    GENERIC_READ,
+                                    FILE_SHARE_READ,
+                                    &sa,
+                                    OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                                    nullptr);
+
+        if (input_handle == INVALID_HANDLE_VALUE) {
+            LERROR << LOGNODE << "Failed to open batch list for STDIN. " << GetLastError();
+            DeleteProcThreadAttributeList (si.lpAttributeList);
+            HeapFree (GetProcessHeap(), 0, si.lpAttributeList);
+            CloseHandle (read_handle);
+            CloseHandle (write_handle);
+            return false;
+        }
+    }
+
+    HANDLE inherited_handles[] = {write_handle, input_handle};
     if (!UpdateProcThreadAttribute (si.lpAttributeList,
                                     0,
                                     PROC_THREAD_ATTRIBUTE_HANDLE_LIST,
                                     inherited_handles,
-                                    sizeof (inherited_handles),
+                                    input_handle ? sizeof (inherited_handles) : sizeof (HANDLE),
                                     nullptr,
                                     nullptr)) {
         DeleteProcThreadAttributeList (si.lpAttributeList);
         HeapFree (GetProcessHeap(), 0, si.lpAttributeList);
         CloseHandle (read_handle);
         CloseHandle (write_handle);
+        if (input_handle) {
+            CloseHandle (input_handle);
+        }
         return false;
     }
 
@@ -424,7 +741,7 @@ CommandLineNode::create_process (const std::string& command, std::string& output
     si.StartupInfo.dwFlags |= STARTF_USESTDHANDLES;
     si.StartupInfo.hStdOutput = write_handle;
     si.StartupInfo.hStdError = write_handle;
-    si.StartupInfo.hStdInput = nullptr;
+    si.StartupInfo.hStdInput = input_handle;
 
     auto env = get_environment();
 
@@ -441,6 +758,9 @@ CommandLineNode::create_process (const std::string& command, std::string& output
                                   &pi);
 
     CloseHandle (write_handle);
+    if (input_handle) {
+        CloseHandle (input_handle);
+    }
     DeleteProcThreadAttributeList (si.lpAttributeList);
     HeapFree (GetProcessHeap(), 0, si.lpAttributeList);
 
@@ -31,12 +31,48 @@ public:
 
     string command();
 
+    // how a batch reaches the command: "env" (default) exports INPUT as well as INPUT_LIST,
+    // "list" only INPUT_LIST, the path of the sorted list, and "stdin" also feeds the list to
+    // the command's standard input.
+    void set_batch_input (const string& delivery);
+
+    string batch_input() const;
+
+    // attributes set on every output token, by name; each value is shell-expanded per token, so
+    // it can use ${INPUT}, ${STDOUT}, ${ATTR_name} and the like. Outputs also keep the input
+    // token's attributes, and each of those is exported to the command as ${ATTR_name}; the
+    // byte range of a split file is also ${CHUNK_OFFSET} and ${CHUNK_LENGTH}.
+    void set_attributes (const json& attributes);
+
+    json attributes() const;
+
+    // exports env to the shell environment of the commands this node runs.
+    bool set_environment (json& env);
+
+    // runs the command for a single token and returns the tokens it produces instead of
+    // writing them downstream; used by run_command() and by remote workers.
+    bool Process (const string& input, vector<string>& outputs);
+
 private:
     bool run_command (const string&, const string&);
 
+    // the tokens of a batch list for INPUT, joined by newlines; false when they are too many
+    // for one environment variable.
+    bool read_batch_ (const string& list, string& tokens);
+
+    // sends the tokens of a batch list downstream.
+    void write_list_ (const string& list);
+
+    // carries the input's attributes over to outputs and sets the configured ones.
+    void set_attributes_ (const string& input, vector<string>& outputs);
+
+    // ATTR_ and the attribute name, with characters a variable name cannot have replaced by '_'.
+    static string attribute_variable_ (std::string_view name);
+
 #ifdef _WIN32
 
-    bool create_process (const string& command, string& output);
+    // input, if given, is a file the process reads as its standard input.
+    bool create_process (const string& command, string& output, const string& input = "");
 
     void set_variable (const string& name, const string& value) { environment_[name] = value; };
 
@@ -77,6 +113,11 @@ private:
     [[nodiscard]] string shell_expand (const string&);
 
     string command_;
+    string batch_input_;
+    json attributes_ = json::object();
+
+    // ATTR_ variables exported for the previous token.
+    vector<string> exported_;
 
     json environment_;
 };
@@ -0,0 +1,172 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "dedupnode.h"
+
+
+namespace daisychain {
+using namespace std;
+
+
+DedupNode::DedupNode() :
+    mode_ ("exact"),
+    window_ (0),
+    capacity_ (0),
+    memory_ (16 * 1024 * 1024),
+    seen_ (0),
+    dropped_ (0)
+{
+    type_ = DaisyNodeType::DC_DEDUP;
+    set_name (DaisyNodeNameByType[type_]);
+}
+
+
+void
+DedupNode::Initialize (json& keydata, bool keep_uuid)
+{
+    Node::Initialize (keydata, keep_uuid);
+
+    json::iterator jit = keydata.begin();
+    const auto& uuid = jit.key();
+    auto data = keydata[uuid];
+
+    set_mode (data.count ("mode") ? data["mode"].get<string>() : "exact");
+    set_window (data.count ("window") ? data["window"].get<int>() : 0);
+    set_capacity (data.count ("capacity") ? data["capacity"].get<size_t>() : 0);
+    set_memory (data.count ("memory") ? data["memory"].get<size_t>() : 16 * 1024 * 1024);
+}
+
+
+bool
+DedupNode::Execute (vector<string>& inputs, const string& sandbox, json& vars)
+{
+    LINFO << "Executing " << (isroot_ ? "root: " : "node: ") << name_;
+
+    if (mode_ != "exact" && !approximate_()) {
+        LERROR << LOGNODE << "Unknown dedup mode: " << mode_;
+        OpenOutputs (sandbox);
+        WriteOutputs ("EOF");
+        CloseOutputs();
+
+        return false;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+
+    if (approximate_()) {
+        bloom_ = BloomFilter (memory_, capacity_, std::chrono::milliseconds (window_), now);
+    }
+    else {
+        exact_ = FingerprintSet (capacity_, std::chrono::milliseconds (window_), now);
+    }
+
+    seen_ = 0;
+    dropped_ = 0;
+
+    vector<string> passed;
+
+    if (isroot_) {
+        filter_ (inputs, passed);
+
+        OpenOutputs (sandbox);
+        WriteTokens (passed);
+        CloseOutputs();
+    }
+    else {
+        while (eofs_ <= fd_in_.size() && !terminate_.load()) {
+            filter_ (inputs, passed);
+
+            if (!passed.empty()) {
+                OpenOutputs (sandbox);
+                WriteTokens (passed);
+                CloseOutputs();
+                passed.clear();
+            }
+
+            inputs.clear();
+
+            if (eofs_ == fd_in_.size()) {
+                break;
+            }
+            ReadInputs (inputs);
+        }
+        CloseInputs();
+    }
+
+    // all processing is done for this node. Send EOF downstream.
+    OpenOutputs (sandbox);
+    WriteOutputs ("EOF");
+    CloseOutputs();
+    Stats();
+    Reset();
+
+    // the tables can be large; they are not kept between runs.
+    exact_ = FingerprintSet();
+    bloom_ = BloomFilter();
+
+    return true;
+} // DedupNode::Execute
+
+
+void
+DedupNode::filter_ (vector<string>& inputs, vector<string>& passed)
+{
+    // one clock read per batch is close enough for a window in milliseconds.
+    auto now = std::chrono::steady_clock::now();
+
+    for (auto& input : inputs) {
+        if (input == "EOF") {
+            continue;
+        }
+
+        ++seen_;
+
+        // the same path with different attributes is still a repeat.
+        auto hash = fingerprint (token_path (input));
+
+        if (approximate_() ? bloom_.Insert (hash, now) : exact_.Insert (hash, now)) {
+            passed.push_back (std::move (input));
+        }
+        else {
+            LDEBUG << "Dropped: " << input;
+            ++dropped_;
+        }
+    }
+} // DedupNode::filter_
+
+
+json
+DedupNode::Serialize()
+{
+    auto json_ = Node::Serialize();
+    json_[id_]["mode"] = mode_;
+    json_[id_]["window"] = window_;
+
+    if (capacity_) {json_[id_]["capacity"] = capacity_;}
+
+    if (approximate_()) {json_[id_]["memory"] = memory_;}
+
+    if (size_ != std::pair<int, int>(0,0)) {json_[id_]["size"] = size_;}
+
+    return json_;
+} // DedupNode::Serialize
+
+
+void
+DedupNode::Stats()
+{
+    LINFO << LOGNODE << "tokens seen: " << seen_ << ", dropped: " << dropped_;
+
+    if (approximate_()) {
+        LINFO << LOGNODE << "filter bytes: " << bloom_.memory() << ", hashes: " << bloom_.hashes()
+              << ", estimated false positive rate: " << bloom_.false_positive_rate();
+    }
+    else {
+        LINFO << LOGNODE << "fingerprints: " << exact_.size() << ", table bytes: " << exact_.memory();
+    }
+
+    Node::Stats();
+} // DedupNode::Stats
+} // namespace daisychain
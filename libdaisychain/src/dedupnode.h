@@ -0,0 +1,72 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include "fingerprintset.h"
+#include "node.h"
+
+
+namespace daisychain {
+// Drops tokens that already went through, so a path reported by several sources runs its
+// command once. exact mode remembers a 64-bit fingerprint of every token passed; approximate
+// mode uses a Bloom filter of a fixed size and occasionally drops a token that is new. With a
+// window, a token may pass again once the window has gone by since it last did.
+class DedupNode final : public Node
+{
+public:
+    DedupNode();
+
+    void Initialize (json&, bool) override;
+
+    bool Execute (vector<string>& input, const string& sandbox, json& vars) override;
+
+    json Serialize() override;
+
+    void Stats() override;
+
+    // "exact" (default) or "approximate".
+    void set_mode (const string& mode) { mode_ = mode; }
+
+    string mode() const { return mode_; }
+
+    // milliseconds after which a token may pass again; 0 (default) drops every repeat.
+    void set_window (int milliseconds) { window_ = milliseconds; }
+
+    [[nodiscard]] int window() const { return window_; }
+
+    // distinct tokens expected; sizes the exact table up front and picks the number of hashes
+    // for the approximate filter. 0 (default) leaves both to grow or to a default.
+    void set_capacity (size_t capacity) { capacity_ = capacity; }
+
+    [[nodiscard]] size_t capacity() const { return capacity_; }
+
+    // bytes the approximate filter may use.
+    void set_memory (size_t bytes) { memory_ = bytes; }
+
+    [[nodiscard]] size_t memory() const { return memory_; }
+
+private:
+    // not exposed
+    using Node::set_batch_flag;
+    using Node::set_outputfile;
+
+    // moves the tokens seen for the first time from inputs into passed.
+    void filter_ (vector<string>& inputs, vector<string>& passed);
+
+    [[nodiscard]] bool approximate_() const { return mode_ == "approximate"; }
+
+    string mode_;
+    int window_;
+    size_t capacity_;
+    size_t memory_;
+
+    FingerprintSet exact_;
+    BloomFilter bloom_;
+
+    uint64_t seen_;
+    uint64_t dropped_;
+};
+} // namespace daisychain
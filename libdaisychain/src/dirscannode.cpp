@@ -0,0 +1,332 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "dirscannode.h"
+#include <thread>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+
+namespace daisychain {
+using namespace std;
+
+
+namespace {
+string
+join_path (const string& directory, const string& name)
+{
+    if (!directory.empty() && directory.back() == '/') {
+        return directory + name;
+    }
+
+    return directory + "/" + name;
+}
+} // namespace
+
+
+DirScanNode::DirScanNode() :
+    regex_ (false),
+    max_depth_ (-1),
+    follow_symlinks_ (false),
+    threads_ (0),
+    attributes_ (false)
+{
+    type_ = DaisyNodeType::DC_DIRSCAN;
+    set_name (DaisyNodeNameByType[type_]);
+}
+
+
+void
+DirScanNode::Initialize (json& keydata, bool keep_uuid)
+{
+    Node::Initialize (keydata, keep_uuid);
+
+    json::iterator jit = keydata.begin();
+    const auto& uuid = jit.key();
+    auto data = keydata[uuid];
+
+    set_directory (data.count ("directory") ? data["directory"] : "");
+    set_include (data.count ("include") ? data["include"].get<vector<string>>() : vector<string>());
+    set_exclude (data.count ("exclude") ? data["exclude"].get<vector<string>>() : vector<string>());
+    set_regex (data.count ("regex") && data["regex"].get<bool>());
+    set_max_depth (data.count ("max_depth") ? data["max_depth"].get<int>() : -1);
+    set_follow_symlinks (data.count ("follow_symlinks") && data["follow_symlinks"].get<bool>());
+    set_threads (data.count ("threads") ? data["threads"].get<unsigned int>() : 0);
+    set_attributes (data.count ("attributes") && data["attributes"].get<bool>());
+}
+
+
+bool
+DirScanNode::Execute (vector<string>& inputs, const string& sandbox, json& vars)
+{
+    LINFO << "Executing " << (isroot_ ? "root: " : "node: ") << name_;
+
+    include_matcher_.Clear();
+    exclude_matcher_.Clear();
+
+    try {
+        for (const auto& pattern : include_) {
+            include_matcher_.Add (pattern, regex_);
+        }
+        for (const auto& pattern : exclude_) {
+            exclude_matcher_.Add (pattern, regex_);
+        }
+    }
+    catch (const std::regex_error& e) {
+        LERROR << "regex_error caught: " << e.what();
+        OpenOutputs (sandbox);
+        WriteOutputs ("EOF");
+        CloseOutputs();
+
+        return false;
+    }
+
+    if (isroot_) {
+        scan_ (directory_.empty() ? inputs : vector<string>{directory_}, sandbox);
+    }
+    else {
+        while (eofs_ <= fd_in_.size() && !terminate_.load()) {
+            std::erase (inputs, "EOF");
+            scan_ (inputs, sandbox);
+
+            inputs.clear();
+
+            if (eofs_ == fd_in_.size()) {
+                break;
+            }
+            ReadInputs (inputs);
+        }
+
+        CloseInputs();
+    }
+
+    // all processing is done for this node. Send EOF downstream.
+    OpenOutputs (sandbox);
+    WriteOutputs ("EOF");
+    CloseOutputs();
+    Stats();
+    Reset();
+
+    return true;
+} // DirScanNode::Execute
+
+
+void
+DirScanNode::scan_ (const vector<string>& roots, const string& sandbox)
+{
+    Walk walk;
+
+    for (const auto& root : roots) {
+        auto directory = token_path (root);
+
+        if (!directory.empty()) {
+            walk.directories.emplace_back (string (directory), 0);
+        }
+    }
+
+    if (walk.directories.empty() || max_depth_ == 0 || cancelled_.load()) {
+        return;
+    }
+
+    auto count = threads_ ? threads_ : std::max (1u, std::thread::hardware_concurrency());
+    vector<std::thread> pool;
+
+    for (unsigned int i = 0; i < count; ++i) {
+        pool.emplace_back (&DirScanNode::walk_, this, std::ref (walk));
+    }
+
+    OpenOutputs (sandbox);
+
+    // paths go out as soon as a directory is done, in blocks that reach readers in one piece.
+    vector<string> found;
+    bool finished = false;
+
+    while (!finished) {
+        {
+            std::unique_lock lock (walk.mutex);
+            walk.found_cv.wait_for (lock, std::chrono::milliseconds (100),
+                                    [&walk] { return !walk.found.empty() || walk.finished(); });
+
+            if (cancelled_.load()) {
+                walk.directories.clear();
+            }
+
+            found.swap (walk.found);
+            finished = walk.finished();
+        }
+
+        WriteTokens (found);
+        found.clear();
+    }
+
+    walk.work_cv.notify_all();
+
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    CloseOutputs();
+} // DirScanNode::scan_
+
+
+void
+DirScanNode::walk_ (Walk& walk)
+{
+    vector<string> found;
+    vector<pair<string, int>> subdirectories;
+    Matcher include = include_matcher_;
+    Matcher exclude = exclude_matcher_;
+
+    std::unique_lock lock (walk.mutex);
+
+    while (true) {
+        walk.work_cv.wait (lock, [&walk] { return !walk.directories.empty() || walk.finished(); });
+
+        if (walk.directories.empty()) {
+            break;
+        }
+
+        // depth first keeps the queue short on wide trees.
+        auto [directory, depth] = std::move (walk.directories.back());
+        walk.directories.pop_back();
+        ++walk.active;
+
+        lock.unlock();
+        visit_ (walk, directory, depth, include, exclude, found, subdirectories);
+        lock.lock();
+
+        --walk.active;
+
+        walk.found.insert (walk.found.end(), std::make_move_iterator (found.begin()),
+                           std::make_move_iterator (found.end()));
+        walk.directories.insert (walk.directories.end(), std::make_move_iterator (subdirectories.begin()),
+                                 std::make_move_iterator (subdirectories.end()));
+
+        if (!found.empty() || walk.finished()) {
+            walk.found_cv.notify_one();
+        }
+        if (!subdirectories.empty() || walk.finished()) {
+            walk.work_cv.notify_all();
+        }
+
+        found.clear();
+        subdirectories.clear();
+    }
+} // DirScanNode::walk_
+
+
+void
+DirScanNode::visit_ (Walk& walk, const string& directory, int depth, const Matcher& include,
+                     const Matcher& exclude, vector<string>& found, vector<pair<string, int>>& subdirectories)
+{
+    vector<Entry> entries;
+    TreeIndex::FileInfo info;
+
+    if (!TreeIndex::List (directory, entries, follow_symlinks_ ? &info : nullptr)) {
+        LWARN << LOGNODE << "Cannot read directory: " << directory;
+        return;
+    }
+
+    // no inode on Windows, where linked directories are not walked anyway.
+    if (follow_symlinks_ && info.inode != 0) {
+        std::lock_guard lock (walk.mutex);
+
+        if (!walk.visited.insert ({info.device, info.inode}).second) {
+            LDEBUG << LOGNODE << "Already visited: " << directory;
+            return;
+        }
+    }
+
+    bool descend = max_depth_ < 0 || depth + 1 < max_depth_;
+
+    for (auto& entry : entries) {
+        auto path = join_path (directory, entry.name);
+
+        if (entry.type == EntryType::UNKNOWN || (entry.type == EntryType::SYMLINK && follow_symlinks_)) {
+            if (!resolve_ (path, entry)) {
+                continue;
+            }
+        }
+
+        if (!exclude_.empty() && matches_ (exclude, entry.name, path)) {
+            continue;
+        }
+
+        if (entry.type == EntryType::DIRECTORY) {
+            if (descend) {
+                subdirectories.emplace_back (std::move (path), depth + 1);
+            }
+        }
+        else if (include_.empty() || matches_ (include, entry.name, path)) {
+            // the walk has already paid for the directory; one stat more saves a stat downstream.
+            if (attributes_ && TreeIndex::Stat (path, info)) {
+                set_token_attribute (path, "size", int64_t (info.size));
+                set_token_attribute (path, "mtime", info.mtime / 1000000000);
+            }
+
+            found.push_back (std::move (path));
+        }
+    }
+} // DirScanNode::visit_
+
+
+bool
+DirScanNode::resolve_ (const string& path, Entry& entry) const
+{
+#ifdef _WIN32
+    std::error_code ec;
+    auto status = fs::symlink_status (path, ec);
+
+    if (ec) {
+        return false;
+    }
+
+    entry.type = fs::is_symlink (status) ? EntryType::SYMLINK
+               : fs::is_directory (status) ? EntryType::DIRECTORY
+               : EntryType::FILE;
+#else
+    // only reached for DT_UNKNOWN file systems or symlinks being followed.
+    struct stat info{};
+
+    if ((follow_symlinks_ ? stat (path.c_str(), &info) : lstat (path.c_str(), &info)) == -1) {
+        // a dangling link is still reported, as a link.
+        return entry.type == EntryType::SYMLINK;
+    }
+
+    entry.type = S_ISDIR (info.st_mode) ? EntryType::DIRECTORY
+               : S_ISLNK (info.st_mode) ? EntryType::SYMLINK
+               : EntryType::FILE;
+#endif
+
+    return true;
+} // DirScanNode::resolve_
+
+
+bool
+DirScanNode::matches_ (const Matcher& matcher, const string& name, const string& path) const
+{
+    return matcher.First (regex_ ? path : name) >= 0;
+} // DirScanNode::matches_
+
+
+json
+DirScanNode::Serialize()
+{
+    auto json_ = Node::Serialize();
+    json_[id_]["directory"] = directory_;
+    json_[id_]["include"] = include_;
+    json_[id_]["exclude"] = exclude_;
+    json_[id_]["regex"] = regex_;
+    json_[id_]["max_depth"] = max_depth_;
+    json_[id_]["follow_symlinks"] = follow_symlinks_;
+    json_[id_]["threads"] = threads_;
+    json_[id_]["attributes"] = attributes_;
+
+    if (size_ != std::pair<int, int>(0,0)) {json_[id_]["size"] = size_;}
+
+    return json_;
+} // DirScanNode::Serialize
+} // namespace daisychain
@@ -0,0 +1,119 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include "matcher.h"
+#include "node.h"
+#include "treeindex.h"
+
+
+namespace daisychain {
+// Native replacement for running `find`: walks one or more directory trees with a pool of
+// threads and streams matching paths downstream while the walk is still going. Without a
+// directory set, the node's inputs are the directories to scan.
+//
+// include/exclude are globs on the entry name, or regexes on the full path with regex set. An
+// excluded directory is not descended into. Only non-directories are emitted; symlinks are
+// reported as they are unless follow_symlinks is set, in which case linked directories are
+// walked too (each directory once). With attributes set, each path carries its size and mtime
+// (seconds since the epoch) as token attributes.
+class DirScanNode final : public Node
+{
+public:
+    DirScanNode();
+
+    void Initialize (json&, bool) override;
+
+    bool Execute (vector<string>& input, const string& sandbox, json& vars) override;
+
+    json Serialize() override;
+
+    void set_directory (const string& directory) { directory_ = directory; }
+
+    string directory() { return directory_; }
+
+    void set_include (const vector<string>& patterns) { include_ = patterns; }
+
+    vector<string> include() const { return include_; }
+
+    void set_exclude (const vector<string>& patterns) { exclude_ = patterns; }
+
+    vector<string> exclude() const { return exclude_; }
+
+    void set_regex (bool is_regex) { regex_ = is_regex; }
+
+    [[nodiscard]] bool regex() const { return regex_; }
+
+    // -1 for no limit; entries directly in a scanned directory are at depth 1.
+    void set_max_depth (int depth) { max_depth_ = depth; }
+
+    [[nodiscard]] int max_depth() const { return max_depth_; }
+
+    void set_follow_symlinks (bool follow) { follow_symlinks_ = follow; }
+
+    [[nodiscard]] bool follow_symlinks() const { return follow_symlinks_; }
+
+    // 0 uses one thread per core.
+    void set_threads (unsigned int threads) { threads_ = threads; }
+
+    [[nodiscard]] unsigned int threads() const { return threads_; }
+
+    void set_attributes (bool attributes) { attributes_ = attributes; }
+
+    [[nodiscard]] bool attributes() const { return attributes_; }
+
+private:
+    // not exposed
+    using Node::set_batch_flag;
+    using Node::set_outputfile;
+
+    using EntryType = TreeIndex::EntryType;
+    using Entry = TreeIndex::Entry;
+
+    // shared between the walking threads and the thread writing the results.
+    struct Walk
+    {
+        std::mutex mutex;
+        std::condition_variable work_cv;
+        std::condition_variable found_cv;
+        std::deque<pair<string, int>> directories;
+        vector<string> found;
+        std::set<pair<uint64_t, uint64_t>> visited;
+        size_t active = 0;
+
+        [[nodiscard]] bool finished() const { return directories.empty() && active == 0; }
+    };
+
+    void scan_ (const vector<string>& roots, const string& sandbox);
+
+    void walk_ (Walk& walk);
+
+    // the matchers are per thread; their automata fill in lazily and are not shared.
+    void visit_ (Walk& walk, const string& directory, int depth, const Matcher& include,
+                 const Matcher& exclude, vector<string>& found, vector<pair<string, int>>& subdirectories);
+
+    // resolves UNKNOWN and, when following, SYMLINK; false if the entry is gone.
+    bool resolve_ (const string& path, Entry& entry) const;
+
+    bool matches_ (const Matcher& matcher, const string& name, const string& path) const;
+
+    string directory_;
+    vector<string> include_;
+    vector<string> exclude_;
+    bool regex_;
+    int max_depth_;
+    bool follow_symlinks_;
+    unsigned int threads_;
+    bool attributes_;
+
+    Matcher include_matcher_;
+    Matcher exclude_matcher_;
+};
+} // namespace daisychain
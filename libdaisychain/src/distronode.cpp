@@ -83,13 +83,11 @@ DistroNode::OpenNextOutput (const string& sandbox)
     filepath.append ("/");
     filepath.append (fifo);
 
-    int fd = open (filepath.c_str(), O_WRONLY);
+    next_fd_ = open (filepath.c_str(), O_WRONLY);
 
-    if (fd == -1) {
+    if (next_fd_ == -1) {
         LERROR << LOGNODE << "Cannot open output for writing: " << filepath;
     }
-
-    fd_out_[fifo] = fd;
 #endif
 } // DistroNode::OpenNextOutput
 
@@ -98,7 +96,8 @@ void
 DistroNode::CloseNextOutput()
 {
 #ifndef _WIN32
-    int stat = close (fd_out_[*output_it_]);
+    int stat = close (next_fd_);
+    next_fd_ = -1;
 
     if (stat == -1) {
         LERROR << LOGNODE << "Cannot close output file descriptor: " << *output_it_;
@@ -112,6 +111,9 @@ DistroNode::CloseNextOutput()
 #ifdef _WIN32
 void
 DistroNode::WriteNextOutput (const std::string& output) {
+    if (cancelled_.load())
+        return;
+
     std::string token = output + '\n';
 
     if (output_it_ == outputs_.end()) {
@@ -178,6 +180,9 @@ DistroNode::WriteNextOutput (const std::string& output) {
     }
 
     FlushFileBuffers(handle);
+
+    ++tokenswritten_;
+    progress_();
 }
 
 
@@ -215,11 +220,14 @@ DistroNode::WriteAnyOutput (const string& output)
 void
 DistroNode::WriteNextOutput (const string& output)
 {
+    if (cancelled_.load())
+        return;
+
     string token = output + '\n';
 
     struct pollfd pfds[1];
 
-    pfds[0].fd = fd_out_[*output_it_];
+    pfds[0].fd = next_fd_;
     pfds[0].events = POLLOUT;
 
     int ret;
@@ -256,6 +264,9 @@ DistroNode::WriteNextOutput (const string& output)
             break;
         }
     } while (true);
+
+    ++tokenswritten_;
+    progress_();
 } // DistroNode::WriteNextOutput
 
 
@@ -264,28 +275,20 @@ DistroNode::WriteAnyOutput (const string& output)
 {
     string token = output + '\n';
 
-    struct pollfd pfds[fd_out_.size()];
-
-    int i = 0;
-
-    for (const auto& fd : fd_out_) {
-        pfds[i].fd = fd.second;
-        pfds[i].events = POLLOUT;
-        i++;
+    for (auto& pfd : fd_out_) {
+        pfd.events = POLLOUT;
     }
 
     size_t numbytes;
 
-    if (poll (pfds, fd_out_.size(), 2) > 0) {
-        i = 0;
-
-        for (const auto& fd : fd_out_) {
-            if (pfds[i].revents) {
+    if (poll (fd_out_.data(), fd_out_.size(), 2) > 0) {
+        for (size_t i = 0; i < fd_out_.size(); ++i) {
+            if (fd_out_[i].revents) {
                 do {
-                    numbytes = write (fd.second, token.c_str(), token.size());
+                    numbytes = write (fd_out_[i].fd, token.c_str(), token.size());
 
                     if (numbytes == -1) {
-                        LERROR << LOGNODE << "Cannot write to file descriptor: " << fd.first;
+                        LERROR << LOGNODE << "Cannot write to file descriptor: " << fifo_out_[i];
                     }
                     else if (numbytes) {
                         token = output.substr (numbytes) + '\n';
@@ -294,8 +297,6 @@ DistroNode::WriteAnyOutput (const string& output)
 
                 return;
             }
-
-            i++;
         }
     }
 } // DistroNode::WriteAnyOutput
@@ -25,6 +25,9 @@ public:
     void WriteAnyOutput (const string& output);
 
 private:
-    list<string>::iterator output_it_;
+    vector<string>::iterator output_it_;
+#ifndef _WIN32
+    int next_fd_ = -1;
+#endif
 };
 } // namespace daisychain
@@ -0,0 +1,143 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "executioncontext.h"
+#ifdef _WIN32
+#include "utils_win.h"
+#else
+#include <csignal>
+#include <cerrno>
+#include <ftw.h>
+#endif
+
+
+namespace daisychain {
+using namespace std;
+
+
+ExecutionContext::ExecutionContext() :
+    id_ (m_gen_uuid()),
+    owns_sandbox_ (false),
+    test_ (false),
+    cleanup_ (true),
+    running_ (false),
+    nodes_started_ (0),
+    nodes_failed_ (0),
+    event_fd_ (-1),
+    cancel_fd_ (-1)
+#ifndef _WIN32
+    , process_group_ (0)
+#endif
+{
+}
+
+
+ExecutionContext::~ExecutionContext()
+{
+    LDEBUG << "Execution context destroyed: " << id_;
+}
+
+
+void
+ExecutionContext::set_sandbox (const string& sandbox, bool owned)
+{
+    sandbox_ = sandbox;
+    owns_sandbox_ = owned;
+    LDEBUG << "Execution sandbox set to: " << sandbox_;
+} // ExecutionContext::set_sandbox
+
+
+void
+ExecutionContext::set_counters (int started, int failed)
+{
+    nodes_started_.store (started);
+    nodes_failed_.store (failed);
+} // ExecutionContext::set_counters
+
+
+void
+ExecutionContext::Cancel()
+{
+#ifdef _WIN32
+    for (const auto& node : nodes_) {
+        node->Cancel();
+    }
+#endif
+    // node processes on POSIX are reached through the cancel pipe, see CancellationToken.
+} // ExecutionContext::Cancel
+
+
+void
+ExecutionContext::Terminate()
+{
+#ifdef _WIN32
+    for (const auto& node : nodes_) {
+        node->Stop();
+    }
+
+    running_.store (false);
+#else
+    auto process_group = process_group_.load();
+
+    // no group yet, or no longer: killpg (0) would signal the caller's own process group.
+    if (process_group == 0) {
+        return;
+    }
+
+    auto result = killpg (process_group, SIGTERM);
+    if (result == 0) {
+        LWARN << " !!! Terminated !!! (" << process_group << ")";
+        running_.store (false);
+        process_group_.store (0);
+    }
+    else {
+        switch (errno) {
+        case EINVAL:
+            LERROR << "Terminate process group failed for ("
+                   << process_group
+                   << "): Invalid signal";
+            break;
+        case EPERM:
+            LERROR << "Terminate process group failed for ("
+                   << process_group
+                   << "): Sending user is not the super user";
+            break;
+        case ESRCH:
+            LERROR << "Terminate process group failed for ("
+                   << process_group
+                   << "): No process can be found in the process group";
+            break;
+        }
+    }
+#endif
+} // ExecutionContext::Terminate
+
+
+bool
+ExecutionContext::Cleanup()
+{
+    // only sandboxes created for this run are removed; a sandbox handed in by the Graph
+    // belongs to the Graph.
+    if (sandbox_.empty() || !owns_sandbox_) {
+        return true;
+    }
+
+#ifdef _WIN32
+    int status = delete_directory_recursive (sandbox_) ? 0 : -1;
+#else
+    auto rmdirtree = [] (const char* path, const struct stat* buf, int type, struct FTW* ftwb) {
+        int stat = std::remove (path);
+        stat < 0 ? LERROR << "Could not remove: " << path : LDEBUG << "Removed: " << path;
+
+        return stat < 0 ? -1 : 0;
+    };
+
+    int status = nftw (sandbox_.c_str(), rmdirtree, 10, FTW_DEPTH | FTW_MOUNT | FTW_PHYS);
+#endif
+    status == 0 ? LINFO << "Cleanup finished: " << sandbox_ : LERROR << "Cleanup failed: " << sandbox_;
+
+    return status == 0;
+} // ExecutionContext::Cleanup
+} // namespace daisychain
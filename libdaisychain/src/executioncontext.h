@@ -0,0 +1,126 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
+
+#include "logger.h"
+#include "node.h"
+#include "executionplan.h"
+
+
+namespace daisychain {
+using namespace std;
+
+
+// State belonging to a single run of a Graph. The Graph holds the definition (nodes, edges,
+// environment) and each call to Graph::Execute gets its own context with its own sandbox,
+// process group and counters, so a loaded graph can be executed several times at once.
+class ExecutionContext
+{
+public:
+    ExecutionContext();
+
+    ~ExecutionContext();
+
+    void Cancel();
+
+    void Terminate();
+
+    bool Cleanup();
+
+    string id() const { return id_; }
+
+    void set_sandbox (const string& sandbox, bool owned);
+
+    string sandbox() const { return sandbox_; }
+
+    [[nodiscard]] bool owns_sandbox() const { return owns_sandbox_; }
+
+    [[nodiscard]] string logfile() const { return sandbox_ + ".log"; }
+
+    void set_input (const string& input) { input_ = input; }
+
+    string& input() { return input_; }
+
+    void set_environment (const json& env) { environment_ = env; }
+
+    json& environment() { return environment_; }
+
+    void set_test_flag (bool test) { test_ = test; }
+
+    [[nodiscard]] bool test_flag() const { return test_; }
+
+    void set_cleanup_flag (bool cleanup) { cleanup_ = cleanup; }
+
+    [[nodiscard]] bool cleanup_flag() const { return cleanup_; }
+
+    void set_plan (const std::shared_ptr<const ExecutionPlan>& plan) { plan_ = plan; }
+
+    std::shared_ptr<const ExecutionPlan> plan() const { return plan_; }
+
+    void set_running (bool running) { running_.store (running); }
+
+    [[nodiscard]] bool running() const { return running_.load(); }
+
+    void set_event_fd (int fd) { event_fd_ = fd; }
+
+    [[nodiscard]] int event_fd() const { return event_fd_; }
+
+    void set_cancel_fd (int fd) { cancel_fd_ = fd; }
+
+    [[nodiscard]] int cancel_fd() const { return cancel_fd_; }
+
+    void set_counters (int started, int failed);
+
+    [[nodiscard]] int nodes_started() const { return nodes_started_.load(); }
+
+    [[nodiscard]] int nodes_finished() const { return nodes_started_.load() - nodes_failed_.load(); }
+
+    [[nodiscard]] int nodes_failed() const { return nodes_failed_.load(); }
+
+#ifdef _WIN32
+    NodeThreadContext* thread_context() { return &thread_context_; }
+
+    // per-run node copies, indexed by plan id.
+    vector<std::shared_ptr<Node>>& nodes() { return nodes_; }
+#else
+    void set_process_group (pid_t pgid) { process_group_.store (pgid); }
+
+    [[nodiscard]] pid_t process_group() const { return process_group_.load(); }
+#endif
+
+private:
+    string id_;
+    string sandbox_;
+    bool owns_sandbox_;
+    string input_;
+    json environment_;
+    bool test_;
+    bool cleanup_;
+    std::shared_ptr<const ExecutionPlan> plan_;
+    atomic<bool> running_;
+    atomic<int> nodes_started_;
+    atomic<int> nodes_failed_;
+    int event_fd_;
+    int cancel_fd_;
+
+#ifdef _WIN32
+    // nodes run as threads on Windows, so each run gets its own node instances.
+    NodeThreadContext thread_context_;
+    vector<std::shared_ptr<Node>> nodes_;
+#else
+    atomic<pid_t> process_group_;
+#endif
+};
+} // namespace daisychain
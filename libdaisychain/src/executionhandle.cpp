@@ -0,0 +1,316 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "executionhandle.h"
+#include <cstring>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+namespace daisychain {
+using namespace std;
+
+
+#ifndef _WIN32
+namespace {
+// forked node processes still inherit both ends, but commands they exec do not.
+int
+cloexec_pipe (int fds[2])
+{
+#ifdef __APPLE__
+    if (pipe (fds) == -1) {
+        return -1;
+    }
+
+    for (int i = 0; i < 2; ++i) {
+        fcntl (fds[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    return 0;
+#else
+    return pipe2 (fds, O_CLOEXEC);
+#endif
+}
+} // namespace
+#endif
+
+
+CancellationToken::CancellationToken() :
+    cancelled_ (false),
+    fds_{-1, -1}
+{
+#ifndef _WIN32
+    if (cloexec_pipe (fds_) == -1) {
+        LERROR << "Cannot create cancellation pipe.";
+        fds_[0] = fds_[1] = -1;
+    }
+#endif
+}
+
+
+CancellationToken::~CancellationToken()
+{
+#ifndef _WIN32
+    for (auto fd : fds_) {
+        if (fd != -1) {
+            close (fd);
+        }
+    }
+#endif
+}
+
+
+void
+CancellationToken::cancel()
+{
+    if (cancelled_.exchange (true)) {
+        return;
+    }
+
+#ifndef _WIN32
+    // nobody reads the byte back, so the pipe stays readable for every node process.
+    if (fds_[1] != -1) {
+        char byte = 1;
+        while (write (fds_[1], &byte, 1) == -1 && errno == EINTR);
+    }
+#endif
+} // CancellationToken::cancel
+
+
+ExecutionHandle::ExecutionHandle (std::shared_ptr<ExecutionContext> context) :
+    context_ (std::move (context)),
+    finished_ (false),
+    event_fds_{-1, -1}
+{
+}
+
+
+ExecutionHandle::~ExecutionHandle()
+{
+    if (runner_.joinable()) {
+        runner_.join();
+    }
+
+    if (collector_.joinable()) {
+        collector_.join();
+    }
+}
+
+
+void
+ExecutionHandle::Start (const std::function<bool (ExecutionContext&)>& run)
+{
+#ifdef _WIN32
+    int stat = _pipe (event_fds_, 65536, _O_BINARY);
+#else
+    int stat = cloexec_pipe (event_fds_);
+#endif
+
+    if (stat == -1) {
+        LERROR << "Cannot create event pipe; node events will not be reported.";
+        event_fds_[0] = event_fds_[1] = -1;
+    }
+
+    context_->set_event_fd (event_fds_[1]);
+    context_->set_cancel_fd (token_.fd());
+
+    if (event_fds_[0] != -1) {
+        collector_ = std::thread ([this]() { collect_(); });
+    }
+
+    std::promise<bool> promise;
+    future_ = promise.get_future().share();
+
+    runner_ = std::thread ([this, run, promise = std::move (promise)]() mutable {
+        bool stat = false;
+
+        try {
+            stat = run (*context_);
+        }
+        catch (const std::exception& e) {
+            LERROR << "Graph execution failed: " << e.what();
+        }
+
+        finished_.store (true);
+#ifdef _WIN32
+        // node threads are joined at this point; closing the write end ends the collector.
+        if (event_fds_[1] != -1) {
+            _close (event_fds_[1]);
+            event_fds_[1] = -1;
+        }
+#endif
+        if (collector_.joinable()) {
+            collector_.join();
+        }
+
+        promise.set_value (stat);
+    });
+} // ExecutionHandle::Start
+
+
+void
+ExecutionHandle::collect_()
+{
+    NodeEvent buffer[64];
+    auto* bytes = reinterpret_cast<char*> (buffer);
+    size_t carry = 0;
+
+    auto consume = [&] (size_t numbytes) {
+        numbytes += carry;
+        size_t count = numbytes / sizeof (NodeEvent);
+
+        for (size_t i = 0; i < count; ++i) {
+            dispatch_ (buffer[i]);
+        }
+
+        carry = numbytes % sizeof (NodeEvent);
+        if (carry) {
+            std::memmove (bytes, bytes + count * sizeof (NodeEvent), carry);
+        }
+    };
+
+#ifdef _WIN32
+    int numbytes;
+    while ((numbytes = _read (event_fds_[0], bytes + carry, unsigned (sizeof (buffer) - carry))) > 0) {
+        consume (size_t (numbytes));
+    }
+#else
+    // forked node processes of concurrent runs inherit the write end too, so EOF cannot be
+    // relied on; keep polling until the run is over and the pipe is drained.
+    struct pollfd pfd{event_fds_[0], POLLIN, 0};
+
+    while (true) {
+        bool finished = finished_.load();
+        auto ret = ::poll (&pfd, 1, 50);
+
+        if (ret > 0 && (pfd.revents & POLLIN)) {
+            auto numbytes = read (event_fds_[0], bytes + carry, sizeof (buffer) - carry);
+            if (numbytes > 0) {
+                consume (size_t (numbytes));
+                continue;
+            }
+        }
+        else if (ret == -1 && errno == EINTR) {
+            continue;
+        }
+
+        if (finished) {
+            break;
+        }
+    }
+
+    close (event_fds_[1]);
+    event_fds_[1] = -1;
+#endif
+
+#ifdef _WIN32
+    _close (event_fds_[0]);
+#else
+    close (event_fds_[0]);
+#endif
+    event_fds_[0] = -1;
+} // ExecutionHandle::collect_
+
+
+void
+ExecutionHandle::dispatch_ (NodeEvent& event)
+{
+    event.node[sizeof (event.node) - 1] = '\0';
+    auto& counts = counts_[event.node];
+
+    // nodes publish their final counts with a progress event right before they finish.
+    if (event.state == DC_NODE_FINISHED || event.state == DC_NODE_FAILED) {
+        event.tokens_in = std::max (event.tokens_in, counts.first);
+        event.tokens_out = std::max (event.tokens_out, counts.second);
+    }
+    else {
+        counts = {event.tokens_in, event.tokens_out};
+    }
+
+    events_.push (event);
+
+    Callback callback;
+    {
+        std::lock_guard lock (callback_mutex_);
+        callback = callback_;
+    }
+
+    if (callback) {
+        callback (event);
+    }
+} // ExecutionHandle::dispatch_
+
+
+void
+ExecutionHandle::set_callback (Callback callback)
+{
+    {
+        std::lock_guard lock (callback_mutex_);
+        std::swap (callback_, callback);
+    }
+    // the previous callback is released here, outside the lock.
+} // ExecutionHandle::set_callback
+
+
+void
+ExecutionHandle::wait() const
+{
+    future_.wait();
+} // ExecutionHandle::wait
+
+
+bool
+ExecutionHandle::wait_for (unsigned int milliseconds) const
+{
+    return future_.wait_for (std::chrono::milliseconds (milliseconds)) == std::future_status::ready;
+} // ExecutionHandle::wait_for
+
+
+bool
+ExecutionHandle::done() const
+{
+    return wait_for (0);
+} // ExecutionHandle::done
+
+
+bool
+ExecutionHandle::result() const
+{
+    return future_.get();
+} // ExecutionHandle::result
+
+
+void
+ExecutionHandle::cancel()
+{
+    token_.cancel();
+    context_->Cancel();
+} // ExecutionHandle::cancel
+
+
+void
+ExecutionHandle::terminate()
+{
+    context_->Terminate();
+} // ExecutionHandle::terminate
+
+
+std::vector<NodeEvent>
+ExecutionHandle::events()
+{
+    std::vector<NodeEvent> drained;
+    NodeEvent event{};
+
+    while (events_.pop (event)) {
+        drained.push_back (event);
+    }
+
+    return drained;
+} // ExecutionHandle::events
+} // namespace daisychain
@@ -0,0 +1,149 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "executioncontext.h"
+#include "logger.h"
+#include "node.h"
+
+
+namespace daisychain {
+using namespace std;
+
+
+// Bounded single-producer/single-consumer ring buffer. The producer is the thread collecting
+// node events and the consumer is whoever polls the handle, so neither side ever takes a lock.
+template <typename T, size_t N>
+class EventQueue
+{
+    static_assert ((N & (N - 1)) == 0, "EventQueue capacity must be a power of two.");
+
+public:
+    bool push (const T& item)
+    {
+        auto head = head_.load (std::memory_order_relaxed);
+        if (head - tail_.load (std::memory_order_acquire) == N) {
+            dropped_.fetch_add (1, std::memory_order_relaxed);
+            return false;
+        }
+
+        buffer_[head & (N - 1)] = item;
+        head_.store (head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    bool pop (T& item)
+    {
+        auto tail = tail_.load (std::memory_order_relaxed);
+        if (tail == head_.load (std::memory_order_acquire)) {
+            return false;
+        }
+
+        item = buffer_[tail & (N - 1)];
+        tail_.store (tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    [[nodiscard]] size_t dropped() const { return dropped_.load (std::memory_order_relaxed); }
+
+private:
+    std::array<T, N> buffer_{};
+    alignas (64) std::atomic<size_t> head_{0};
+    alignas (64) std::atomic<size_t> tail_{0};
+    std::atomic<size_t> dropped_{0};
+};
+
+
+// Cooperative cancellation shared with every node of a run. On POSIX the node processes poll
+// the read end of a pipe; cancel() makes it readable, and nodes stop taking new input and
+// send EOF downstream, so the graph drains instead of being killed.
+class CancellationToken
+{
+public:
+    CancellationToken();
+
+    ~CancellationToken();
+
+    void cancel();
+
+    [[nodiscard]] bool cancelled() const { return cancelled_.load(); }
+
+    [[nodiscard]] int fd() const { return fds_[0]; }
+
+private:
+    std::atomic<bool> cancelled_;
+    int fds_[2];
+};
+
+
+class ExecutionHandle
+{
+public:
+    using Callback = std::function<void (const NodeEvent&)>;
+
+    explicit ExecutionHandle (std::shared_ptr<ExecutionContext> context);
+
+    ~ExecutionHandle();
+
+    void Start (const std::function<bool (ExecutionContext&)>& run);
+
+    // called on the collector thread for every event; may be set while the run is going.
+    void set_callback (Callback callback);
+
+    std::shared_future<bool> future() const { return future_; }
+
+    void wait() const;
+
+    bool wait_for (unsigned int milliseconds) const;
+
+    [[nodiscard]] bool done() const;
+
+    bool result() const;
+
+    void cancel();
+
+    void terminate();
+
+    [[nodiscard]] bool cancelled() const { return token_.cancelled(); }
+
+    bool poll (NodeEvent& event) { return events_.pop (event); }
+
+    std::vector<NodeEvent> events();
+
+    [[nodiscard]] size_t dropped_events() const { return events_.dropped(); }
+
+    std::shared_ptr<ExecutionContext> context() const { return context_; }
+
+private:
+    void collect_();
+
+    void dispatch_ (NodeEvent& event);
+
+    std::shared_ptr<ExecutionContext> context_;
+    CancellationToken token_;
+    EventQueue<NodeEvent, 4096> events_;
+    Callback callback_;
+    std::mutex callback_mutex_;
+    std::shared_future<bool> future_;
+    std::thread runner_;
+    std::thread collector_;
+    std::atomic<bool> finished_;
+    int event_fds_[2];
+    map<string, pair<uint64_t, uint64_t>> counts_;
+};
+} // namespace daisychain
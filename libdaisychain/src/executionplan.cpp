@@ -0,0 +1,131 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "executionplan.h"
+
+
+namespace daisychain {
+using namespace std;
+
+
+ExecutionPlan::ExecutionPlan (const map<string, std::shared_ptr<Node>>& nodes, const list<Edge>& edges)
+{
+    nodes_.reserve (nodes.size());
+    uuids_.reserve (nodes.size());
+    ids_.reserve (nodes.size());
+
+    for (const auto& [uuid, node] : nodes) {
+        ids_[uuid] = uint32_t (nodes_.size());
+        nodes_.push_back (node);
+        uuids_.push_back (uuid);
+    }
+
+    edges_.reserve (edges.size());
+
+    for (const auto& [parent, child] : edges) {
+        auto source = ids_.find (parent);
+        auto target = ids_.find (child);
+
+        if (source == ids_.end() || target == ids_.end()) {
+            LERROR << "Connection to unknown node skipped: " << parent << "." << child;
+            continue;
+        }
+
+        edges_.push_back ({source->second, target->second, parent + "." + child});
+    }
+
+    build_csr_();
+    sort_();
+} // ExecutionPlan::ExecutionPlan
+
+
+int64_t
+ExecutionPlan::id (const string& uuid) const
+{
+    auto it = ids_.find (uuid);
+
+    return it == ids_.end() ? -1 : int64_t (it->second);
+} // ExecutionPlan::id
+
+
+vector<string>
+ExecutionPlan::ordered_uuids() const
+{
+    vector<string> ordered;
+    ordered.reserve (order_.size());
+
+    for (auto id : order_) {
+        ordered.push_back (uuids_[id]);
+    }
+
+    return ordered;
+} // ExecutionPlan::ordered_uuids
+
+
+void
+ExecutionPlan::build_csr_()
+{
+    const auto numnodes = nodes_.size();
+
+    out_offsets_.assign (numnodes + 1, 0);
+    in_offsets_.assign (numnodes + 1, 0);
+
+    for (const auto& edge : edges_) {
+        ++out_offsets_[edge.source + 1];
+        ++in_offsets_[edge.target + 1];
+    }
+
+    for (size_t i = 0; i < numnodes; ++i) {
+        out_offsets_[i + 1] += out_offsets_[i];
+        in_offsets_[i + 1] += in_offsets_[i];
+    }
+
+    out_edges_.resize (edges_.size());
+    in_edges_.resize (edges_.size());
+
+    // fill cursors start at each row's offset; edges keep their connection order per row.
+    vector<uint32_t> out_fill (out_offsets_.begin(), out_offsets_.end() - 1);
+    vector<uint32_t> in_fill (in_offsets_.begin(), in_offsets_.end() - 1);
+
+    for (uint32_t e = 0; e < edges_.size(); ++e) {
+        out_edges_[out_fill[edges_[e].source]++] = e;
+        in_edges_[in_fill[edges_[e].target]++] = e;
+    }
+} // ExecutionPlan::build_csr_
+
+
+void
+ExecutionPlan::sort_()
+{
+    // Kahn's algorithm; nodes left over with a non-zero in-degree sit on a cycle.
+    const auto numnodes = uint32_t (nodes_.size());
+    vector<uint32_t> indegree (numnodes);
+
+    order_.clear();
+    order_.reserve (numnodes);
+    roots_.clear();
+
+    for (uint32_t id = 0; id < numnodes; ++id) {
+        indegree[id] = in_degree (id);
+
+        if (indegree[id] == 0) {
+            order_.push_back (id);
+            roots_.push_back (id);
+        }
+    }
+
+    for (size_t head = 0; head < order_.size(); ++head) {
+        auto [begin, end] = out_edges (order_[head]);
+
+        for (auto it = begin; it != end; ++it) {
+            auto target = edges_[*it].target;
+
+            if (--indegree[target] == 0) {
+                order_.push_back (target);
+            }
+        }
+    }
+} // ExecutionPlan::sort_
+} // namespace daisychain
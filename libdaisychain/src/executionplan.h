@@ -0,0 +1,95 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "logger.h"
+#include "node.h"
+
+
+namespace daisychain {
+using namespace std;
+using Edge = pair<string, string>;
+
+
+// Flattened, read-only form of a Graph. Nodes get dense integer ids in [0, size()) and the
+// connections are stored in compressed sparse row form (offsets into one contiguous edge
+// array), so scheduling and execution walk plain arrays instead of maps keyed by UUID.
+// A plan is rebuilt whenever the graph changes and shared by every run started from it.
+class ExecutionPlan
+{
+public:
+    struct PlanEdge
+    {
+        uint32_t source;
+        uint32_t target;
+        string fifo;
+    };
+
+    ExecutionPlan (const map<string, std::shared_ptr<Node>>& nodes, const list<Edge>& edges);
+
+    [[nodiscard]] uint32_t size() const { return uint32_t (nodes_.size()); }
+
+    [[nodiscard]] bool acyclic() const { return order_.size() == nodes_.size(); }
+
+    const std::shared_ptr<Node>& node (uint32_t id) const { return nodes_[id]; }
+
+    const string& uuid (uint32_t id) const { return uuids_[id]; }
+
+    // dense id of a node, or -1 when the uuid is not part of the plan.
+    [[nodiscard]] int64_t id (const string& uuid) const;
+
+    const vector<PlanEdge>& edges() const { return edges_; }
+
+    // ids of the edges leaving / entering a node, as contiguous spans of the CSR arrays.
+    pair<const uint32_t*, const uint32_t*> out_edges (uint32_t id) const
+    {
+        return {out_edges_.data() + out_offsets_[id], out_edges_.data() + out_offsets_[id + 1]};
+    }
+
+    pair<const uint32_t*, const uint32_t*> in_edges (uint32_t id) const
+    {
+        return {in_edges_.data() + in_offsets_[id], in_edges_.data() + in_offsets_[id + 1]};
+    }
+
+    [[nodiscard]] uint32_t out_degree (uint32_t id) const { return out_offsets_[id + 1] - out_offsets_[id]; }
+
+    [[nodiscard]] uint32_t in_degree (uint32_t id) const { return in_offsets_[id + 1] - in_offsets_[id]; }
+
+    // topological order; shorter than size() when the graph has a cycle.
+    const vector<uint32_t>& order() const { return order_; }
+
+    const vector<uint32_t>& roots() const { return roots_; }
+
+    vector<string> ordered_uuids() const;
+
+private:
+    void build_csr_();
+
+    void sort_();
+
+    vector<std::shared_ptr<Node>> nodes_;
+    vector<string> uuids_;
+    std::unordered_map<string, uint32_t> ids_;
+    vector<PlanEdge> edges_;
+
+    vector<uint32_t> out_offsets_;
+    vector<uint32_t> out_edges_;
+    vector<uint32_t> in_offsets_;
+    vector<uint32_t> in_edges_;
+
+    vector<uint32_t> order_;
+    vector<uint32_t> roots_;
+};
+} // namespace daisychain
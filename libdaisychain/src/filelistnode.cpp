@@ -4,6 +4,8 @@
 // See LICENSE file for full license text.
 
 #include "filelistnode.h"
+#include <cstring>
+#include <future>
 #include <string>
 
 
@@ -24,31 +26,12 @@ FileListNode::Execute (vector<string>& inputs, const string& sandbox, json& vars
     LINFO << "Executing " << (isroot_ ? "root: " : "node: ") << name_;
 
     if (isroot_) {
-        for (auto& input : inputs) {
-            std::ifstream infile (input);
-            std::string line;
-
-            while (std::getline (infile, line)) {
-                OpenOutputs (sandbox);
-                WriteOutputs (line);
-                CloseOutputs();
-            }
-        }
+        emit_ (inputs, sandbox);
     }
     else {
         while (eofs_ <= fd_in_.size() && !terminate_.load()) {
-            for (auto& input : inputs) {
-                if (input != "EOF") {
-                    std::ifstream infile (input);
-                    std::string line;
-
-                    while (std::getline (infile, line)) {
-                        OpenOutputs (sandbox);
-                        WriteOutputs (line);
-                        CloseOutputs();
-                    }
-                }
-            }
+            std::erase (inputs, "EOF");
+            emit_ (inputs, sandbox);
 
             inputs.clear();
 
@@ -72,4 +55,84 @@ FileListNode::Execute (vector<string>& inputs, const string& sandbox, json& vars
 } // FileListNode::Execute
 
 
+void
+FileListNode::emit_ (const vector<string>& files, const string& sandbox)
+{
+    std::future<MappedFile> next;
+
+    for (size_t i = 0; i < files.size() && !cancelled_.load(); ++i) {
+        // the file being sent streams in behind MADV_SEQUENTIAL; only the next one is read
+        // ahead in full, on the helper thread.
+        auto file = next.valid() ? next.get() : load_ (files[i], false);
+
+        if (i + 1 < files.size()) {
+            next = std::async (std::launch::async, &FileListNode::load_, files[i + 1], true);
+        }
+
+        if (!file.is_open()) {
+            LWARN << LOGNODE << "Cannot read file list: " << files[i];
+            continue;
+        }
+
+        OpenOutputs (sandbox);
+        send_ (file.view());
+        CloseOutputs();
+    }
+
+    if (next.valid()) {
+        next.wait();
+    }
+} // FileListNode::emit_
+
+
+void
+FileListNode::send_ (std::string_view lines)
+{
+    const char* base = lines.data();
+    size_t start = 0;
+
+    while (start < lines.size() && !cancelled_.load()) {
+        // whole lines, as many as fit in one block; a longer line goes out on its own.
+        size_t end = start;
+        size_t count = 0;
+
+        while (end < lines.size()) {
+            auto* newline = static_cast<const char*> (std::memchr (base + end, '\n', lines.size() - end));
+            size_t next = newline ? size_t (newline - base) + 1 : lines.size();
+
+            if (count && next - start > DAISY_BLOCK_SIZE) {
+                break;
+            }
+
+            end = next;
+            ++count;
+        }
+
+        if (base[end - 1] == '\n') {
+            WriteBlock (lines.substr (start, end - start), count);
+        }
+        else {
+            // the last line of a file without a trailing newline.
+            string block (lines.substr (start, end - start));
+            block += '\n';
+            WriteBlock (block, count);
+        }
+
+        start = end;
+    }
+} // FileListNode::send_
+
+
+MappedFile
+FileListNode::load_ (const string& path, bool prefetch)
+{
+    string scratch;
+    MappedFile file (token_path (path, scratch));
+
+    if (prefetch) {
+        file.Prefetch();
+    }
+
+    return file;
+} // FileListNode::load_
 } // namespace daisychain
@@ -5,10 +5,14 @@
 
 #pragma once
 
+#include "mappedfile.h"
 #include "node.h"
 
 
 namespace daisychain {
+// Emits every line of its input files. Files are memory mapped and their lines are sent
+// downstream in blocks straight out of the mapping; the next file is mapped and read ahead
+// on a helper thread while the current one is being sent.
 class FileListNode final : public Node
 {
 public:
@@ -19,5 +23,12 @@ public:
 private:
     // not exposed
     using Node::set_batch_flag;
+
+    void emit_ (const vector<string>& files, const string& sandbox);
+
+    void send_ (std::string_view lines);
+
+    // maps path; with prefetch, also reads it into the page cache before returning.
+    static MappedFile load_ (const string& path, bool prefetch);
 };
 } // namespace daisychain
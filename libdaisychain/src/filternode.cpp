@@ -4,28 +4,18 @@
 // See LICENSE file for full license text.
 
 #include "filternode.h"
-#ifdef _WIN32
-#include <shlwapi.h>
-#pragma comment(lib, "Shlwapi.lib")
-#else
-#include <fnmatch.h>
-#endif
-#include <regex>
+#include "matcher.h"
 #include <utility>
 
 
-#if defined(__APPLE__)
-#define FNM_EXTMATCH 0
-#endif // if defined(__APPLE__)
-
-
 namespace daisychain {
 using namespace std;
 
 
 FilterNode::FilterNode() :
     regex_ (false),
-    invert_ (false)
+    invert_ (false),
+    cache_size_ (0)
 {
     type_ = DaisyNodeType::DC_FILTER;
     set_name (DaisyNodeNameByType[type_]);
@@ -35,7 +25,8 @@ FilterNode::FilterNode() :
 FilterNode::FilterNode (string filter, bool is_regex = false, bool negate = false) :
     regex_ (is_regex),
     invert_ (negate),
-    filter_ (std::move (filter))
+    filter_ (std::move (filter)),
+    cache_size_ (0)
 {
     type_ = DaisyNodeType::DC_FILTER;
     set_name (DaisyNodeNameByType[type_]);
@@ -57,6 +48,10 @@ FilterNode::Initialize (json& keydata, bool keep_uuid)
     if (data.count ("negate")) {
         set_invert (data["negate"]);
     }
+
+    if (data.count ("cache")) {
+        set_cache_size (data["cache"].get<size_t>());
+    }
 }
 
 
@@ -65,38 +60,29 @@ FilterNode::Execute (vector<string>& inputs, const string& sandbox, json& vars)
 {
     LINFO << "Executing " << (isroot_ ? "root: " : "node: ") << name_;
 
-    std::regex expr;
+    Matcher matcher;
+    matcher.set_cache_size (cache_size_);
 
-    if (regex_) {
-        try {
-            expr = std::regex (filter_);
-        }
-        catch (const std::regex_error& e) {
-            LERROR << "regex_error caught: " << e.what();
-            OpenOutputs (sandbox);
-            WriteOutputs ("EOF");
-            CloseOutputs();
+    // tokens match by their path, whatever attributes they carry.
+    string path;
 
-            return false;
-        }
+    try {
+        matcher.Add (filter_, regex_);
+    }
+    catch (const std::regex_error& e) {
+        LERROR << "regex_error caught: " << e.what();
+        OpenOutputs (sandbox);
+        WriteOutputs ("EOF");
+        CloseOutputs();
+
+        return false;
     }
 
     if (isroot_) {
         LDEBUG << "Root: " << name_;
 
         for (auto& input : inputs) {
-            bool match = false;
-
-            if (regex_) {
-                match = std::regex_match (input, expr);
-            }
-#ifdef _WIN32
-            else if (PathMatchSpec (input.c_str(), filter_.c_str())) {
-#else
-            else if (fnmatch (filter_.c_str(), input.c_str(), FNM_PERIOD | FNM_EXTMATCH) == 0) {
-#endif
-                match = true;
-            }
+            bool match = matcher.First (token_path (input, path)) == 0;
 
             if (match ^ invert_) {
                 LDEBUG << "Matched: " << input;
@@ -113,18 +99,7 @@ FilterNode::Execute (vector<string>& inputs, const string& sandbox, json& vars)
         while (eofs_ <= fd_in_.size() && !terminate_.load()) {
             for (auto& input : inputs) {
                 if (input != "EOF") {
-                    bool match = false;
-
-                    if (regex_) {
-                        match = std::regex_match (input, expr);
-                    }
-#ifdef _WIN32
-                    else if (PathMatchSpec (input.c_str(), filter_.c_str())) {
-#else
-                    else if (fnmatch (filter_.c_str(), input.c_str(), FNM_PERIOD | FNM_EXTMATCH) == 0) {
-#endif
-                        match = true;
-                    }
+                    bool match = matcher.First (token_path (input, path)) == 0;
 
                     if (match ^ invert_) {
                         LDEBUG << "Matched: " << input;
@@ -167,6 +142,8 @@ FilterNode::Serialize()
     json_[id_]["regex"] = regex_;
     json_[id_]["negate"] = invert_;
 
+    if (cache_size_) {json_[id_]["cache"] = cache_size_;}
+
     if (size_ != std::pair<int, int>(0,0)) {json_[id_]["size"] = size_;}
 
     return json_;
@@ -201,6 +178,20 @@ FilterNode::invert() const
 } // FilterNode::invert
 
 
+void
+FilterNode::set_cache_size (size_t size)
+{
+    cache_size_ = size;
+} // FilterNode::set_cache_size
+
+
+size_t
+FilterNode::cache_size() const
+{
+    return cache_size_;
+} // FilterNode::cache_size
+
+
 void
 FilterNode::set_filter (const string& filter)
 {
@@ -34,6 +34,11 @@ public:
 
     bool invert() const;
 
+    // number of recent tokens whose result is remembered; 0 (default) disables it.
+    void set_cache_size (size_t size);
+
+    size_t cache_size() const;
+
 private:
     // not exposed
     using Node::set_batch_flag;
@@ -42,5 +47,6 @@ private:
     bool regex_;
     bool invert_;
     string filter_;
+    size_t cache_size_;
 };
 } // namespace daisychain
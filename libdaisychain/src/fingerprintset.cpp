@@ -0,0 +1,291 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "fingerprintset.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+
+// smallest table an exact set starts from.
+#define MIN_SLOTS 1024
+
+// 64-bit words per Bloom block, one cache line.
+#define BLOCK_WORDS 8
+
+
+namespace daisychain {
+using namespace std;
+
+
+namespace {
+// splitmix64 finalizer.
+uint64_t
+mix (uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+
+    return x;
+}
+} // namespace
+
+
+uint64_t
+fingerprint (std::string_view token)
+{
+    // std::hash is plain FNV-1a on some platforms; mixing spreads it over all 64 bits.
+    auto hash = mix (std::hash<std::string_view>{} (token));
+
+    return hash ? hash : 1;
+} // fingerprint
+
+
+FingerprintSet::FingerprintSet (size_t capacity, std::chrono::milliseconds window, Clock::time_point now) :
+    window_ (std::max (window, std::chrono::milliseconds (0))),
+    start_ (now)
+{
+    size_t count = MIN_SLOTS;
+
+    while (count / 2 < capacity) {
+        count *= 2;
+    }
+
+    slots_.assign (count, 0);
+
+    if (window_.count() > 0) {
+        times_.assign (count, 0);
+    }
+}
+
+
+bool
+FingerprintSet::Insert (uint64_t fingerprint, Clock::time_point now)
+{
+    auto ticks = window_.count() > 0 ? ticks_ (now) : 0;
+
+    if (slots_.empty()) {
+        rebuild_ (ticks);
+    }
+
+    auto mask = slots_.size() - 1;
+
+    for (auto i = size_t (fingerprint) & mask;; i = (i + 1) & mask) {
+        if (slots_[i] == fingerprint) {
+            if (window_.count() == 0 || ticks - times_[i] < window_.count()) {
+                return false;
+            }
+
+            times_[i] = ticks;
+            return true;
+        }
+
+        if (slots_[i] == 0) {
+            // kept under 70% full, so probes stay short.
+            if ((size_ + 1) * 10 > slots_.size() * 7) {
+                rebuild_ (ticks);
+                return Insert (fingerprint, now);
+            }
+
+            slots_[i] = fingerprint;
+            if (window_.count() > 0) {
+                times_[i] = ticks;
+            }
+            ++size_;
+
+            return true;
+        }
+    }
+} // FingerprintSet::Insert
+
+
+void
+FingerprintSet::Clear()
+{
+    std::fill (slots_.begin(), slots_.end(), 0);
+    std::fill (times_.begin(), times_.end(), 0);
+    size_ = 0;
+} // FingerprintSet::Clear
+
+
+int64_t
+FingerprintSet::ticks_ (Clock::time_point now) const
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds> (now - start_).count();
+} // FingerprintSet::ticks_
+
+
+void
+FingerprintSet::rebuild_ (int64_t now)
+{
+    auto live = [&] (size_t i) {
+        return slots_[i] != 0 && (window_.count() == 0 || now - times_[i] < window_.count());
+    };
+
+    size_t count = 0;
+
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        count += live (i);
+    }
+
+    // half full at most afterwards; a windowed set whose entries expired keeps its size.
+    size_t size = std::max<size_t> (slots_.size(), MIN_SLOTS);
+
+    while ((count + 1) * 2 > size) {
+        size *= 2;
+    }
+
+    vector<uint64_t> slots (size, 0);
+    vector<int64_t> times (window_.count() > 0 ? size : 0, 0);
+    auto mask = size - 1;
+
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        if (!live (i)) {
+            continue;
+        }
+
+        auto j = size_t (slots_[i]) & mask;
+
+        while (slots[j] != 0) {
+            j = (j + 1) & mask;
+        }
+
+        slots[j] = slots_[i];
+        if (!times.empty()) {
+            times[j] = times_[i];
+        }
+    }
+
+    slots_.swap (slots);
+    times_.swap (times);
+    size_ = count;
+} // FingerprintSet::rebuild_
+
+
+BloomFilter::BloomFilter (size_t bytes, size_t capacity, std::chrono::milliseconds window, Clock::time_point now) :
+    window_ (std::max (window, std::chrono::milliseconds (0))),
+    rotated_ (now)
+{
+    auto generation = window_.count() > 0 ? bytes / 2 : bytes;
+    blocks_ = std::max<size_t> (generation / (BLOCK_WORDS * sizeof (uint64_t)), 1);
+
+    current_.assign (blocks_ * BLOCK_WORDS, 0);
+
+    if (window_.count() > 0) {
+        previous_.assign (blocks_ * BLOCK_WORDS, 0);
+    }
+
+    // the count that minimizes false positives for the bits available per token.
+    if (capacity) {
+        auto bits = double (blocks_ * BLOCK_WORDS * 64) / double (capacity);
+        hashes_ = (unsigned int) std::clamp (std::lround (bits * std::log (2.0)), 1L, 16L);
+    }
+}
+
+
+bool
+BloomFilter::Insert (uint64_t fingerprint, Clock::time_point now)
+{
+    if (current_.empty()) {
+        return true;
+    }
+
+    if (window_.count() > 0 && now - rotated_ >= window_) {
+        if (now - rotated_ >= 2 * window_) {
+            std::fill (previous_.begin(), previous_.end(), 0);
+        }
+        else {
+            previous_.swap (current_);
+        }
+
+        std::fill (current_.begin(), current_.end(), 0);
+        inserted_ = 0;
+        rotated_ = now;
+    }
+
+    if (test_ (current_, fingerprint) || (!previous_.empty() && test_ (previous_, fingerprint))) {
+        return false;
+    }
+
+    set_ (current_, fingerprint);
+    ++inserted_;
+
+    return true;
+} // BloomFilter::Insert
+
+
+void
+BloomFilter::Clear()
+{
+    std::fill (current_.begin(), current_.end(), 0);
+    std::fill (previous_.begin(), previous_.end(), 0);
+    inserted_ = 0;
+} // BloomFilter::Clear
+
+
+double
+BloomFilter::false_positive_rate() const
+{
+    if (current_.empty()) {
+        return 0.0;
+    }
+
+    auto bits = double (current_.size() * 64);
+
+    return std::pow (1.0 - std::exp (-double (hashes_) * double (inserted_) / bits), double (hashes_));
+} // BloomFilter::false_positive_rate
+
+
+bool
+BloomFilter::test_ (const vector<uint64_t>& bits, uint64_t fingerprint) const
+{
+    const auto* block = bits.data() + (fingerprint % blocks_) * BLOCK_WORDS;
+
+    uint64_t hash = 0;
+
+    for (unsigned int i = 0; i < hashes_; ++i) {
+        auto bit = bit_ (fingerprint, i, hash);
+
+        if (!(block[bit / 64] & (uint64_t (1) << (bit % 64)))) {
+            return false;
+        }
+    }
+
+    return true;
+} // BloomFilter::test_
+
+
+void
+BloomFilter::set_ (vector<uint64_t>& bits, uint64_t fingerprint)
+{
+    auto* block = bits.data() + (fingerprint % blocks_) * BLOCK_WORDS;
+
+    uint64_t hash = 0;
+
+    for (unsigned int i = 0; i < hashes_; ++i) {
+        auto bit = bit_ (fingerprint, i, hash);
+        block[bit / 64] |= uint64_t (1) << (bit % 64);
+    }
+} // BloomFilter::set_
+
+
+unsigned int
+BloomFilter::bit_ (uint64_t fingerprint, unsigned int i, uint64_t& hash)
+{
+    // each position takes its own 9 bits of a second hash, so positions do not depend on the
+    // block or on each other; seven fit in one hash before it is rehashed.
+    if (i % 7 == 0) {
+        hash = mix (fingerprint + i);
+    }
+
+    auto bit = unsigned (hash % (BLOCK_WORDS * 64));
+    hash >>= 9;
+
+    return bit;
+} // BloomFilter::bit_
+} // namespace daisychain
@@ -0,0 +1,107 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+
+namespace daisychain {
+using namespace std;
+
+
+// 64-bit fingerprint of a token; never 0.
+uint64_t fingerprint (std::string_view token);
+
+
+// Remembers the fingerprints of tokens that were let through. Insert() is true when a token
+// should go on: it was not seen before, or with a window set, was last let through at least the
+// window ago. Fingerprints sit in an open-addressing table with linear probing, 8 bytes each,
+// plus 8 for the time when a window is set. Expired entries are dropped when the table is
+// rebuilt, so a windowed set only grows with the tokens seen within the window.
+class FingerprintSet
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    FingerprintSet() = default;
+
+    // capacity is the number of tokens expected; the table grows past it as needed.
+    FingerprintSet (size_t capacity, std::chrono::milliseconds window, Clock::time_point now);
+
+    bool Insert (uint64_t fingerprint, Clock::time_point now);
+
+    void Clear();
+
+    [[nodiscard]] size_t size() const { return size_; }
+
+    [[nodiscard]] size_t memory() const { return (slots_.size() + times_.size()) * sizeof (uint64_t); }
+
+private:
+    [[nodiscard]] int64_t ticks_ (Clock::time_point now) const;
+
+    // rebuilds the table without expired entries, larger if the live ones need it.
+    void rebuild_ (int64_t now);
+
+    std::chrono::milliseconds window_{0};
+    Clock::time_point start_;
+
+    // 0 marks an empty slot; times_ is empty without a window.
+    vector<uint64_t> slots_;
+    vector<int64_t> times_;
+    size_t size_ = 0;
+};
+
+
+// Approximate FingerprintSet in a fixed amount of memory: a blocked Bloom filter, where each
+// token sets hashes bits within one 64-byte block, so a lookup touches a single cache line. A
+// token never seen before is taken for a repeat at the false positive rate; a repeat is never
+// let through early.
+//
+// With a window, memory is split between two generations that swap every window, and a token is
+// a repeat if either holds it. A token is therefore remembered for between one and two windows.
+class BloomFilter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    BloomFilter() = default;
+
+    // capacity is the number of distinct tokens expected per window, used to pick the number of
+    // hashes; 0 assumes about 10 bits per token.
+    BloomFilter (size_t bytes, size_t capacity, std::chrono::milliseconds window, Clock::time_point now);
+
+    bool Insert (uint64_t fingerprint, Clock::time_point now);
+
+    void Clear();
+
+    [[nodiscard]] size_t memory() const { return (current_.size() + previous_.size()) * sizeof (uint64_t); }
+
+    [[nodiscard]] unsigned int hashes() const { return hashes_; }
+
+    // estimated for the tokens inserted into the current generation so far.
+    [[nodiscard]] double false_positive_rate() const;
+
+private:
+    [[nodiscard]] bool test_ (const vector<uint64_t>& bits, uint64_t fingerprint) const;
+
+    void set_ (vector<uint64_t>& bits, uint64_t fingerprint);
+
+    // position in its block of the i-th bit of fingerprint; hash carries state between calls.
+    static unsigned int bit_ (uint64_t fingerprint, unsigned int i, uint64_t& hash);
+
+    std::chrono::milliseconds window_{0};
+    Clock::time_point rotated_;
+    unsigned int hashes_ = 7;
+    size_t blocks_ = 0;
+
+    vector<uint64_t> current_;
+    vector<uint64_t> previous_;
+    size_t inserted_ = 0;
+};
+} // namespace daisychain
@@ -20,10 +20,14 @@
 namespace daisychain {
 
 
-Graph::Graph() : running_ (false), cleanup_ (true), test_ (false) { Initialize(); }
+Graph::Graph() : cleanup_ (true), test_ (false), sandbox_busy_ (false) { Initialize(); }
 
 
-Graph::Graph (const string& filename) : filename_ (filename), running_ (false), cleanup_ (true), test_ (false)
+Graph::Graph (const string& filename) :
+    filename_ (filename),
+    cleanup_ (true),
+    test_ (false),
+    sandbox_busy_ (false)
 {
     Initialize (filename);
 }
@@ -49,11 +53,8 @@ Graph::Initialize (const string& filename)
     test_ = false;
     nodes_.clear();
     edges_.clear();
-    ordered_.clear();
-    adjacencylist_.clear();
-#ifndef _WIN32
-    process_group_ = 0;
-#endif
+    children_.clear();
+    invalidate_();
 
     if (!filename_.empty()) {
         LINFO <<  "Initializing graph from file: " << filename_;
@@ -101,6 +102,8 @@ Graph::Serialize()
 bool
 Graph::Parse (const json& json_graph)
 {
+    TIMED_SCOPE (timerObj, "Graph::Parse()");
+
     std::unordered_map<string, string> oldkeynew;
 
     if (json_graph.contains ("nodes")) {
@@ -122,6 +125,9 @@ Graph::Parse (const json& json_graph)
     }
 
     if (json_graph.contains ("connections")) {
+        // connections go in as one batch so the graph is checked for cycles once.
+        list<Edge> connections;
+
         for (auto& connection : json_graph["connections"]) {
             string output = connection[0];
             string input = connection[1];
@@ -134,8 +140,10 @@ Graph::Parse (const json& json_graph)
                 input = oldkeynew.at (connection[1]);
             }
 
-            Connect (output, input);
+            connections.emplace_back (output, input);
         }
+
+        Connect (connections);
     }
 
     if (json_graph.contains ("environment")) {
@@ -182,51 +190,283 @@ Graph::Save (const string& filename)
 } // Graph::Save
 
 
+std::shared_ptr<const ExecutionPlan>
+Graph::Compile()
+{
+    std::lock_guard lock (plan_mutex_);
+
+    // a plan with inlined subgraphs is only as current as the files it was built from.
+    if (plan_ != nullptr && !subgraph_files_.empty()) {
+        for (const auto& [file, time] : subgraph_files_) {
+            std::error_code ec;
+
+            if (fs::last_write_time (file, ec) != time) {
+                LDEBUG << "Subgraph file changed: " << file;
+                plan_.reset();
+                break;
+            }
+        }
+    }
+
+    if (plan_ == nullptr && has_subgraphs_()) {
+        // the definition keeps its subgraph nodes; only the plan sees them inlined.
+        auto nodes = nodes_;
+        auto edges = edges_;
+        subgraph_files_.clear();
+        inline_subgraphs_ (nodes, edges, subgraph_files_);
+        plan_ = std::make_shared<const ExecutionPlan> (nodes, edges);
+        LDEBUG << "Compiled plan: " << plan_->size() << " nodes, " << plan_->edges().size() << " edges.";
+    }
+    else if (plan_ == nullptr) {
+        subgraph_files_.clear();
+        plan_ = std::make_shared<const ExecutionPlan> (nodes_, edges_);
+        LDEBUG << "Compiled plan: " << plan_->size() << " nodes, " << plan_->edges().size() << " edges.";
+    }
+
+    return plan_;
+} // Graph::Compile
+
+
+void
+Graph::inline_subgraphs_ (map<string, std::shared_ptr<Node>>& nodes, list<Edge>& edges,
+                          map<string, fs::file_time_type>& files) const
+{
+    const int max_depth = 16;
+    const fs::path basedir = filename_.empty() ? fs::current_path() : fs::path (filename_).parent_path();
+
+    // subgraph uuid -> (directory of the file that defines it, nesting level)
+    std::unordered_map<string, pair<fs::path, int>> pending;
+    std::set<string> fresh;
+    std::set<string> touched;
+
+    for (const auto& [uuid, node] : nodes) {
+        if (node->type() == DC_SUBGRAPH) {
+            pending[uuid] = {basedir, 0};
+        }
+    }
+
+    while (!pending.empty()) {
+        auto [uuid, location] = *pending.begin();
+        pending.erase (pending.begin());
+
+        auto subgraph = std::static_pointer_cast<SubgraphNode> (nodes.at (uuid));
+        fs::path file = subgraph->filename();
+
+        if (file.is_relative()) {
+            file = location.first / file;
+        }
+
+        // recorded before reading, so a file that is missing or broken now is retried once it
+        // changes.
+        std::error_code ec;
+        files[file.string()] = fs::last_write_time (file, ec);
+
+        if (location.second >= max_depth) {
+            LERROR << "Subgraph nesting too deep, recursive include? " << file.string();
+            continue;
+        }
+
+        std::ifstream filein (file);
+
+        if (!filein.is_open()) {
+            LERROR << "Failed to open subgraph file: " << file.string();
+            continue;
+        }
+
+        json json_graph;
+
+        try {
+            filein >> json_graph;
+        }
+        catch (const json::exception& e) {
+            LERROR << "Cannot parse subgraph file: " << file.string() << " " << e.what();
+            continue;
+        }
+
+        // every inlined node gets a fresh uuid, so one file can be used several times.
+        std::unordered_map<string, string> keys;
+        // the inlined nodes in the file's order, which is the order they are wired in.
+        vector<string> order;
+        list<Edge> internal;
+
+        // the file's environment applies to its nodes; what the including graph sets for the
+        // subgraph node wins.
+        json defaults = json_graph.contains ("environment") ? json_graph["environment"] : json::object();
+        defaults.merge_patch (subgraph->environment_defaults());
+
+        if (json_graph.contains ("nodes")) {
+            for (auto& [key, data] : json_graph["nodes"].items()) {
+                string id = m_gen_uuid();
+                json newdata = {
+                    {id, data}
+                };
+                auto node = CreateNode (newdata, true);
+
+                if (node == nullptr) {
+                    continue;
+                }
+
+                auto node_defaults = defaults;
+                node_defaults.merge_patch (node->environment_defaults());
+                node->set_environment_defaults (node_defaults);
+                node->set_name (subgraph->name() + "/" + node->name());
+                nodes[id] = node;
+                keys[key] = id;
+                order.push_back (id);
+                fresh.insert (id);
+
+                if (node->type() == DC_SUBGRAPH) {
+                    pending[id] = {file.parent_path(), location.second + 1};
+                }
+            }
+        }
+
+        if (json_graph.contains ("connections")) {
+            for (auto& connection : json_graph["connections"]) {
+                if (keys.count (connection[0]) && keys.count (connection[1])) {
+                    internal.emplace_back (keys.at (connection[0]), keys.at (connection[1]));
+                }
+            }
+        }
+
+        std::set<string> has_input;
+        std::set<string> has_output;
+
+        for (const auto& [parent, child] : internal) {
+            has_output.insert (parent);
+            has_input.insert (child);
+        }
+
+        // parent inputs go to the subgraph's roots, its leaves go to the parent's outputs. The
+        // new edges take the place of the one they replace, so the neighbours' ports keep their
+        // order (a router's rules index its outputs).
+        for (auto it = edges.begin(); it != edges.end();) {
+            if (it->second == uuid) {
+                for (const auto& id : order) {
+                    if (!has_input.count (id)) {
+                        edges.emplace (it, it->first, id);
+                    }
+                }
+                touched.insert (it->first);
+                it = edges.erase (it);
+            }
+            else if (it->first == uuid) {
+                for (const auto& id : order) {
+                    if (!has_output.count (id)) {
+                        edges.emplace (it, id, it->second);
+                    }
+                }
+                touched.insert (it->second);
+                it = edges.erase (it);
+            }
+            else {
+                ++it;
+            }
+        }
+
+        edges.splice (edges.end(), internal);
+        nodes.erase (uuid);
+        fresh.erase (uuid);
+        touched.erase (uuid);
+
+        LDEBUG << "Inlined subgraph: " << file.string() << " (" << keys.size() << " nodes)";
+    }
+
+    // definition nodes whose connections changed are replaced by copies, so the graph itself
+    // keeps its original ports.
+    for (const auto& uuid : touched) {
+        if (!nodes.count (uuid) || fresh.count (uuid)) {
+            continue;
+        }
+
+        json data = nodes.at (uuid)->Serialize();
+        auto clone = CreateNode (data, true);
+
+        if (clone == nullptr) {
+            LERROR << "Cannot copy node connected to a subgraph: " << nodes.at (uuid)->name();
+            continue;
+        }
+
+        nodes[uuid] = clone;
+        fresh.insert (uuid);
+    }
+
+    for (const auto& [parent, child] : edges) {
+        if (fresh.count (parent)) {
+            nodes.at (parent)->AddOutput (parent + "." + child);
+        }
+        if (fresh.count (child)) {
+            nodes.at (child)->AddInput (parent + "." + child);
+        }
+    }
+} // Graph::inline_subgraphs_
+
+
 bool
 Graph::PrepareFileSystem()
+{
+    return prepare_sandbox_ (sandbox_, Compile()->edges());
+} // Graph::PrepareFileSystem
+
+
+bool
+Graph::PrepareFileSystem (ExecutionContext& context)
+{
+    // an empty sandbox gets a fresh temp directory which the context then owns.
+    string sandbox = context.sandbox();
+    bool created = sandbox.empty();
+    bool status = prepare_sandbox_ (sandbox, Compile()->edges());
+    context.set_sandbox (sandbox, created || context.owns_sandbox());
+
+    return status;
+} // Graph::PrepareFileSystem
+
+
+bool
+Graph::prepare_sandbox_ (string& sandbox, const vector<ExecutionPlan::PlanEdge>& edges)
 {
     bool status = true;
     struct stat ss{};
 
 #ifdef _WIN32
-    if (sandbox_.empty()) {
+    if (sandbox.empty()) {
         char temp[] = "daisy-XXXXXX";
-        sandbox_ = mkdtemp_ (temp);
+        sandbox = mkdtemp_ (temp);
 
-        if (sandbox_.empty()) {
+        if (sandbox.empty()) {
             LERROR << "Temp directory creation failed.";
             status = false;
         }
     }
-    else if (stat (sandbox_.c_str(), &ss) != 0) {
-        if (auto ret = CreateDirectory (sandbox_.c_str(), nullptr); !ret) {
-            LERROR << "Cannot create directory: " + sandbox_;
+    else if (stat (sandbox.c_str(), &ss) != 0) {
+        if (auto ret = CreateDirectory (sandbox.c_str(), nullptr); !ret) {
+            LERROR << "Cannot create directory: " + sandbox;
             status = false;
         }
     }
 
 #else
-    if (sandbox_.empty()) {
+    if (sandbox.empty()) {
         char temp[] = "/tmp/daisy-XXXXXX";
-        sandbox_ = mkdtemp (temp);
+        sandbox = mkdtemp (temp);
 
-        if (sandbox_.empty()) {
+        if (sandbox.empty()) {
             LERROR << "Temp directory creation failed.";
             status = false;
         }
     }
-    else if (stat (sandbox_.c_str(), &ss) != 0) {
-        int ret = mkdir (sandbox_.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+    else if (stat (sandbox.c_str(), &ss) != 0) {
+        int ret = mkdir (sandbox.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
 
         if (ret != 0) {
-            LERROR << "Cannot create directory: " + sandbox_;
+            LERROR << "Cannot create directory: " + sandbox;
             status = false;
         }
     }
 
     if (status) {
-        for (const auto& edge : edges_) {
-            std::string filepath = sandbox_ + "/" + edge.first + "." + edge.second;
+        for (const auto& edge : edges) {
+            std::string filepath = sandbox + "/" + edge.fifo;
 
             if (stat (filepath.c_str(), &ss) != 0) {
                 int ret = mkfifo (filepath.c_str(), S_IRUSR | S_IWUSR | S_IWGRP);
@@ -241,7 +481,7 @@ Graph::PrepareFileSystem()
 #endif
 
     return status;
-} // Graph::PrepareFileSystem
+} // Graph::prepare_sandbox_
 
 
 bool
@@ -261,65 +501,158 @@ Graph::Execute (const string& input)
 bool
 Graph::Execute (const string& input, json& env)
 {
-    TIMED_SCOPE (timerObj, "Graph::Execute()");
+    auto context = CreateContext (input, env);
 
-    if (!PrepareFileSystem()) {
-        return false;
-    }
+    return Execute (*context);
+} // Graph::Execute
+
+
+std::shared_ptr<ExecutionContext>
+Graph::CreateContext (const string& input, json& env)
+{
+    auto context = std::make_shared<ExecutionContext>();
 
     json merged_env = environment_;
     if (!env.empty()) {
         merged_env.merge_patch (env);
     }
+
+    context->set_input (input);
+    context->set_environment (merged_env);
+    context->set_test_flag (test_);
+    context->set_cleanup_flag (cleanup_);
+
+    return context;
+} // Graph::CreateContext
+
+
+bool
+Graph::Execute (ExecutionContext& context)
+{
+    TIMED_SCOPE (timerObj, "Graph::Execute()");
+
+    auto plan = Compile();
+
+    if (!plan->acyclic()) {
+        LERROR << "Graph contains a cycle, execution aborted.";
+        return false;
+    }
+
+    for (uint32_t id = 0; id < plan->size(); ++id) {
+        if (plan->node (id)->type() == DC_SUBGRAPH) {
+            LERROR << "Subgraph could not be inlined, execution aborted: " << plan->node (id)->name();
+            return false;
+        }
+    }
+
+    // The first run borrows the graph's own sandbox (creating it if needed) so that a single
+    // execution behaves as it always has. Concurrent runs get a private temp sandbox instead.
+    bool borrowed = false;
+
+    if (context.sandbox().empty()) {
+        bool expected = false;
+
+        if (sandbox_busy_.compare_exchange_strong (expected, true)) {
+            borrowed = PrepareFileSystem();
+            if (!borrowed) {
+                sandbox_busy_.store (false);
+                return false;
+            }
+            context.set_sandbox (sandbox_, false);
+        }
+    }
+
+    if (!PrepareFileSystem (context)) {
+        if (borrowed) {
+            sandbox_busy_.store (false);
+        }
+        return false;
+    }
+
+    const string sandbox = context.sandbox();
+    auto& merged_env = context.environment();
     LDEBUG_IF (!merged_env.empty()) << "Environment variables:\n" << merged_env.dump (4) << "\n";
 
     vector<string> inputs;
-    m_split_input (input, inputs);
+    m_split_input (context.input(), inputs);
+
+    context.set_plan (plan);
 
-    sort_();
+    {
+        std::lock_guard lock (contexts_mutex_);
+        contexts_.insert (&context);
+    }
 
-    running_ = true;
+    context.set_running (true);
 
 #ifdef _WIN32
-    auto context = new NodeThreadContext();
+    auto& nodes = context.nodes();
+    auto thread_context = context.thread_context();
+
+    // nodes keep their I/O state while running as threads, so each run works on copies.
+    nodes.resize (plan->size());
+    vector<json> envs (plan->size());
+
+    for (uint32_t id = 0; id < plan->size(); ++id) {
+        const auto& node = plan->node (id);
+        json data = node->Serialize();
+        auto clone = CreateNode (data, true);
+        if (clone == nullptr) {
+            clone = node;
+        }
+        else {
+            for (const auto& fifo : node->inputs()) {
+                clone->AddInput (fifo);
+            }
+            for (const auto& fifo : node->outputs()) {
+                clone->AddOutput (fifo);
+            }
+        }
+        clone->set_test_flag (context.test_flag());
+        clone->set_event_fd (context.event_fd());
+        nodes[id] = clone;
+        envs[id] = clone->environment (merged_env);
+    }
 
     // Process leader for the group.
     LDEBUG << "Order of execution:";
-    for (const auto& uuid : ordered_) {
-        LDEBUG << uuid << " - " << nodes_[uuid]->name();
+    for (auto id : plan->order()) {
+        LDEBUG << plan->uuid (id) << " - " << nodes[id]->name();
     }
 
-    for (const auto& uuid : ordered_) {
-        auto node_ = nodes_[uuid];
+    for (auto id : plan->order()) {
+        auto node_ = nodes[id];
         if (node_->is_root()) {
             // root nodes receive initial input.
             LDEBUG << "Root node: " << node_->name();
-            auto log = logfile();
-            node_->Start (context, inputs, sandbox_, merged_env, log);
+            auto log = context.logfile();
+            node_->Start (thread_context, inputs, sandbox, envs[id], log);
         }
         else {
-            auto log = logfile();
-            node_->Start (context, sandbox_, merged_env, log);
+            auto log = context.logfile();
+            node_->Start (thread_context, sandbox, envs[id], log);
         }
     }
 
-    for (const auto& uuid : ordered_) {
-        nodes_[uuid]->Join();
+    for (auto id : plan->order()) {
+        nodes[id]->Join();
     }
 
-    delete context;
+    context.set_counters (int (plan->order().size()), thread_context->nodes_failed.load());
 #else
-    process_group_ = 0;
+    context.set_process_group (0);
     pid_t group_pid = fork();
 
     if (group_pid == 0) {
-        // Process leader for the group.
+        // Process leader for the group. Both sides call setpgid() so the group exists before
+        // any node process tries to join it.
+        setpgid (0, 0);
         LDEBUG << "Order of execution:";
-        for (const auto& uuid : ordered_) {
-            LDEBUG << uuid << " - " << nodes_[uuid]->name();
+        for (auto id : plan->order()) {
+            LDEBUG << plan->uuid (id) << " - " << plan->node (id)->name();
         }
 
-        for (const auto& uuid : ordered_) {
+        for (auto id : plan->order()) {
 
             // Create child processes in a loop.
             pid_t child_pid = fork();
@@ -337,54 +670,111 @@ Graph::Execute (const string& input, json& env)
                 LERROR_IF (result != 0) << "Set Process Group ID failed. (" << result << ")";
 
                 bool stat = false;
+                // the node object is this process's own copy after fork(), so per-run
+                // settings can be applied without touching other runs.
+                const auto& node = plan->node (id);
+                node->set_test_flag (context.test_flag());
+                node->set_event_fd (context.event_fd());
+                node->Report (DC_NODE_STARTED);
+
+                // cancellation: the token's pipe becomes readable and the node winds down
+                // on its own, passing EOF downstream.
+                if (auto fd = context.cancel_fd(); fd != -1) {
+                    std::thread ([&node, fd]() {
+                        struct pollfd pfd{fd, POLLIN, 0};
+                        while (poll (&pfd, 1, -1) == -1 && errno == EINTR);
+                        LWARN << "<" << node->name() << "> Cancelled.";
+                        node->Cancel();
+                    }).detach();
+                }
+
+                json env = node->environment (merged_env);
 
-                if (nodes_[uuid]->is_root()) {
+                if (node->is_root()) {
                     // root nodes receive initial input.
-                    stat = nodes_[uuid]->Execute (inputs, sandbox_, merged_env);
+                    stat = node->Execute (inputs, sandbox, env);
                 }
                 else {
-                    stat = nodes_[uuid]->Execute (sandbox_, merged_env);
+                    stat = node->Execute (sandbox, env);
                 }
 
-                LINFO_IF (stat) << "<" << nodes_[uuid]->name() << "> Finished.";
-                LERROR_IF (!stat) << "<" << nodes_[uuid]->name() << "> Failed.";
+                LINFO_IF (stat) << "<" << node->name() << "> Finished.";
+                LERROR_IF (!stat) << "<" << node->name() << "> Failed.";
+                node->Report (stat ? DC_NODE_FINISHED : DC_NODE_FAILED);
 
                 ::_exit (stat ? 0 : -1);
             }
             default: // parent of the fork();
-                LDEBUG << "<" << nodes_[uuid]->name() << "> fork (pid:" << child_pid << ")";
+                LDEBUG << "<" << plan->node (id)->name() << "> fork (pid:" << child_pid << ")";
                 break;
             } // switch
         }
 
-        wait_();
-        ::_exit (0);
+        // report the number of failed nodes back through the exit status.
+        ::_exit (std::min (wait_(), 255));
     }
     else if (group_pid > 0) {
         // set process group ID for parent process.
         auto result = setpgid (group_pid, group_pid);
         LERROR_IF (result != 0) << "Set Process Group ID failed. (" << result << ")";
         LDEBUG_IF (result == 0) << "Process Group ID:" << group_pid;
-        process_group_ = group_pid;
+        context.set_process_group (group_pid);
 
         // CTRL-C
         sigint_handler = [&] (int signal) { Terminate(); };
         signal (SIGINT, signal_handler);
     }
+    else {
+        LERROR << "Cannot fork process group leader.";
+    }
 
     // Waiting on first fork.
-    wait_ (group_pid);
-    process_group_ = 0;
+    int status = 0;
+    int failed = 0;
+    if (group_pid > 0) {
+        while (waitpid (group_pid, &status, 0) == -1 && errno == EINTR);
+        if (WIFEXITED (status)) {
+            failed = WEXITSTATUS (status);
+        }
+    }
+    context.set_counters (int (plan->order().size()), failed);
 #endif
-    LINFO_IF (!test_) << "Graph execution finished.";
-    LINFO_IF (test_) << "Graph test finished.";
+    LINFO_IF (!context.test_flag()) << "Graph execution finished.";
+    LINFO_IF (context.test_flag()) << "Graph test finished.";
+    LDEBUG << "Nodes finished: " << context.nodes_finished() << ", failed: " << context.nodes_failed();
 
-    running_ = false;
+    context.set_running (false);
+#ifndef _WIN32
+    context.set_process_group (0);
+#endif
 
-    return true;
+    {
+        std::lock_guard lock (contexts_mutex_);
+        contexts_.erase (&context);
+    }
+
+    if (borrowed) {
+        sandbox_busy_.store (false);
+    }
+    else if (context.cleanup_flag()) {
+        context.Cleanup();
+    }
+
+    return context.nodes_failed() == 0;
 } // Graph::Execute
 
 
+std::shared_ptr<ExecutionHandle>
+Graph::ExecuteAsync (const string& input, json& env)
+{
+    // the graph must outlive the handle; its definition is shared by the running nodes.
+    auto handle = std::make_shared<ExecutionHandle> (CreateContext (input, env));
+    handle->Start ([this] (ExecutionContext& context) { return Execute (context); });
+
+    return handle;
+} // Graph::ExecuteAsync
+
+
 bool
 Graph::Execute (const string& input, const string& node_name)
 {
@@ -395,54 +785,31 @@ Graph::Execute (const string& input, const string& node_name)
 bool
 Graph::Test()
 {
-    set_test_flag (true);
-    auto stat = Execute();
-    set_test_flag (false);
+    auto context = CreateContext (input_, environment_);
+    context->set_test_flag (true);
 
-    return stat;
-} // Graph::Execute
+    return Execute (*context);
+} // Graph::Test
 
 
 void
 Graph::Terminate()
 {
-#ifdef _WIN32
-    for (const auto& [name, node] : nodes_) {
-        node->Stop();
+    std::lock_guard lock (contexts_mutex_);
+
+    for (auto* context : contexts_) {
+        context->Terminate();
     }
+} // Graph::Terminate
 
-    running_ = false;
-#else
-    if (!process_group_ && !running_)
-        return;
 
-    auto result = killpg (process_group_, SIGTERM);
-    if (result == 0) {
-        LWARN << " !!! Terminated !!! (" << process_group_ << ")";
-        running_ = false;
-        process_group_ = 0;
-    }
-    else {
-        switch (errno) {
-        case EINVAL:
-            LERROR << "Terminate process group failed for ("
-                   << process_group_
-                   << "): Invalid signal";
-            break;
-        case EPERM:
-            LERROR << "Terminate process group failed for ("
-                   << process_group_
-                   << "): Sending user is not the super user";
-            break;
-        case ESRCH:
-            LERROR << "Terminate process group failed for ("
-                   << process_group_
-                   << "): No process can be found in the process group";
-            break;
-        }
-    }
-#endif
-}
+bool
+Graph::running() const
+{
+    std::lock_guard lock (contexts_mutex_);
+
+    return !contexts_.empty();
+} // Graph::running
 
 
 bool
@@ -506,6 +873,36 @@ Graph::CreateNode (json& keydata, bool keep_uuid)
         case DC_WATCH:
             node = std::make_shared<WatchNode>();
             break;
+        case DC_SUBGRAPH:
+            node = std::make_shared<SubgraphNode>();
+            break;
+        case DC_REMOTE:
+            node = std::make_shared<RemoteNode>();
+            break;
+        case DC_ROUTER:
+            node = std::make_shared<RouterNode>();
+            break;
+        case DC_DIRSCAN:
+            node = std::make_shared<DirScanNode>();
+            break;
+        case DC_DEDUP:
+            node = std::make_shared<DedupNode>();
+            break;
+        case DC_THROTTLE:
+            node = std::make_shared<ThrottleNode>();
+            break;
+        case DC_WINDOW:
+            node = std::make_shared<WindowNode>();
+            break;
+        case DC_GROUPBY:
+            node = std::make_shared<GroupByNode>();
+            break;
+        case DC_JOIN:
+            node = std::make_shared<JoinNode>();
+            break;
+        case DC_SPLIT:
+            node = std::make_shared<SplitNode>();
+            break;
         default:
             LERROR << "Unknown type." << jit.value()["type"];
             break;
@@ -530,7 +927,7 @@ Graph::AddNode (const std::shared_ptr<Node>& node)
 
     if (stat) {
         nodes_[node->id()] = node;
-        adjacencylist_[node->id()];
+        invalidate_();
         LDEBUG << "Added " << DaisyNodeNameByType[node->type()] << " node: " << node->name();
     }
     else {
@@ -547,12 +944,32 @@ Graph::RemoveNode (const string& id)
     bool stat = true;
 
     try {
-        for (auto& e: adjacencylist_) {
-            e.second.erase (std::remove (e.second.begin(), e.second.end(), id), e.second.end());
+        // its edges go with it, so no edge names a node the plan does not know.
+        for (auto it = edges_.begin(); it != edges_.end();) {
+            if (it->first != id && it->second != id) {
+                ++it;
+                continue;
+            }
+
+            auto fifo = it->first + "." + it->second;
+
+            if (it->first != id && nodes_.count (it->first)) {
+                nodes_[it->first]->RemoveOutput (fifo);
+            }
+            if (it->second != id && nodes_.count (it->second)) {
+                nodes_[it->second]->RemoveInput (fifo);
+            }
+
+            if (it->second == id && it->first != id) {
+                std::erase (children_[it->first], id);
+            }
+
+            it = edges_.erase (it);
         }
 
-        adjacencylist_.erase (id);
+        children_.erase (id);
         nodes_.erase (id);
+        invalidate_();
 
         LDEBUG << "Num verts: " << nodes_.size();
     }
@@ -567,29 +984,133 @@ Graph::RemoveNode (const string& id)
 bool
 Graph::Connect (const string& parentid, const string& childid)
 {
-    Edge edge = {parentid, childid};
+    // one edge: a search from the child over the edges already there replaces compiling the
+    // whole graph, so connecting edge by edge stays cheap.
+    if (!nodes_.count (parentid) || !nodes_.count (childid)) {
+        LERROR << "Connection failed, unknown node: " << parentid << "." << childid;
+        return false;
+    }
 
-    edges_.push_back (edge);
-    nodes_[edge.first]->AddOutput (edge.first + "." + edge.second);
-    nodes_[edge.second]->AddInput (edge.first + "." + edge.second);
-    adjacencylist_[parentid].push_back (childid);
+    if (reaches_ (childid, parentid)) {
+        LERROR << "Cycle detected";
+        LERROR << "Connection failed: " << parentid << "." << childid;
+        return false;
+    }
 
-    // cycle detection
-    bool has_cycle = detect_cycle();
+    edges_.emplace_back (parentid, childid);
+    children_[parentid].push_back (childid);
+    nodes_[parentid]->AddOutput (parentid + "." + childid);
+    nodes_[childid]->AddInput (parentid + "." + childid);
+    invalidate_();
 
-    if (has_cycle) {
-        LERROR << "Cycle detected";
-        LERROR << "Connection failed: " << edge.first << "." << edge.second;
-        Disconnect (parentid, childid);
+    LDEBUG << "Connected: " << parentid << "." << childid;
+
+    return true;
+} // Graph::Connect
+
+
+bool
+Graph::Connect (const list<Edge>& edges)
+{
+    bool stat = true;
+    list<Edge> batch;
+
+    for (const auto& edge : edges) {
+        if (!nodes_.count (edge.first) || !nodes_.count (edge.second)) {
+            LERROR << "Connection failed, unknown node: " << edge.first << "." << edge.second;
+            stat = false;
+            continue;
+        }
+
+        batch.push_back (edge);
     }
-    else {
+
+    // compile the graph as it would be with the whole batch; the common case is no cycle,
+    // and then this is the only check needed and the plan is kept.
+    list<Edge> candidate = edges_;
+    candidate.insert (candidate.end(), batch.begin(), batch.end());
+    ExecutionPlan plan (nodes_, candidate);
+
+    if (!plan.acyclic()) {
+        // at least one edge closes a cycle: replay the batch in order on top of the existing
+        // edges and reject each edge whose child already reaches its parent.
+        vector<vector<uint32_t>> adjacency (plan.size());
+
+        for (const auto& [parent, child] : edges_) {
+            auto from = plan.id (parent);
+            auto to = plan.id (child);
+
+            if (from >= 0 && to >= 0) {
+                adjacency[from].push_back (uint32_t (to));
+            }
+        }
+
+        for (auto it = batch.begin(); it != batch.end();) {
+            auto parent = uint32_t (plan.id (it->first));
+            auto child = uint32_t (plan.id (it->second));
+
+            if (reaches_ (adjacency, child, parent)) {
+                LERROR << "Cycle detected";
+                LERROR << "Connection failed: " << it->first << "." << it->second;
+                it = batch.erase (it);
+                stat = false;
+            }
+            else {
+                adjacency[parent].push_back (child);
+                ++it;
+            }
+        }
+    }
+
+    for (const auto& edge : batch) {
+        edges_.push_back (edge);
+        children_[edge.first].push_back (edge.second);
+        nodes_[edge.first]->AddOutput (edge.first + "." + edge.second);
+        nodes_[edge.second]->AddInput (edge.first + "." + edge.second);
         LDEBUG << "Connected: " << edge.first << "." << edge.second;
     }
 
-    return (!has_cycle);
+    {
+        std::lock_guard lock (plan_mutex_);
+        bool keep = plan.acyclic() && !has_subgraphs_();
+        plan_ = keep ? std::make_shared<const ExecutionPlan> (std::move (plan)) : nullptr;
+    }
+
+    return stat;
 } // Graph::Connect
 
 
+bool
+Graph::reaches_ (const string& from, const string& to) const
+{
+    std::unordered_set<string> visited;
+    vector<const string*> stacked {&from};
+
+    while (!stacked.empty()) {
+        const auto& v = *stacked.back();
+        stacked.pop_back();
+
+        if (v == to) {
+            return true;
+        }
+
+        if (!visited.insert (v).second) {
+            continue;
+        }
+
+        if (auto found = children_.find (v); found != children_.end()) {
+            for (const auto& neighbor : found->second) {
+                if (!visited.count (neighbor)) {
+                    stacked.push_back (&neighbor);
+                }
+            }
+        }
+    }
+
+    return false;
+} // Graph::reaches_
+
+
 bool
 Graph::Disconnect (const string& parentid, const string& childid)
 {
@@ -600,6 +1121,10 @@ Graph::Disconnect (const string& parentid, const string& childid)
 
         edges_.remove (edge);
 
+        if (auto found = children_.find (edge.first); found != children_.end()) {
+            std::erase (found->second, edge.second);
+        }
+
         if (nodes_.count (edge.first)) {
             nodes_[edge.first]->RemoveOutput (edge.first + "." + edge.second);
         }
@@ -608,11 +1133,7 @@ Graph::Disconnect (const string& parentid, const string& childid)
             nodes_[edge.second]->RemoveInput (edge.first + "." + edge.second);
         }
 
-        auto it = adjacencylist_.find (parentid);
-        if (it != adjacencylist_.end()) {
-            auto& nodes = it->second;
-            nodes.erase (std::remove (nodes.begin(), nodes.end(), childid), nodes.end());
-        }
+        invalidate_();
 
         LDEBUG << "Disconnected: " << edge.first << "." << edge.second;
         LDEBUG << "Num edges: " << edges_.size();
@@ -14,20 +14,35 @@
 #include <string>
 #include <stack>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
 #ifndef _WIN32
 #include <sys/wait.h>
 #endif
 
 #include "logger.h"
 #include "node.h"
+#include "executionplan.h"
+#include "executioncontext.h"
+#include "executionhandle.h"
 #include "signalhandler.h"
 #include "commandlinenode.h"
 #include "concatnode.h"
+#include "dedupnode.h"
+#include "dirscannode.h"
 #include "distronode.h"
 #include "filelistnode.h"
 #include "filternode.h"
+#include "groupbynode.h"
+#include "joinnode.h"
 #include "remotenode.h"
+#include "routernode.h"
+#include "splitnode.h"
+#include "subgraphnode.h"
+#include "throttlenode.h"
 #include "watchnode.h"
+#include "windownode.h"
 
 #if HAVE_CONFIG_H
 #include "config.h"
@@ -40,7 +55,6 @@
 using std::string;
 
 namespace daisychain {
-using Edge = pair<string, string>;
 
 
 class Graph
@@ -58,14 +72,24 @@ public:
 
     bool Save (const string& filename="");
 
+    std::shared_ptr<const ExecutionPlan> Compile();
+
     bool PrepareFileSystem();
 
+    bool PrepareFileSystem (ExecutionContext& context);
+
+    std::shared_ptr<ExecutionContext> CreateContext (const string& input, json& env);
+
     bool Execute();
 
     bool Execute (const string& input);
 
     bool Execute (const string& input, json& env);
 
+    bool Execute (ExecutionContext& context);
+
+    std::shared_ptr<ExecutionHandle> ExecuteAsync (const string& input, json& env);
+
     bool Execute (const string& input, const string& node_name);
 
     bool Test();
@@ -84,6 +108,8 @@ public:
 
     bool Connect (const string& parent, const string& child);
 
+    bool Connect (const list<Edge>& edges);
+
     bool Disconnect (const string& parent, const string& child);
 
     std::shared_ptr<Node> get_node (const string& id);
@@ -118,7 +144,7 @@ public:
 
     [[nodiscard]] string logfile() const { return sandbox_ + ".log"; }
 
-    [[nodiscard]] bool running() const { return running_; }
+    [[nodiscard]] bool running() const;
 
     const map<string, std::shared_ptr<Node>>& nodes();
 
@@ -130,108 +156,98 @@ private:
     string input_;
     json environment_;
     json notes_;
-    bool running_;
     bool cleanup_;
     bool test_;
 
     map<string, std::shared_ptr<Node>> nodes_;
     list<Edge> edges_;
-    std::unordered_map<string, vector<string>> adjacencylist_;
-    vector<string> ordered_;
-
-#ifndef _WIN32
-    pid_t process_group_{};
+    // edges_ by parent, kept in step with it so a single Connect can check for a cycle
+    // without compiling the graph.
+    std::unordered_map<string, vector<string>> children_;
 
+    // compiled lazily from nodes_ and edges_, dropped whenever either changes.
+    std::mutex plan_mutex_;
+    std::shared_ptr<const ExecutionPlan> plan_;
 
-    static inline void wait_ (pid_t pid = -1)
+    void invalidate_()
     {
-        pid_t wpid;
-        int status = 0;
-        while ((wpid = waitpid (pid, &status, 0)) > 0);
-        if (WIFSIGNALED (status)) {
-            LWARN << "Process terminated via signal.";
-        }
-        else if (!WIFEXITED (status)) {
-            LERROR << "Process failed (non-zero exit()). " << wpid;
-        }
+        std::lock_guard lock (plan_mutex_);
+        plan_.reset();
     }
-#endif
 
-    void sort_visitor_ (const string& v, std::set<string>& visited, std::stack<string>& stacked)
-    {
-        visited.insert (v);
+    // runs currently in flight; the first one to start borrows the graph's own sandbox.
+    mutable std::mutex contexts_mutex_;
+    std::set<ExecutionContext*> contexts_;
+    std::atomic<bool> sandbox_busy_;
 
-        for (const auto& neighbor : adjacencylist_[v]) {
-            if (visited.find (neighbor) == visited.end()) {
-                sort_visitor_ (neighbor, visited, stacked);
-            }
-        }
+    static bool prepare_sandbox_ (string& sandbox, const vector<ExecutionPlan::PlanEdge>& edges);
 
-        stacked.push (v);
-    }
+    // the subgraph files the plan was built from, with the times they were last written.
+    map<string, fs::file_time_type> subgraph_files_;
 
+    void inline_subgraphs_ (map<string, std::shared_ptr<Node>>& nodes, list<Edge>& edges,
+                            map<string, fs::file_time_type>& files) const;
 
-    void sort_()
+    [[nodiscard]] bool has_subgraphs_() const
     {
-        std::set<string> visited;
-        std::stack<string> stacked;
+        return std::any_of (nodes_.begin(), nodes_.end(), [] (const auto& node) {
+            return node.second->type() == DC_SUBGRAPH;
+        });
+    }
 
-        for (const auto& neighbors: adjacencylist_) {
-            if (visited.find (neighbors.first) == visited.end()) {
-                sort_visitor_ (neighbors.first, visited, stacked);
+#ifndef _WIN32
+    // Reaps child processes and returns the number that did not exit cleanly.
+    static inline int wait_ (pid_t pid = -1)
+    {
+        pid_t wpid;
+        int status = 0;
+        int failed = 0;
+        while ((wpid = waitpid (pid, &status, 0)) > 0) {
+            if (WIFSIGNALED (status)) {
+                LWARN << "Process terminated via signal.";
+                failed++;
+            }
+            else if (!WIFEXITED (status) || WEXITSTATUS (status) != 0) {
+                LERROR << "Process failed (non-zero exit()). " << wpid;
+                failed++;
             }
         }
-
-        ordered_.clear();
-        while (!stacked.empty()) {
-            ordered_.push_back (stacked.top());
-            stacked.pop();
-        }
+        return failed;
     }
+#endif
 
+    // iterative depth-first search: true when 'to' can be reached from 'from'.
+    static bool reaches_ (const vector<vector<uint32_t>>& adjacency, uint32_t from, uint32_t to)
+    {
+        vector<char> visited (adjacency.size(), 0);
+        vector<uint32_t> stacked {from};
 
-    bool cycle_visitor_ (const string& v, std::set<string>& visited, std::set<string>& stacked) {
-        // If the vertex is currently in the recursion stack, a cycle is found
-        if (stacked.find (v) != stacked.end()) {
-            return true;
-        }
-
-        // If the vertex is already visited and not in the current path, no cycle
-        if (visited.find(v) != visited.end()) {
-            return false;
-        }
-
-        // Mark the current vertex as visited and add it to the recursion stack
-        visited.insert (v);
-        stacked.insert (v);
+        while (!stacked.empty()) {
+            auto v = stacked.back();
+            stacked.pop_back();
 
-        for (const auto& neighbor : adjacencylist_[v]) {
-            if (cycle_visitor_ (neighbor, visited, stacked)) {
+            if (v == to) {
                 return true;
             }
-        }
-
-        // Remove the vertex from the recursion stack before returning
-        stacked.erase (v);
-
-        return false;
-    }
 
+            if (visited[v]) {
+                continue;
+            }
 
-    bool detect_cycle()
-    {
-        std::set<string> visited;
-        std::set<string> stacked;
+            visited[v] = 1;
 
-        // Check for cycles starting from each vertex
-        for (const auto& pair : adjacencylist_) {
-            if (cycle_visitor_ (pair.first, visited, stacked)) {
-                return true;
+            for (auto neighbor : adjacency[v]) {
+                if (!visited[neighbor]) {
+                    stacked.push_back (neighbor);
+                }
             }
         }
 
         return false;
     }
+
+    // the same search over children_.
+    [[nodiscard]] bool reaches_ (const string& from, const string& to) const;
 };
 
 
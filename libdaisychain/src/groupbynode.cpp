@@ -0,0 +1,318 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "groupbynode.h"
+#include <algorithm>
+#include <fstream>
+
+
+namespace daisychain {
+using namespace std;
+
+
+GroupByNode::GroupByNode() :
+    key_ ("dirname"),
+    idle_ (0),
+    memory_ (64 * 1024 * 1024),
+    held_ (0),
+    named_ (0),
+    failed_ (false),
+    groups_ (0),
+    unkeyed_ (0),
+    spills_ (0)
+{
+    type_ = DaisyNodeType::DC_GROUPBY;
+    set_name (DaisyNodeNameByType[type_]);
+}
+
+
+void
+GroupByNode::Initialize (json& keydata, bool keep_uuid)
+{
+    Node::Initialize (keydata, keep_uuid);
+
+    json::iterator jit = keydata.begin();
+    const auto& uuid = jit.key();
+    auto data = keydata[uuid];
+
+    set_key (data.count ("key") ? data["key"].get<string>() : "dirname");
+    set_pattern (data.count ("pattern") ? data["pattern"].get<string>() : "");
+    set_attribute (data.count ("attribute") ? data["attribute"].get<string>() : "");
+    set_idle (data.count ("idle") ? data["idle"].get<int>() : 0);
+    set_memory (data.count ("memory") ? data["memory"].get<size_t>() : 64 * 1024 * 1024);
+}
+
+
+bool
+GroupByNode::Execute (vector<string>& inputs, const string& sandbox, json& vars)
+{
+    LINFO << "Executing " << (isroot_ ? "root: " : "node: ") << name_;
+
+    bool stat = true;
+
+    if (key_ == "regex") {
+        try {
+            regex_ = std::regex (pattern_);
+        }
+        catch (const std::regex_error& e) {
+            LERROR << "regex_error caught: " << e.what();
+            stat = false;
+        }
+    }
+    else if (key_ == "attribute") {
+        LERROR_IF (attribute_.empty()) << LOGNODE << "No attribute to group by.";
+        stat = !attribute_.empty();
+    }
+    else if (key_ != "dirname") {
+        LERROR << LOGNODE << "Unknown group key: " << key_;
+        stat = false;
+    }
+
+    if (!stat) {
+        OpenOutputs (sandbox);
+        WriteOutputs ("EOF");
+        CloseOutputs();
+
+        return false;
+    }
+
+    held_ = 0;
+    failed_ = false;
+    groups_ = 0;
+    unkeyed_ = 0;
+    spills_ = 0;
+
+    if (isroot_) {
+        add_ (inputs, sandbox);
+    }
+    else {
+        while (eofs_ <= fd_in_.size() && !terminate_.load()) {
+            add_ (inputs, sandbox);
+            expire_ (sandbox);
+
+            inputs.clear();
+
+            if (eofs_ == fd_in_.size()) {
+                break;
+            }
+            ReadInputs (inputs);
+        }
+        CloseInputs();
+    }
+
+    if (!cancelled_.load()) {
+        vector<Groups::iterator> open;
+
+        for (auto it = order_.begin(); it != order_.end(); ++it) {
+            open.push_back (it);
+        }
+
+        std::sort (open.begin(), open.end(), [] (const auto& a, const auto& b) { return a->key < b->key; });
+
+        for (auto& group : open) {
+            flush_ (group, sandbox);
+        }
+    }
+
+    // all processing is done for this node. Send EOF downstream.
+    OpenOutputs (sandbox);
+    WriteOutputs ("EOF");
+    CloseOutputs();
+    Stats();
+    Reset();
+
+    order_.clear();
+    groups_by_key_.clear();
+
+    return !failed_;
+} // GroupByNode::Execute
+
+
+bool
+GroupByNode::key_of_ (const string& token, string& key) const
+{
+    if (key_ == "attribute") {
+        std::string_view value;
+
+        if (!token_attribute (token, attribute_, value)) {
+            return false;
+        }
+
+        key = value;
+        return true;
+    }
+
+    string scratch;
+    const auto& path = token_path (token, scratch);
+
+    if (key_ == "regex") {
+        std::smatch match;
+
+        if (!std::regex_search (path, match, regex_)) {
+            return false;
+        }
+
+        key = match.size() > 1 ? match[1].str() : match[0].str();
+        return true;
+    }
+
+    key = fs::path (path).parent_path().string();
+    return true;
+} // GroupByNode::key_of_
+
+
+void
+GroupByNode::add_ (vector<string>& inputs, const string& sandbox)
+{
+    string key;
+    auto now = Clock::now();
+
+    for (auto& input : inputs) {
+        if (input == "EOF" || cancelled_.load()) {
+            continue;
+        }
+
+        if (!key_of_ (input, key)) {
+            LDEBUG << LOGNODE << "No key: " << input;
+            ++unkeyed_;
+            continue;
+        }
+
+        // a list holds paths, as a batch list does.
+        input.resize (token_path (input).size());
+
+        auto found = groups_by_key_.find (key);
+
+        if (found == groups_by_key_.end()) {
+            Group group;
+            group.key = key;
+            group.list = sandbox + "/" + id_ + ".group." + std::to_string (named_++);
+
+            order_.push_back (std::move (group));
+            found = groups_by_key_.emplace (key, std::prev (order_.end())).first;
+        }
+        else {
+            // most recently added to goes last.
+            order_.splice (order_.end(), order_, found->second);
+        }
+
+        auto& group = *found->second;
+        auto size = input.size() + sizeof (string);
+
+        group.tokens.push_back (std::move (input));
+        group.bytes += size;
+        group.touched = now;
+        ++group.count;
+        held_ += size;
+
+        // groups that have waited longest make room; the one just added to goes last, if at all.
+        for (auto it = order_.begin(); held_ > memory_ && it != order_.end(); ++it) {
+            if (!it->tokens.empty()) {
+                spill_ (*it);
+                ++spills_;
+            }
+        }
+    }
+} // GroupByNode::add_
+
+
+void
+GroupByNode::expire_ (const string& sandbox)
+{
+    if (idle_ <= 0) {
+        return;
+    }
+
+    auto now = Clock::now();
+
+    while (!order_.empty() && now - order_.front().touched >= std::chrono::milliseconds (idle_)) {
+        flush_ (order_.begin(), sandbox);
+    }
+} // GroupByNode::expire_
+
+
+bool
+GroupByNode::spill_ (Group& group)
+{
+    // the first write makes the list; later ones add to it.
+    auto mode = std::ios::out | std::ios::binary | (group.count > group.tokens.size() ? std::ios::app : std::ios::trunc);
+
+    std::ofstream stream (group.list, mode);
+
+    for (const auto& token : group.tokens) {
+        stream << token << '\n';
+    }
+
+    stream.flush();
+
+    bool stat = bool (stream);
+    LERROR_IF (!stat) << LOGNODE << "Cannot write group list: " << group.list;
+
+    held_ -= group.bytes;
+    group.tokens = vector<string>();
+    group.bytes = 0;
+    group.failed = group.failed || !stat;
+
+    return stat;
+} // GroupByNode::spill_
+
+
+void
+GroupByNode::flush_ (Groups::iterator group, const string& sandbox)
+{
+    spill_ (*group);
+
+    // a list missing some of its tokens is not sent; the run fails instead.
+    if (group->failed) {
+        LERROR << LOGNODE << "Dropping group " << group->key << ", its list is incomplete.";
+        failed_ = true;
+    }
+    else {
+        auto list = group->list;
+        set_token_attribute (list, "key", group->key);
+        set_token_attribute (list, "tokens", int64_t (group->count));
+
+        LDEBUG << LOGNODE << "group " << group->key << ": " << group->count << " tokens.";
+
+        OpenOutputs (sandbox);
+        WriteOutputs (list);
+        CloseOutputs();
+
+        ++groups_;
+    }
+
+    groups_by_key_.erase (group->key);
+    order_.erase (group);
+} // GroupByNode::flush_
+
+
+json
+GroupByNode::Serialize()
+{
+    auto json_ = Node::Serialize();
+    json_[id_]["key"] = key_;
+
+    if (key_ == "regex") {json_[id_]["pattern"] = pattern_;}
+
+    if (key_ == "attribute") {json_[id_]["attribute"] = attribute_;}
+
+    json_[id_]["idle"] = idle_;
+    json_[id_]["memory"] = memory_;
+
+    if (size_ != std::pair<int, int>(0,0)) {json_[id_]["size"] = size_;}
+
+    return json_;
+} // GroupByNode::Serialize
+
+
+void
+GroupByNode::Stats()
+{
+    LINFO << LOGNODE << "groups sent: " << groups_ << ", written early: " << spills_
+          << ", tokens without a key: " << unkeyed_;
+
+    Node::Stats();
+} // GroupByNode::Stats
+} // namespace daisychain
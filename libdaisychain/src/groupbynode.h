@@ -0,0 +1,119 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include <chrono>
+#include <list>
+#include <regex>
+#include <unordered_map>
+#include "node.h"
+
+
+namespace daisychain {
+// Buckets tokens by a key so that a command runs once per directory, shot or the like over all
+// of its files. The key is the token's parent directory ("dirname", the default), what a regex
+// matches in its path ("regex"; the first capture group when there is one), or the value of one
+// of its attributes ("attribute"). Tokens without a key are dropped.
+//
+// Each group is a list file in the sandbox, one path per line in arrival order, and the list's
+// path goes downstream with the attributes "key" and "tokens". Groups close at EOF, in key
+// order, or once no token has come for them for idle milliseconds. Groups are held in memory up
+// to the memory budget; past it, the groups least recently added to are appended to their lists
+// until they fit again, so memory stays bounded however large or many the groups are.
+class GroupByNode final : public Node
+{
+public:
+    GroupByNode();
+
+    void Initialize (json&, bool) override;
+
+    bool Execute (vector<string>& input, const string& sandbox, json& vars) override;
+
+    json Serialize() override;
+
+    void Stats() override;
+
+    // "dirname" (default), "regex" or "attribute".
+    void set_key (const string& key) { key_ = key; }
+
+    string key() const { return key_; }
+
+    // the regex for "regex" keys.
+    void set_pattern (const string& pattern) { pattern_ = pattern; }
+
+    string pattern() const { return pattern_; }
+
+    // the attribute for "attribute" keys.
+    void set_attribute (const string& attribute) { attribute_ = attribute; }
+
+    string attribute() const { return attribute_; }
+
+    // milliseconds after its last token that a group closes; 0 (default) holds groups to EOF.
+    void set_idle (int milliseconds) { idle_ = milliseconds; }
+
+    [[nodiscard]] int idle() const { return idle_; }
+
+    // bytes of tokens held in memory over all groups.
+    void set_memory (size_t bytes) { memory_ = bytes; }
+
+    [[nodiscard]] size_t memory() const { return memory_; }
+
+private:
+    // not exposed
+    using Node::set_batch_flag;
+    using Node::set_outputfile;
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Group
+    {
+        string key;
+        string list;
+        vector<string> tokens;
+        size_t bytes = 0;
+        size_t count = 0;
+        Clock::time_point touched;
+        // a write to the list failed.
+        bool failed = false;
+    };
+
+    // least recently added to first.
+    using Groups = std::list<Group>;
+
+    // false if token has no key.
+    bool key_of_ (const string& token, string& key) const;
+
+    void add_ (vector<string>& inputs, const string& sandbox);
+
+    // closes the groups that have been idle too long.
+    void expire_ (const string& sandbox);
+
+    // appends what a group holds to its list; false if the list could not be written.
+    bool spill_ (Group& group);
+
+    // writes the rest of a group and sends its list downstream, unless a write of it failed.
+    void flush_ (Groups::iterator group, const string& sandbox);
+
+    string key_;
+    string pattern_;
+    string attribute_;
+    int idle_;
+    size_t memory_;
+
+    std::regex regex_;
+
+    Groups order_;
+    std::unordered_map<string, Groups::iterator> groups_by_key_;
+    size_t held_;
+    size_t named_;
+    // a group was dropped because its list could not be written.
+    bool failed_;
+
+    uint64_t groups_;
+    uint64_t unkeyed_;
+    uint64_t spills_;
+};
+} // namespace daisychain
@@ -0,0 +1,501 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "joinnode.h"
+#include <fstream>
+#include <functional>
+
+
+// files the table is split into when it spills; a partition is read back whole at EOF.
+#define JOIN_PARTITIONS 64
+
+
+namespace daisychain {
+using namespace std;
+
+
+JoinNode::JoinNode() :
+    regex_ (false),
+    key_ ("stem"),
+    memory_ (64 * 1024 * 1024),
+    held_ (0),
+    failed_ (false),
+    pairs_ (0),
+    unmatched_ (0),
+    spills_ (0)
+{
+    type_ = DaisyNodeType::DC_JOIN;
+    set_name (DaisyNodeNameByType[type_]);
+}
+
+
+void
+JoinNode::Initialize (json& keydata, bool keep_uuid)
+{
+    Node::Initialize (keydata, keep_uuid);
+
+    json::iterator jit = keydata.begin();
+    const auto& uuid = jit.key();
+    auto data = keydata[uuid];
+
+    set_left (data.count ("left") ? data["left"].get<string>() : "");
+    set_right (data.count ("right") ? data["right"].get<string>() : "");
+    set_regex (data.count ("regex") && data["regex"].get<bool>());
+    set_key (data.count ("key") ? data["key"].get<string>() : "stem");
+    set_pattern (data.count ("pattern") ? data["pattern"].get<string>() : "");
+    set_attribute (data.count ("attribute") ? data["attribute"].get<string>() : "");
+    set_memory (data.count ("memory") ? data["memory"].get<size_t>() : 64 * 1024 * 1024);
+}
+
+
+bool
+JoinNode::Execute (const string& sandbox, json& vars)
+{
+    vector<string> inputs;
+
+    OpenInputs (sandbox);
+
+    return Execute (inputs, sandbox, vars);
+} // JoinNode::Execute
+
+
+bool
+JoinNode::Execute (vector<string>& inputs, const string& sandbox, json& vars)
+{
+    LINFO << "Executing " << (isroot_ ? "root: " : "node: ") << name_;
+
+    bool stat = true;
+
+    left_matcher_.Clear();
+    right_matcher_.Clear();
+
+    try {
+        if (!left_.empty()) {
+            left_matcher_.Add (left_, regex_);
+        }
+        if (!right_.empty()) {
+            right_matcher_.Add (right_, regex_);
+        }
+        if (key_ == "regex") {
+            key_regex_ = std::regex (pattern_);
+        }
+    }
+    catch (const std::regex_error& e) {
+        LERROR << "regex_error caught: " << e.what();
+        stat = false;
+    }
+
+#ifdef _WIN32
+    if (left_.empty() && right_.empty()) {
+        LERROR << LOGNODE << "No pattern for either side of the join.";
+        stat = false;
+    }
+#else
+    if (inputs_.size() != 2 || inputs_[0] == inputs_[1]) {
+        LERROR << LOGNODE << "A join needs two inputs from different nodes.";
+        stat = false;
+    }
+#endif
+
+    if (key_ == "attribute" && attribute_.empty()) {
+        LERROR << LOGNODE << "No attribute to join on.";
+        stat = false;
+    }
+    else if (key_ != "stem" && key_ != "regex" && key_ != "attribute") {
+        LERROR << LOGNODE << "Unknown join key: " << key_;
+        stat = false;
+    }
+
+    if (!stat) {
+        OpenOutputs (sandbox);
+        WriteOutputs ("EOF");
+        CloseOutputs();
+
+        return false;
+    }
+
+    held_ = 0;
+    failed_ = false;
+    pairs_ = 0;
+    unmatched_ = 0;
+    spills_ = 0;
+
+    vector<Side> sides;
+
+    if (isroot_) {
+        add_ (inputs, sides, sandbox);
+    }
+    else {
+        while (eofs_ <= fd_in_.size() && !terminate_.load()) {
+            add_ (inputs, sides, sandbox);
+
+            inputs.clear();
+            sides.clear();
+
+            if (eofs_ == fd_in_.size()) {
+                break;
+            }
+#ifdef _WIN32
+            ReadInputs (inputs);
+#else
+            read_ (inputs, sides);
+#endif
+        }
+        CloseInputs();
+    }
+
+    if (!partitions_.empty() && !cancelled_.load() && !failed_) {
+        failed_ = !finish_ (sandbox);
+    }
+
+    for (const auto& [key, waiting] : table_) {
+        unmatched_ += waiting.sides[LEFT].size() + waiting.sides[RIGHT].size();
+    }
+
+    // all processing is done for this node. Send EOF downstream.
+    OpenOutputs (sandbox);
+    WriteOutputs ("EOF");
+    CloseOutputs();
+    Stats();
+    Reset();
+
+    std::error_code ec;
+    for (const auto& partition : partitions_) {
+        fs::remove (partition, ec);
+    }
+
+    partitions_.clear();
+    table_ = Table();
+
+    return !failed_;
+} // JoinNode::Execute
+
+
+#ifdef _WIN32
+bool
+JoinNode::side_of_ (const string& path, Side& side) const
+{
+    bool left = left_.empty() || left_matcher_.First (path) == 0;
+    bool right = right_.empty() || right_matcher_.First (path) == 0;
+
+    // a token both patterns take is left, unless the left pattern only takes it by being empty.
+    if (left && (!right || !left_.empty())) {
+        side = LEFT;
+        return true;
+    }
+
+    if (right) {
+        side = RIGHT;
+        return true;
+    }
+
+    return false;
+} // JoinNode::side_of_
+#else
+bool
+JoinNode::accepts_ (const string& path, Side side) const
+{
+    const auto& pattern = side == LEFT ? left_ : right_;
+    const auto& matcher = side == LEFT ? left_matcher_ : right_matcher_;
+
+    return pattern.empty() || matcher.First (path) == 0;
+} // JoinNode::accepts_
+
+
+void
+JoinNode::read_ (vector<string>& inputs, vector<Side>& sides)
+{
+    constexpr size_t BUFFSIZE = 8192;
+    char buffer[BUFFSIZE];
+    vector<string> tokens;
+
+    if (poll (fd_in_.data(), fd_in_.size(), 2) <= 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < fd_in_.size(); ++i) {
+        if (!fd_in_[i].revents) {
+            continue;
+        }
+
+        string input;
+        ssize_t numbytes = 0;
+
+        do {
+            numbytes = read (fd_in_[i].fd, buffer, BUFFSIZE);
+            if (numbytes > 0) {
+                input.append (buffer, size_t (numbytes));
+                totalbytesread_ += size_t (numbytes);
+            }
+        } while (numbytes > 0 || (numbytes == -1 && errno == EINTR));
+
+        m_split (input, "\n", tokens);
+
+        // Execute() checked that the two ports are different FIFOs, one each.
+        auto side = fifo_in_[i] == inputs_[0] ? LEFT : RIGHT;
+
+        for (auto& token : tokens) {
+            if (token == "EOF") {
+                ++eofs_;
+            }
+            else {
+                ++tokensread_;
+            }
+
+            inputs.push_back (std::move (token));
+            sides.push_back (side);
+        }
+    }
+
+    if (!inputs.empty()) {
+        progress_();
+    }
+} // JoinNode::read_
+#endif
+
+
+bool
+JoinNode::key_of_ (const string& token, const string& path, string& key) const
+{
+    if (key_ == "attribute") {
+        std::string_view value;
+
+        if (!token_attribute (token, attribute_, value)) {
+            return false;
+        }
+
+        key = value;
+        return true;
+    }
+
+    if (key_ == "regex") {
+        std::smatch match;
+
+        if (!std::regex_search (path, match, key_regex_)) {
+            return false;
+        }
+
+        key = match.size() > 1 ? match[1].str() : match[0].str();
+        return true;
+    }
+
+    key = fs::path (path).stem().string();
+    return true;
+} // JoinNode::key_of_
+
+
+void
+JoinNode::add_ (vector<string>& inputs, const vector<Side>& sides, const string& sandbox)
+{
+    vector<string> paired;
+    string scratch;
+    string key;
+    Side side;
+
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        auto& input = inputs[i];
+
+        // after a failed spill the waiting tokens are lost; drain the rest without joining.
+        if (input == "EOF" || cancelled_.load() || failed_) {
+            continue;
+        }
+
+        const auto& path = token_path (input, scratch);
+
+#ifdef _WIN32
+        bool taken = side_of_ (path, side);
+#else
+        side = sides[i];
+        bool taken = accepts_ (path, side);
+#endif
+
+        if (!taken || !key_of_ (input, path, key)) {
+            LDEBUG << LOGNODE << "No side or key: " << input;
+            ++unmatched_;
+            continue;
+        }
+
+        match_ (table_, key, side, std::move (input), paired, &held_);
+
+        if (held_ > memory_) {
+            failed_ = !spill_ (sandbox);
+            ++spills_;
+        }
+    }
+
+    send_ (paired, sandbox);
+} // JoinNode::add_
+
+
+void
+JoinNode::match_ (Table& table, const string& key, Side side, string token, vector<string>& paired, size_t* held)
+{
+    auto found = table.find (key);
+
+    if (found != table.end() && !found->second.sides[1 - side].empty()) {
+        auto& partner = found->second.sides[1 - side];
+        auto other = std::move (partner.front());
+        partner.pop_front();
+
+        if (held) {
+            *held -= other.size() + key.size() + sizeof (string);
+        }
+
+        if (found->second.sides[LEFT].empty() && found->second.sides[RIGHT].empty()) {
+            table.erase (found);
+        }
+
+        auto& left = side == LEFT ? token : other;
+        auto& right = side == LEFT ? other : token;
+
+        set_token_attribute (left, "match", token_path (right));
+        paired.push_back (std::move (left));
+        ++pairs_;
+
+        return;
+    }
+
+    if (held) {
+        *held += token.size() + key.size() + sizeof (string);
+    }
+
+    table[key].sides[side].push_back (std::move (token));
+} // JoinNode::match_
+
+
+bool
+JoinNode::spill_ (const string& sandbox)
+{
+    if (partitions_.empty()) {
+        for (size_t i = 0; i < JOIN_PARTITIONS; ++i) {
+            partitions_.push_back (sandbox + "/" + id_ + ".join." + std::to_string (i));
+        }
+    }
+
+    vector<std::ofstream> streams;
+
+    for (const auto& partition : partitions_) {
+        streams.emplace_back (partition, std::ios::out | std::ios::binary | std::ios::app);
+    }
+
+    // two lines a token: its side and key, then the token.
+    for (const auto& [key, waiting] : table_) {
+        auto& stream = streams[std::hash<string>{} (key) % JOIN_PARTITIONS];
+
+        for (int side : {LEFT, RIGHT}) {
+            for (const auto& token : waiting.sides[side]) {
+                stream << (side == LEFT ? 'L' : 'R') << key << '\n' << token << '\n';
+            }
+        }
+    }
+
+    bool stat = true;
+
+    for (size_t i = 0; i < streams.size(); ++i) {
+        streams[i].flush();
+
+        if (!streams[i]) {
+            LERROR << LOGNODE << "Cannot write join partition: " << partitions_[i];
+            stat = false;
+        }
+    }
+
+    table_.clear();
+    held_ = 0;
+
+    return stat;
+} // JoinNode::spill_
+
+
+bool
+JoinNode::finish_ (const string& sandbox)
+{
+    // what is still in memory joins the partitions, so every waiting token is paired on disk.
+    if (!spill_ (sandbox)) {
+        return false;
+    }
+
+    vector<string> paired;
+
+    for (const auto& partition : partitions_) {
+        std::ifstream stream (partition, std::ios::in | std::ios::binary);
+
+        if (!stream) {
+            LERROR << LOGNODE << "Cannot read join partition: " << partition;
+            return false;
+        }
+
+        Table table;
+        string header;
+        string token;
+
+        while (std::getline (stream, header) && std::getline (stream, token)) {
+            if (header.empty()) {
+                continue;
+            }
+
+            match_ (table, header.substr (1), header[0] == 'L' ? LEFT : RIGHT, std::move (token), paired, nullptr);
+
+            if (paired.size() >= 4096) {
+                send_ (paired, sandbox);
+            }
+        }
+
+        for (const auto& [key, waiting] : table) {
+            unmatched_ += waiting.sides[LEFT].size() + waiting.sides[RIGHT].size();
+        }
+
+        send_ (paired, sandbox);
+    }
+
+    return true;
+} // JoinNode::finish_
+
+
+void
+JoinNode::send_ (vector<string>& paired, const string& sandbox)
+{
+    if (paired.empty()) {
+        return;
+    }
+
+    OpenOutputs (sandbox);
+    WriteTokens (paired);
+    CloseOutputs();
+
+    paired.clear();
+} // JoinNode::send_
+
+
+json
+JoinNode::Serialize()
+{
+    auto json_ = Node::Serialize();
+    json_[id_]["left"] = left_;
+    json_[id_]["right"] = right_;
+    json_[id_]["regex"] = regex_;
+    json_[id_]["key"] = key_;
+
+    if (key_ == "regex") {json_[id_]["pattern"] = pattern_;}
+
+    if (key_ == "attribute") {json_[id_]["attribute"] = attribute_;}
+
+    json_[id_]["memory"] = memory_;
+
+    if (size_ != std::pair<int, int>(0,0)) {json_[id_]["size"] = size_;}
+
+    return json_;
+} // JoinNode::Serialize
+
+
+void
+JoinNode::Stats()
+{
+    LINFO << LOGNODE << "pairs sent: " << pairs_ << ", tokens unmatched: " << unmatched_
+          << ", table spills: " << spills_;
+
+    Node::Stats();
+} // JoinNode::Stats
+} // namespace daisychain
@@ -0,0 +1,149 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include <deque>
+#include <regex>
+#include <unordered_map>
+#include "matcher.h"
+#include "node.h"
+
+
+namespace daisychain {
+// Pairs tokens from two streams that share a key, such as each image with its metadata file.
+// Input 0 is the left stream and input 1 the right one; the two must come from different
+// nodes. The left and right patterns (globs, or regexes with regex set) are optional filters:
+// a token its side's pattern does not take is dropped. On Windows, where the inputs are not
+// read one at a time, the sides come from the patterns instead, and an empty pattern takes
+// whatever the other one does not.
+//
+// The key is the file name without its extension ("stem", the default), what a regex matches
+// in the path ("regex"; the first capture group when there is one), or the value of one of the
+// token's attributes ("attribute").
+//
+// A pair goes downstream as soon as both of its tokens are in: the left token, with the path of
+// the right one as its "match" attribute, ${ATTR_match} to a command. Each token pairs once,
+// with the earliest token of the other side that is still waiting; tokens left without a
+// partner at EOF are dropped.
+//
+// Waiting tokens are held in a hash table up to the memory budget. Past it, the table is
+// written out to partition files by key, and what is still waiting at EOF is paired up one
+// partition at a time.
+class JoinNode final : public Node
+{
+public:
+    JoinNode();
+
+    void Initialize (json&, bool) override;
+
+    // reads each input on its own rather than through Node::Execute's first merged read.
+    bool Execute (const string& sandbox, json& vars) override;
+
+    bool Execute (vector<string>& input, const string& sandbox, json& vars) override;
+
+    json Serialize() override;
+
+    void Stats() override;
+
+    void set_left (const string& pattern) { left_ = pattern; }
+
+    string left() const { return left_; }
+
+    void set_right (const string& pattern) { right_ = pattern; }
+
+    string right() const { return right_; }
+
+    // left and right are regexes rather than globs.
+    void set_regex (bool is_regex) { regex_ = is_regex; }
+
+    [[nodiscard]] bool regex() const { return regex_; }
+
+    // "stem" (default), "regex" or "attribute".
+    void set_key (const string& key) { key_ = key; }
+
+    string key() const { return key_; }
+
+    // the regex for "regex" keys.
+    void set_pattern (const string& pattern) { pattern_ = pattern; }
+
+    string pattern() const { return pattern_; }
+
+    // the attribute for "attribute" keys.
+    void set_attribute (const string& attribute) { attribute_ = attribute; }
+
+    string attribute() const { return attribute_; }
+
+    // bytes of waiting tokens held in memory.
+    void set_memory (size_t bytes) { memory_ = bytes; }
+
+    [[nodiscard]] size_t memory() const { return memory_; }
+
+private:
+    // not exposed
+    using Node::set_batch_flag;
+    using Node::set_outputfile;
+
+    enum Side { LEFT, RIGHT };
+
+    // tokens waiting for a partner, by side; in one-to-one pairing only one side waits at once.
+    struct Waiting
+    {
+        std::deque<string> sides[2];
+    };
+
+    using Table = std::unordered_map<string, Waiting>;
+
+#ifdef _WIN32
+    // false if token belongs to neither side.
+    bool side_of_ (const string& path, Side& side) const;
+#else
+    // false if the side's pattern does not take path.
+    bool accepts_ (const string& path, Side side) const;
+
+    // reads what is waiting on every input, with the side of each token from its port.
+    void read_ (vector<string>& inputs, vector<Side>& sides);
+#endif
+
+    // false if token has no key.
+    bool key_of_ (const string& token, const string& path, string& key) const;
+
+    // sides holds the side of each input; on Windows it is empty and the patterns decide.
+    void add_ (vector<string>& inputs, const vector<Side>& sides, const string& sandbox);
+
+    // pairs token with a waiting partner, or leaves it waiting; pairs go into paired.
+    void match_ (Table& table, const string& key, Side side, string token, vector<string>& paired, size_t* held);
+
+    // writes the table to the partition files and clears it.
+    bool spill_ (const string& sandbox);
+
+    // pairs what was written out, one partition at a time; false if a partition is unreadable.
+    bool finish_ (const string& sandbox);
+
+    void send_ (vector<string>& paired, const string& sandbox);
+
+    string left_;
+    string right_;
+    bool regex_;
+    string key_;
+    string pattern_;
+    string attribute_;
+    size_t memory_;
+
+    Matcher left_matcher_;
+    Matcher right_matcher_;
+    std::regex key_regex_;
+
+    Table table_;
+    size_t held_;
+    // a spill or partition read failed; waiting tokens were lost.
+    bool failed_;
+    vector<string> partitions_;
+
+    uint64_t pairs_;
+    uint64_t unmatched_;
+    uint64_t spills_;
+};
+} // namespace daisychain
@@ -0,0 +1,158 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "mappedfile.h"
+#include <utility>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace daisychain {
+using namespace std;
+
+
+MappedFile::MappedFile (const string& path)
+{
+#ifdef _WIN32
+    file_ = CreateFileA (path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                         FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx (file_, &size)) {
+        close_();
+        return;
+    }
+
+    size_ = static_cast<size_t> (size.QuadPart);
+    open_ = true;
+
+    if (size_ == 0) {
+        return;
+    }
+
+    mapping_ = CreateFileMappingA (file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    data_ = mapping_ ? static_cast<const char*> (MapViewOfFile (mapping_, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+
+    if (data_ == nullptr) {
+        close_();
+    }
+#else
+    int fd = open (path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return;
+    }
+
+    struct stat info{};
+    if (fstat (fd, &info) == -1 || !S_ISREG (info.st_mode)) {
+        close (fd);
+        return;
+    }
+
+    size_ = size_t (info.st_size);
+    open_ = true;
+
+    if (size_ > 0) {
+        void* data = mmap (nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (data == MAP_FAILED) {
+            size_ = 0;
+            open_ = false;
+        }
+        else {
+            data_ = static_cast<const char*> (data);
+            madvise (data, size_, MADV_SEQUENTIAL);
+        }
+    }
+
+    // the mapping keeps the file alive.
+    close (fd);
+#endif
+} // MappedFile::MappedFile
+
+
+MappedFile::~MappedFile()
+{
+    close_();
+} // MappedFile::~MappedFile
+
+
+MappedFile::MappedFile (MappedFile&& other) noexcept
+{
+    *this = std::move (other);
+} // MappedFile::MappedFile
+
+
+MappedFile&
+MappedFile::operator= (MappedFile&& other) noexcept
+{
+    if (this != &other) {
+        close_();
+        data_ = std::exchange (other.data_, nullptr);
+        size_ = std::exchange (other.size_, 0);
+        open_ = std::exchange (other.open_, false);
+#ifdef _WIN32
+        file_ = std::exchange (other.file_, INVALID_HANDLE_VALUE);
+        mapping_ = std::exchange (other.mapping_, nullptr);
+#endif
+    }
+
+    return *this;
+} // MappedFile::operator=
+
+
+void
+MappedFile::Prefetch() const
+{
+    if (data_ == nullptr) {
+        return;
+    }
+
+#ifndef _WIN32
+    madvise (const_cast<char*> (data_), size_, MADV_WILLNEED);
+    auto page = size_t (sysconf (_SC_PAGESIZE));
+#else
+    size_t page = 4096;
+#endif
+
+    volatile char sink = 0;
+    for (size_t offset = 0; offset < size_; offset += page) {
+        sink = sink + data_[offset];
+    }
+} // MappedFile::Prefetch
+
+
+void
+MappedFile::close_()
+{
+#ifdef _WIN32
+    if (data_ != nullptr) {
+        UnmapViewOfFile (data_);
+    }
+    if (mapping_ != nullptr) {
+        CloseHandle (mapping_);
+    }
+    if (file_ != INVALID_HANDLE_VALUE) {
+        CloseHandle (file_);
+    }
+    file_ = INVALID_HANDLE_VALUE;
+    mapping_ = nullptr;
+#else
+    if (data_ != nullptr) {
+        munmap (const_cast<char*> (data_), size_);
+    }
+#endif
+
+    data_ = nullptr;
+    size_ = 0;
+    open_ = false;
+} // MappedFile::close_
+} // namespace daisychain
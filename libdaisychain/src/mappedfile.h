@@ -0,0 +1,54 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+
+namespace daisychain {
+using namespace std;
+
+
+// Read-only memory mapping of a whole file. A file that cannot be mapped reports !is_open();
+// an empty file is open with an empty view.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+
+    explicit MappedFile (const string& path);
+
+    ~MappedFile();
+
+    MappedFile (const MappedFile&) = delete;
+    MappedFile& operator= (const MappedFile&) = delete;
+
+    MappedFile (MappedFile&& other) noexcept;
+    MappedFile& operator= (MappedFile&& other) noexcept;
+
+    [[nodiscard]] bool is_open() const { return open_; }
+
+    [[nodiscard]] std::string_view view() const { return {data_, size_}; }
+
+    // asks the kernel to read the file ahead and faults the pages in.
+    void Prefetch() const;
+
+private:
+    void close_();
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool open_ = false;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#endif
+};
+} // namespace daisychain
@@ -0,0 +1,281 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "matcher.h"
+#include <algorithm>
+#ifdef _WIN32
+#include <windows.h>
+#include <shlwapi.h>
+#pragma comment(lib, "Shlwapi.lib")
+#else
+#include <fnmatch.h>
+#endif
+
+
+#if defined(__APPLE__)
+#define FNM_EXTMATCH 0
+#endif // if defined(__APPLE__)
+
+
+namespace daisychain {
+using namespace std;
+
+
+namespace {
+// characters that give a glob more meaning than a literal, extended patterns included.
+constexpr std::string_view GLOB_SPECIALS = "*?[]\\()|+@!";
+
+
+bool
+is_literal (std::string_view s)
+{
+    return s.find_first_of (GLOB_SPECIALS) == std::string_view::npos;
+}
+
+
+void
+add_length (vector<size_t>& lengths, size_t length)
+{
+    if (std::find (lengths.begin(), lengths.end(), length) == lengths.end()) {
+        lengths.push_back (length);
+    }
+}
+} // namespace
+
+
+size_t
+Matcher::Add (const string& pattern, bool is_regex)
+{
+    auto index = patterns_.size();
+    Pattern entry{pattern, is_regex, {}, {}, {}};
+
+    if (is_regex) {
+        if (!automaton_.Add (pattern, index)) {
+            entry.expr = std::regex (pattern);
+            literals_ (pattern, entry.prefix, entry.suffix);
+            general_.push_back (index);
+        }
+        patterns_.push_back (std::move (entry));
+        cache_.clear();
+        cache_index_.clear();
+
+        return index;
+    }
+
+    patterns_.push_back (std::move (entry));
+    cache_.clear();
+    cache_index_.clear();
+
+#ifdef _WIN32
+    // PathMatchSpec is case-insensitive and takes ';' lists, keep its semantics.
+    general_.push_back (index);
+#else
+    std::string_view glob (pattern);
+
+    if (is_literal (glob)) {
+        exact_[pattern].push_back (index);
+    }
+    else if (glob == "*") {
+        any_.push_back (index);
+        leading_star_.push_back (index);
+    }
+    else if (glob.front() == '*' && is_literal (glob.substr (1))) {
+        suffixes_[string (glob.substr (1))].push_back (index);
+        add_length (suffix_lengths_, glob.size() - 1);
+        leading_star_.push_back (index);
+    }
+    else if (glob.back() == '*' && is_literal (glob.substr (0, glob.size() - 1))) {
+        prefixes_[string (glob.substr (0, glob.size() - 1))].push_back (index);
+        add_length (prefix_lengths_, glob.size() - 1);
+    }
+    else {
+        general_.push_back (index);
+    }
+#endif
+
+    return index;
+} // Matcher::Add
+
+
+void
+Matcher::Clear()
+{
+    patterns_.clear();
+    exact_.clear();
+    prefixes_.clear();
+    suffixes_.clear();
+    prefix_lengths_.clear();
+    suffix_lengths_.clear();
+    any_.clear();
+    leading_star_.clear();
+    general_.clear();
+    automaton_.Clear();
+    cache_.clear();
+    cache_index_.clear();
+} // Matcher::Clear
+
+
+void
+Matcher::Match (const string& token, vector<size_t>& matches) const
+{
+    if (cache_size_ == 0) {
+        match_all_ (token, matches);
+        return;
+    }
+
+    auto it = cache_index_.find (token);
+
+    if (it != cache_index_.end()) {
+        cache_.splice (cache_.begin(), cache_, it->second);
+        matches = it->second->second;
+        return;
+    }
+
+    match_all_ (token, matches);
+
+    cache_.emplace_front (token, matches);
+    cache_index_[token] = cache_.begin();
+
+    if (cache_.size() > cache_size_) {
+        cache_index_.erase (cache_.back().first);
+        cache_.pop_back();
+    }
+} // Matcher::Match
+
+
+void
+Matcher::set_cache_size (size_t size)
+{
+    cache_size_ = size;
+    cache_.clear();
+    cache_index_.clear();
+} // Matcher::set_cache_size
+
+
+void
+Matcher::match_all_ (const string& token, vector<size_t>& matches) const
+{
+    matches.clear();
+
+    std::string_view view (token);
+
+    lookup_ (exact_, view, matches);
+
+    for (auto length : prefix_lengths_) {
+        if (length <= view.size()) {
+            lookup_ (prefixes_, view.substr (0, length), matches);
+        }
+    }
+
+    if (!token.empty() && token.front() == '.') {
+        // a leading period must be matched explicitly; let fnmatch decide.
+        for (auto index : leading_star_) {
+            if (match_ (index, token)) {
+                matches.push_back (index);
+            }
+        }
+    }
+    else {
+        for (auto length : suffix_lengths_) {
+            if (length <= view.size()) {
+                lookup_ (suffixes_, view.substr (view.size() - length), matches);
+            }
+        }
+
+        matches.insert (matches.end(), any_.begin(), any_.end());
+    }
+
+    automaton_.Match (view, matches);
+
+    for (auto index : general_) {
+        if (match_ (index, token)) {
+            matches.push_back (index);
+        }
+    }
+
+    std::sort (matches.begin(), matches.end());
+    matches.erase (std::unique (matches.begin(), matches.end()), matches.end());
+} // Matcher::match_all_
+
+
+int64_t
+Matcher::First (const string& token) const
+{
+    vector<size_t> matches;
+    Match (token, matches);
+
+    return matches.empty() ? -1 : int64_t (matches.front());
+} // Matcher::First
+
+
+bool
+Matcher::match_ (size_t index, const string& token) const
+{
+    const auto& entry = patterns_[index];
+
+    if (entry.regex) {
+        return token.starts_with (entry.prefix) && token.ends_with (entry.suffix)
+            && std::regex_match (token, entry.expr);
+    }
+
+#ifdef _WIN32
+    return PathMatchSpec (token.c_str(), entry.pattern.c_str());
+#else
+    return fnmatch (entry.pattern.c_str(), token.c_str(), FNM_PERIOD | FNM_EXTMATCH) == 0;
+#endif
+} // Matcher::match_
+
+
+void
+Matcher::lookup_ (const Table& table, std::string_view key, vector<size_t>& matches)
+{
+    auto it = table.find (key);
+
+    if (it != table.end()) {
+        matches.insert (matches.end(), it->second.begin(), it->second.end());
+    }
+} // Matcher::lookup_
+
+
+void
+Matcher::literals_ (const string& pattern, string& prefix, string& suffix)
+{
+    // conservative: any '|' disables both.
+    prefix.clear();
+    suffix.clear();
+
+    if (pattern.find ('|') != string::npos) {
+        return;
+    }
+
+    std::string_view specials = "\\^$.|?*+()[]{}";
+    size_t start = !pattern.empty() && pattern.front() == '^' ? 1 : 0;
+    auto end = pattern.find_first_of (specials, start);
+    prefix = pattern.substr (start, end == string::npos ? string::npos : end - start);
+
+    // the last literal may be the operand of a quantifier that allows it to be absent.
+    if (end != string::npos && !prefix.empty() && (pattern[end] == '?' || pattern[end] == '*' || pattern[end] == '{')) {
+        prefix.pop_back();
+    }
+
+    size_t stop = pattern.size();
+    if (stop > 0 && pattern.back() == '$' && (stop < 2 || pattern[stop - 2] != '\\')) {
+        --stop;
+    }
+
+    auto last = pattern.find_last_of (specials, stop == 0 ? string::npos : stop - 1);
+
+    if (last == string::npos) {
+        suffix = pattern.substr (0, stop);
+    }
+    else {
+        // an escape such as \x41, \u0041 or \cJ can span any number of the characters after
+        // the backslash, so nothing there is known to be a literal.
+        if (pattern[last] != '\\') {
+            suffix = pattern.substr (last + 1, stop - last - 1);
+        }
+    }
+} // Matcher::literals_
+} // namespace daisychain
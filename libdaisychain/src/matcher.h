@@ -0,0 +1,105 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "regexautomaton.h"
+
+
+namespace daisychain {
+using namespace std;
+
+
+// A set of glob and regex patterns compiled so that a token is examined once, not once per
+// pattern. Globs that are plain literals, `literal*`, `*literal` or `*` are looked up in hash
+// tables keyed by the token, its prefixes and its suffixes; regexes share one RegexAutomaton.
+// Everything else falls back to fnmatch (PathMatchSpec on Windows) or std::regex_match, with
+// the same semantics as FilterNode; fallback regexes are skipped early when the token lacks
+// their literal prefix or suffix.
+//
+// With a cache size set, results for the most recently seen tokens are kept (LRU), which
+// pays off on streams that repeat tokens, e.g. a watched file that changes often.
+class Matcher
+{
+public:
+    Matcher() = default;
+
+    // returns the pattern's index; throws std::regex_error for an invalid regex.
+    size_t Add (const string& pattern, bool is_regex);
+
+    void Clear();
+
+    // indices of all matching patterns, ascending.
+    void Match (const string& token, vector<size_t>& matches) const;
+
+    // index of the first matching pattern, -1 when nothing matches.
+    [[nodiscard]] int64_t First (const string& token) const;
+
+    [[nodiscard]] size_t size() const { return patterns_.size(); }
+
+    [[nodiscard]] bool empty() const { return patterns_.empty(); }
+
+    // number of token results kept; 0 disables the cache.
+    void set_cache_size (size_t size);
+
+    [[nodiscard]] size_t cache_size() const { return cache_size_; }
+
+private:
+    struct Pattern
+    {
+        string pattern;
+        bool regex;
+        std::regex expr;
+        // literals every match must start and end with (std::regex fallback only).
+        string prefix;
+        string suffix;
+    };
+
+    struct Hash
+    {
+        using is_transparent = void;
+        size_t operator() (std::string_view s) const { return std::hash<std::string_view>{} (s); }
+    };
+
+    using Table = std::unordered_map<string, vector<size_t>, Hash, std::equal_to<>>;
+
+    // pattern is evaluated one at a time, not through the tables.
+    bool match_ (size_t index, const string& token) const;
+
+    void match_all_ (const string& token, vector<size_t>& matches) const;
+
+    static void lookup_ (const Table& table, std::string_view key, vector<size_t>& matches);
+
+    static void literals_ (const string& pattern, string& prefix, string& suffix);
+
+    vector<Pattern> patterns_;
+    Table exact_;
+    // keyed by the literal part; the lengths present are kept so a token is probed only
+    // with prefixes and suffixes that can exist.
+    Table prefixes_;
+    Table suffixes_;
+    vector<size_t> prefix_lengths_;
+    vector<size_t> suffix_lengths_;
+    vector<size_t> any_;
+    // patterns that start with '*' and so never match a leading period (FNM_PERIOD).
+    vector<size_t> leading_star_;
+    vector<size_t> general_;
+    RegexAutomaton automaton_;
+
+    using CacheList = std::list<pair<string, vector<size_t>>>;
+
+    size_t cache_size_ = 0;
+    mutable CacheList cache_;
+    mutable std::unordered_map<string, CacheList::iterator, Hash, std::equal_to<>> cache_index_;
+};
+} // namespace daisychain
@@ -17,13 +17,19 @@ Node::Node () :
     size_ (std::pair<int, int> (0, 0)),
     type_ (DC_INVALID),
     batch_ (false),
+    batch_memory_ (256 * 1024 * 1024),
     test_ (false),
+    defaults_ (json::object()),
     isroot_ (true),
     eofs_ (0),
     totalbytesread_ (0),
-    totalbyteswritten_ (0)
+    totalbyteswritten_ (0),
+    tokensread_ (0),
+    tokenswritten_ (0),
+    event_fd_ (-1)
 {
     terminate_.store (false);
+    cancelled_.store (false);
 }
 
 
@@ -58,6 +64,8 @@ Node::Initialize (json& keydata, bool keep_uuid)
     if (data.count ("size")) {
         set_size (std::pair<int, int> (data["size"][0], data["size"][1]));
     }
+
+    set_environment_defaults (data.count ("environment") ? data["environment"] : json::object());
 }
 
 
@@ -71,10 +79,28 @@ Node::Serialize()
           {"position", position_}}}
     };
 
+    if (!defaults_.empty()) {
+        json_[id_]["environment"] = defaults_;
+    }
+
     return json_;
 }
 
 
+json
+Node::environment (const json& env) const
+{
+    json merged = defaults_;
+
+    // a graph without an environment passes null, which merge_patch() would copy over.
+    if (env.is_object()) {
+        merged.merge_patch (env);
+    }
+
+    return merged;
+} // Node::environment
+
+
 #ifdef _WIN32
 void
 Node::Start (NodeThreadContext* ctx, const string& sandbox, json& vars, const string& threadname)
@@ -83,12 +109,17 @@ Node::Start (NodeThreadContext* ctx, const string& sandbox, json& vars, const st
     terminate_.store (false);
     thread_ = std::thread ([this, &sandbox, &vars, threadname]() {
         this->set_threadname (threadname);
+        this->Report (DC_NODE_STARTED);
         this->OpenWindowsPipes (sandbox);
         auto stat = this->Execute (sandbox, vars);
         this->CloseWindowsPipes();
         LINFO_IF (stat && !terminate_.load()) << "<" << name_ << "> Finished.";
         LWARN_IF (terminate_.load()) << "<" << name_ << "> Terminated.";
         LERROR_IF (!stat && !terminate_.load()) << "<" << name_ << "> Failed.";
+        if (!stat) {
+            ++context_->nodes_failed;
+        }
+        this->Report (stat ? DC_NODE_FINISHED : DC_NODE_FAILED);
     });
 }
 
@@ -100,12 +131,17 @@ Node::Start (NodeThreadContext* ctx, vector<string>& inputs, const string& sandb
     terminate_.store (false);
     thread_ = std::thread ([this, &inputs, &sandbox, &vars, threadname]() {
         this->set_threadname (threadname);
+        this->Report (DC_NODE_STARTED);
         this->OpenWindowsPipes (sandbox);
         auto stat = this->Execute (inputs, sandbox, vars);
         this->CloseWindowsPipes();
         LINFO_IF (stat && !terminate_.load()) << "<" << name_ << "> Finished.";
         LWARN_IF (terminate_.load()) << "<" << name_ << "> Terminated.";
         LERROR_IF (!stat && !terminate_.load()) << "<" << name_ << "> Failed.";
+        if (!stat) {
+            ++context_->nodes_failed;
+        }
+        this->Report (stat ? DC_NODE_FINISHED : DC_NODE_FAILED);
     });
 }
 
@@ -135,27 +171,127 @@ Node::Execute (const string& sandbox, json& env)
 
     OpenInputs (sandbox);
 
+    if (!batch_) {
+        ReadInputs (inputs);
+        if (terminate_.load()) return false;
+
+        return Execute (inputs, sandbox, env);
+    }
+
+    // the batch is collected in bounded memory as it arrives and sorted on disk.
+    BatchSpool spool (sandbox, id_, batch_memory_);
+
     do {
         eof = ReadInputs (inputs);
         if (terminate_.load()) return false;
-    } while (batch_ && eof != -1);
 
-    if (batch_) {
-        concat_inputs (inputs);
+        for (auto& input : inputs) {
+            if (input != "EOF") {
+                spool.Add (std::move (input));
+            }
+        }
+        inputs.clear();
+    } while (eof != -1);
+
+    if (!finish_batch_ (spool, inputs)) {
+        CloseInputs();
+        OpenOutputs (sandbox);
+        WriteOutputs ("EOF");
+        CloseOutputs();
+        Reset();
+
+        return false;
     }
 
     return Execute (inputs, sandbox, env);
 } // Execute
 
 
+bool
+Node::finish_batch_ (BatchSpool& spool, vector<string>& inputs)
+{
+    inputs.clear();
+
+    if (!spool.Finish()) {
+        LERROR << LOGNODE << "Cannot sort batch into " << spool.path();
+        return false;
+    }
+
+    LDEBUG << LOGNODE << "batch of " << spool.size() << " tokens sorted from " << spool.runs() << " runs.";
+
+    batchfile_ = spool.path();
+
+    // an empty batch runs nothing, as before.
+    if (spool.size()) {
+        inputs.push_back (batchfile_);
+    }
+    inputs.emplace_back ("EOF");
+
+    return true;
+} // finish_batch_
+
+
 void
 Node::Stats()
 {
     LDEBUG << LOGNODE << "total bytes read: " << totalbytesread_;
     LDEBUG << LOGNODE << "total bytes written: " << totalbyteswritten_;
+    LDEBUG << LOGNODE << "total tokens read: " << tokensread_;
+    LDEBUG << LOGNODE << "total tokens written: " << tokenswritten_;
+
+    // final counts go out before Reset() clears them.
+    Report (DC_NODE_PROGRESS);
 } // Stats
 
 
+void
+Node::WriteTokens (const vector<string>& tokens)
+{
+    string block;
+    size_t count = 0;
+
+    for (const auto& token : tokens) {
+        if (!block.empty() && block.size() + token.size() + 1 > DAISY_BLOCK_SIZE) {
+            WriteBlock (block, count);
+            block.clear();
+            count = 0;
+        }
+
+        block += token;
+        block += '\n';
+        ++count;
+    }
+
+    WriteBlock (block, count);
+} // WriteTokens
+
+
+void
+Node::Report (NodeState state)
+{
+    if (event_fd_ < 0) {
+        return;
+    }
+
+    NodeEvent event{};
+    event.state = state;
+    id_.copy (event.node, sizeof (event.node) - 1);
+    event.tokens_in = tokensread_;
+    event.tokens_out = tokenswritten_;
+
+#ifdef _WIN32
+    auto numbytes = _write (event_fd_, &event, sizeof (event));
+#else
+    ssize_t numbytes;
+    do {
+        numbytes = write (event_fd_, &event, sizeof (event));
+    } while (numbytes == -1 && errno == EINTR);
+#endif
+
+    LDEBUG_IF (numbytes != sizeof (event)) << LOGNODE << "Cannot report node state.";
+} // Report
+
+
 void
 Node::AddInput (const string& fifo)
 {
@@ -167,7 +303,7 @@ Node::AddInput (const string& fifo)
 void
 Node::RemoveInput (const string& fifo)
 {
-    inputs_.remove (fifo);
+    std::erase (inputs_, fifo);
 
     if (inputs_.empty()) {
         isroot_ = true;
@@ -180,6 +316,11 @@ Node::OpenInputs (const string& sandbox)
 {
 #ifndef _WIN32
     for (const auto& fifo : inputs_) {
+        // duplicate connections share one FIFO.
+        if (std::find (fifo_in_.begin(), fifo_in_.end(), fifo) != fifo_in_.end()) {
+            continue;
+        }
+
         string filepath = sandbox;
         filepath.append ("/");
         filepath.append (fifo);
@@ -190,7 +331,8 @@ Node::OpenInputs (const string& sandbox)
             continue;
         }
 
-        fd_in_[fifo] = fd;
+        fd_in_.push_back ({fd, POLLIN, 0});
+        fifo_in_.push_back (fifo);
     }
 #endif
 } // OpenInputs
@@ -200,14 +342,17 @@ void
 Node::CloseInputs()
 {
 #ifndef _WIN32
-    for (const auto& fd : fd_in_) {
-        int stat = close (fd.second);
+    for (size_t i = 0; i < fd_in_.size(); ++i) {
+        int stat = close (fd_in_[i].fd);
 
         if (stat == -1) {
-            LERROR << LOGNODE << "Cannot close input file descriptor: " << fd.first;
+            LERROR << LOGNODE << "Cannot close input file descriptor: " << fifo_in_[i];
             continue;
         }
     }
+
+    fd_in_.clear();
+    fifo_in_.clear();
 #endif
 } // CloseInputs
 
@@ -217,6 +362,10 @@ Node::OpenOutputs (const string& sandbox)
 {
 #ifndef _WIN32
     for (const auto& fifo : outputs_) {
+        if (std::find (fifo_out_.begin(), fifo_out_.end(), fifo) != fifo_out_.end()) {
+            continue;
+        }
+
         string filepath = sandbox;
         filepath.append ("/");
         filepath.append (fifo);
@@ -228,7 +377,15 @@ Node::OpenOutputs (const string& sandbox)
             continue;
         }
 
-        fd_out_[fifo] = fd;
+        fd_out_.push_back ({fd, POLLOUT, 0});
+        fifo_out_.push_back (fifo);
+    }
+
+    port_out_.clear();
+
+    for (const auto& fifo : outputs_) {
+        auto it = std::find (fifo_out_.begin(), fifo_out_.end(), fifo);
+        port_out_.push_back (it == fifo_out_.end() ? -1 : int (it - fifo_out_.begin()));
     }
 #endif
 } // OpenOutputs
@@ -238,13 +395,17 @@ void
 Node::CloseOutputs()
 {
 #ifndef _WIN32
-    for (const auto& fd : fd_out_) {
-        int stat = close (fd.second);
+    for (size_t i = 0; i < fd_out_.size(); ++i) {
+        int stat = close (fd_out_[i].fd);
 
         if (stat == -1) {
-            LERROR << LOGNODE << "Cannot close output file descriptor: " << fd.first;
+            LERROR << LOGNODE << "Cannot close output file descriptor: " << fifo_out_[i];
         }
     }
+
+    fd_out_.clear();
+    fifo_out_.clear();
+    port_out_.clear();
 #endif
 } // CloseOutputs
 
@@ -253,31 +414,20 @@ Node::CloseOutputs()
 int
 Node::ReadInputs (vector<string>& inputs)
 {
-    struct pollfd pfds[fd_in_.size()];
-
-    int i = 0;
-
-    for (const auto& fd : fd_in_) {
-        pfds[i].fd = fd.second;
-        pfds[i].events = POLLIN;
-        i++;
-    }
-
     uint32_t BUFFSIZE = 8192;
     char cbuffer[BUFFSIZE + 1];
     string input;
 
-    auto ret = poll (pfds, fd_in_.size(), 2);
+    auto ret = poll (fd_in_.data(), fd_in_.size(), 2);
+    auto before = inputs.size();
 
     if (ret > 0) {
-        i = 0;
-
-        for (const auto& fd : fd_in_) {
-            if (pfds[i].revents) {
+        for (const auto& pfd : fd_in_) {
+            if (pfd.revents) {
                 ssize_t numbytes = 0;
 
                 do {
-                    numbytes = read (fd.second, cbuffer, BUFFSIZE);
+                    numbytes = read (pfd.fd, cbuffer, BUFFSIZE);
                     if (numbytes > 0) {
                         cbuffer[numbytes] = '\0';
                         input += cbuffer;
@@ -285,8 +435,6 @@ Node::ReadInputs (vector<string>& inputs)
                     }
                 } while (numbytes > 0 || (numbytes == -1 && errno == EINTR));
             }
-
-            i++;
         }
 
         m_split_input (input, inputs);
@@ -299,6 +447,16 @@ Node::ReadInputs (vector<string>& inputs)
         LDEBUG << LOGNODE << "EOF COUNT: " << eofs_;
     }
 
+    // new tokens are inserted at the front of inputs.
+    if (auto added = inputs.size() - before) {
+        tokensread_ += added - std::count (inputs.begin(), inputs.begin() + long (added), "EOF");
+        progress_();
+    }
+
+    if (cancelled_.load()) {
+        std::erase_if (inputs, [] (const string& token) { return token != "EOF"; });
+    }
+
     return (eofs_ == fd_in_.size()) ? -1 : eofs_;
 } // ReadInputs
 
@@ -306,16 +464,14 @@ Node::ReadInputs (vector<string>& inputs)
 void
 Node::WriteOutputs (const string& output)
 {
-    string token = output + '\n';
-
-    struct pollfd pfds[fd_out_.size()];
+    if (cancelled_.load() && output != "EOF")
+        return;
 
-    int i = 0;
+    string token = output + '\n';
 
-    for (const auto& fd : fd_out_) {
-        pfds[i].fd = fd.second;
-        pfds[i].events = POLLOUT;
-        i++;
+    // a finished descriptor has its events cleared below; re-arm them for this token.
+    for (auto& pfd : fd_out_) {
+        pfd.events = POLLOUT;
     }
 
     size_t byteswritten = 0;
@@ -323,26 +479,26 @@ Node::WriteOutputs (const string& output)
     int ret = 0;
 
     do {
-        ret = poll (pfds, fd_out_.size(), 2);
+        ret = poll (fd_out_.data(), fd_out_.size(), 2);
 
         if (ret > 0) {
-            i = 0;
+            for (size_t i = 0; i < fd_out_.size(); ++i) {
+                auto& pfd = fd_out_[i];
 
-            for (const auto& fd : fd_out_) {
-                if (pfds[i].revents) {
+                if (pfd.revents) {
                     size_t numbytes = 0;
                     size_t tokensize = 0;
 
                     do {
                         tokensize = token.size();
-                        numbytes = write (fd.second, token.c_str(), token.size());
+                        numbytes = write (pfd.fd, token.c_str(), token.size());
 
                         if (numbytes == -1) {
-                            LERROR << LOGNODE << "Cannot write to file descriptor: " << fd.first;
+                            LERROR << LOGNODE << "Cannot write to file descriptor: " << fifo_out_[i];
                             continue;
                         }
                         else if (numbytes == tokensize) {
-                            pfds[i].events = 0;
+                            pfd.events = 0;
                         }
                         else if (numbytes) {
                             token = output.substr (numbytes) + '\n';
@@ -352,13 +508,128 @@ Node::WriteOutputs (const string& output)
                         totalbyteswritten_ += numbytes;
                     } while (numbytes < tokensize || (numbytes == -1 && errno == EINTR));
                 }
-
-                i++;
             }
         }
     } while (byteswritten < totalbytes);
+
+    if (output != "EOF") {
+        ++tokenswritten_;
+        progress_();
+    }
 } // WriteOutputs
 
+
+void
+Node::WriteSelectedOutputs (const string& output, const vector<size_t>& ports)
+{
+    if (cancelled_.load() && output != "EOF")
+        return;
+
+    for (auto& pfd : fd_out_) {
+        pfd.events = 0;
+    }
+
+    bool selected = false;
+
+    for (auto port : ports) {
+        if (port < port_out_.size() && port_out_[port] != -1) {
+            fd_out_[size_t (port_out_[port])].events = POLLOUT;
+            selected = true;
+        }
+    }
+
+    if (!selected) {
+        return;
+    }
+
+    const string token = output + '\n';
+    write_armed_ (token);
+
+    if (output != "EOF") {
+        ++tokenswritten_;
+        progress_();
+    }
+} // WriteSelectedOutputs
+
+
+void
+Node::WriteBlock (std::string_view block, size_t tokens)
+{
+    if (cancelled_.load() || block.empty())
+        return;
+
+    for (auto& pfd : fd_out_) {
+        pfd.events = POLLOUT;
+    }
+
+    write_armed_ (block);
+
+    tokenswritten_ += tokens;
+    progress_();
+} // WriteBlock
+
+
+void
+Node::WritePortBlock (std::string_view block, size_t tokens, size_t port)
+{
+    if (cancelled_.load() || block.empty() || port >= port_out_.size() || port_out_[port] == -1)
+        return;
+
+    for (auto& pfd : fd_out_) {
+        pfd.events = 0;
+    }
+
+    fd_out_[size_t (port_out_[port])].events = POLLOUT;
+    write_armed_ (block);
+
+    tokenswritten_ += tokens;
+    progress_();
+} // WritePortBlock
+
+
+void
+Node::write_armed_ (std::string_view block)
+{
+    vector<size_t> written (fd_out_.size(), 0);
+    auto remaining = size_t (std::count_if (fd_out_.begin(), fd_out_.end(),
+                                            [] (const auto& pfd) { return pfd.events != 0; }));
+
+    while (remaining) {
+        if (poll (fd_out_.data(), fd_out_.size(), 2) <= 0) {
+            continue;
+        }
+
+        for (size_t i = 0; i < fd_out_.size(); ++i) {
+            auto& pfd = fd_out_[i];
+
+            if (!pfd.events || !pfd.revents) {
+                continue;
+            }
+
+            auto numbytes = write (pfd.fd, block.data() + written[i], block.size() - written[i]);
+
+            if (numbytes == -1) {
+                if (errno == EINTR || errno == EAGAIN) {
+                    continue;
+                }
+
+                LERROR << LOGNODE << "Cannot write to file descriptor: " << fifo_out_[i];
+                numbytes = ssize_t (block.size() - written[i]);
+            }
+            else {
+                totalbyteswritten_ += size_t (numbytes);
+            }
+
+            written[i] += size_t (numbytes);
+
+            if (written[i] == block.size()) {
+                pfd.events = 0;
+                --remaining;
+            }
+        }
+    }
+} // write_armed_
+
 #else
 void
 Node::OpenWindowsPipes (const string& sandbox_)
@@ -632,12 +903,23 @@ Node::ReadInputs (std::vector<std::string>& inputs)
         }
     }
 
+    auto before = inputs.size();
     m_split_input(input, inputs);
 
     if (auto count = ranges::count (inputs, "EOF")) {
         eofs_ += static_cast<int>(count);
     }
 
+    // new tokens are inserted at the front of inputs.
+    if (auto added = inputs.size() - before) {
+        tokensread_ += added - std::count (inputs.begin(), inputs.begin() + long (added), "EOF");
+        progress_();
+    }
+
+    if (cancelled_.load()) {
+        std::erase_if (inputs, [] (const string& token) { return token != "EOF"; });
+    }
+
     return (eofs_ == fd_in_.size()) ? -1 : eofs_;
 }
 
@@ -648,10 +930,18 @@ Node::WriteOutputs(const std::string& output)
     if (terminate_.load())
         return;
 
+    if (cancelled_.load() && output != "EOF")
+        return;
+
     if (output == "EOF") {
         LDEBUG << LOGNODE << "Writing EOF.";
     }
 
+    if (output != "EOF") {
+        ++tokenswritten_;
+        progress_();
+    }
+
     std::string token = output + '\n';
     std::vector<DWORD> byteswritten (fd_out_.size(), 0); // Tracks bytes written for each pipe
     std::vector<HANDLE> events;                          // Events for overlapped writes to wait for
@@ -764,6 +1054,106 @@ Node::WriteOutputs(const std::string& output)
         }
     }
 }
+
+
+void
+Node::WriteSelectedOutputs (const std::string& output, const vector<size_t>& ports)
+{
+    if (terminate_.load())
+        return;
+
+    if (cancelled_.load() && output != "EOF")
+        return;
+
+    std::set<std::string> fifos;
+    for (auto port : ports) {
+        if (port < outputs_.size()) {
+            fifos.insert (outputs_[port]);
+        }
+    }
+
+    std::string token = output + '\n';
+
+    for (const auto& fifo : fifos) {
+        auto it = fd_out_.find (fifo);
+        if (it == fd_out_.end()) {
+            continue;
+        }
+
+        // write_events_ follows the (sorted) order of fd_out_.
+        auto& pipe = write_events_[std::distance (fd_out_.begin(), it)];
+        pipe.overlapped.Offset = 0;
+        pipe.overlapped.OffsetHigh = 0;
+        ResetEvent (pipe.event);
+
+        DWORD wrote = 0;
+        if (!WriteFile (it->second, token.data(), static_cast<DWORD>(token.size()), &wrote, &pipe.overlapped)) {
+            DWORD error = GetLastError();
+            if (error != ERROR_IO_PENDING) {
+                LERROR << LOGNODE << "WriteFile failed with error: " << error;
+                continue;
+            }
+
+            HANDLE events[] = { pipe.event, terminate_event_ };
+            if (WaitForMultipleObjects (2, events, FALSE, INFINITE) != WAIT_OBJECT_0) {
+                return;
+            }
+
+            if (!GetOverlappedResult (it->second, &pipe.overlapped, &wrote, FALSE)) {
+                LERROR << LOGNODE << "GetOverlappedResult failed with error: " << GetLastError();
+                continue;
+            }
+        }
+
+        totalbyteswritten_ += wrote;
+        FlushFileBuffers (it->second);
+    }
+
+    if (output != "EOF" && !fifos.empty()) {
+        ++tokenswritten_;
+        progress_();
+    }
+} // WriteSelectedOutputs
+
+
+void
+Node::WriteBlock (std::string_view block, size_t tokens)
+{
+    // message-mode pipes deliver one token per message; keep that framing.
+    size_t start = 0;
+
+    while (start < block.size()) {
+        auto end = block.find ('\n', start);
+        if (end == std::string_view::npos) {
+            end = block.size();
+        }
+
+        WriteOutputs (std::string (block.substr (start, end - start)));
+        start = end + 1;
+    }
+} // WriteBlock
+
+
+void
+Node::WritePortBlock (std::string_view block, size_t tokens, size_t port)
+{
+    // one message per token, as in WriteBlock; the block's tokens are counted once.
+    auto written = tokenswritten_;
+    const vector<size_t> ports{port};
+    size_t start = 0;
+
+    while (start < block.size()) {
+        auto end = block.find ('\n', start);
+        if (end == std::string_view::npos) {
+            end = block.size();
+        }
+
+        WriteSelectedOutputs (std::string (block.substr (start, end - start)), ports);
+        start = end + 1;
+    }
+
+    tokenswritten_ = written + tokens;
+} // WritePortBlock
 #endif
 
 
@@ -781,10 +1171,21 @@ Node::Reset()
 #ifndef _WIN32
     fd_in_.clear();
     fd_out_.clear();
+    fifo_in_.clear();
+    fifo_out_.clear();
+    port_out_.clear();
 #endif
     eofs_ = 0;
     totalbytesread_ = 0;
     totalbyteswritten_ = 0;
+    tokensread_ = 0;
+    tokenswritten_ = 0;
+
+    if (!batchfile_.empty()) {
+        std::error_code ec;
+        std::filesystem::remove (batchfile_, ec);
+        batchfile_.clear();
+    }
 }
 
 int
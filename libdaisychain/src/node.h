@@ -7,10 +7,12 @@
 
 #include <list>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 #include <set>
 #include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <fcntl.h>
 #include <iostream>
@@ -22,8 +24,11 @@
 #include <sys/poll.h>
 #include <wordexp.h>
 #include <cerrno>
+#include <climits>
 #endif
 
+#include "batchspool.h"
+#include "token.h"
 #include "logger.h"
 #include "utils.h"
 
@@ -43,7 +48,16 @@ enum DaisyNodeType : short {
     DC_CONCAT,
     DC_DISTRO,
     DC_FILELIST,
-    DC_WATCH
+    DC_WATCH,
+    DC_SUBGRAPH,
+    DC_ROUTER,
+    DC_DIRSCAN,
+    DC_DEDUP,
+    DC_THROTTLE,
+    DC_WINDOW,
+    DC_GROUPBY,
+    DC_JOIN,
+    DC_SPLIT
 };
 
 static std::map<short, std::string> DaisyNodeNameByType = {
@@ -53,7 +67,16 @@ static std::map<short, std::string> DaisyNodeNameByType = {
     {     DC_CONCAT,   "concat"},
     {     DC_DISTRO,   "distro"},
     {   DC_FILELIST, "filelist"},
-    {      DC_WATCH,    "watch"}
+    {      DC_WATCH,    "watch"},
+    {   DC_SUBGRAPH, "subgraph"},
+    {     DC_ROUTER,   "router"},
+    {    DC_DIRSCAN,  "dirscan"},
+    {      DC_DEDUP,    "dedup"},
+    {   DC_THROTTLE, "throttle"},
+    {     DC_WINDOW,   "window"},
+    {    DC_GROUPBY,  "groupby"},
+    {       DC_JOIN,     "join"},
+    {      DC_SPLIT,    "split"}
 };
 
 NLOHMANN_JSON_SERIALIZE_ENUM
@@ -66,10 +89,56 @@ NLOHMANN_JSON_SERIALIZE_ENUM
     {     DC_CONCAT,   "concat"},
     {     DC_DISTRO,   "distro"},
     {   DC_FILELIST, "filelist"},
-    {      DC_WATCH,    "watch"}
+    {      DC_WATCH,    "watch"},
+    {   DC_SUBGRAPH, "subgraph"},
+    {     DC_ROUTER,   "router"},
+    {    DC_DIRSCAN,  "dirscan"},
+    {      DC_DEDUP,    "dedup"},
+    {   DC_THROTTLE, "throttle"},
+    {     DC_WINDOW,   "window"},
+    {    DC_GROUPBY,  "groupby"},
+    {       DC_JOIN,     "join"},
+    {      DC_SPLIT,    "split"}
 })
 
 
+enum NodeState : short {
+    DC_NODE_STARTED,
+    DC_NODE_PROGRESS,
+    DC_NODE_FINISHED,
+    DC_NODE_FAILED
+};
+
+static std::map<short, std::string> NodeStateNameByType = {
+    { DC_NODE_STARTED,  "started"},
+    {DC_NODE_PROGRESS, "progress"},
+    {DC_NODE_FINISHED, "finished"},
+    {  DC_NODE_FAILED,   "failed"}
+};
+
+
+// Status record sent from a running node to whoever is observing the execution. Fixed size so
+// that a record written to a pipe by a node process always arrives in one piece.
+struct NodeEvent
+{
+    NodeState state;
+    char node[64];
+    uint64_t tokens_in;
+    uint64_t tokens_out;
+};
+
+#ifndef _WIN32
+static_assert (sizeof (NodeEvent) <= PIPE_BUF, "NodeEvent must fit in an atomic pipe write.");
+#endif
+
+// writes up to this size reach a FIFO reader in one piece; see Node::WriteBlock.
+#ifdef PIPE_BUF
+static constexpr size_t DAISY_BLOCK_SIZE = PIPE_BUF;
+#else
+static constexpr size_t DAISY_BLOCK_SIZE = 4096;
+#endif
+
+
 #ifdef _WIN32
 struct NodeThreadContext
 {
@@ -78,6 +147,7 @@ struct NodeThreadContext
     std::condition_variable sync_cv_;
     std::condition_variable close_cv_;
     std::atomic<int> nodecount{0};
+    std::atomic<int> nodes_failed{0};
     std::map<std::string, bool> nodes_ready;
 };
 #endif
@@ -110,13 +180,23 @@ public:
 
     virtual void Stats();
 
+    void Report (NodeState state);
+
+    virtual void Cancel() { cancelled_.store (true); }
+
+    [[nodiscard]] bool cancelled() const { return cancelled_.load(); }
+
     void AddInput (const string&);
 
     void RemoveInput (const string&);
 
     void AddOutput (const string& fifo) { outputs_.push_back (fifo); }
 
-    void RemoveOutput (const string& fifo) { outputs_.remove (fifo); }
+    void RemoveOutput (const string& fifo) { std::erase (outputs_, fifo); }
+
+    const vector<string>& inputs() const { return inputs_; }
+
+    const vector<string>& outputs() const { return outputs_; }
 
     void OpenInputs (const string&);
 
@@ -134,6 +214,19 @@ public:
 
     virtual void WriteOutputs (const std::string&);
 
+    // writes to the given ports (indices into outputs()) only, once per distinct FIFO.
+    void WriteSelectedOutputs (const std::string&, const vector<size_t>& ports);
+
+    // writes a block of newline-terminated tokens to all outputs as it is. Blocks up to
+    // PIPE_BUF bytes reach a reader in one piece.
+    void WriteBlock (std::string_view block, size_t tokens);
+
+    // packs tokens into blocks for WriteBlock.
+    void WriteTokens (const vector<string>& tokens);
+
+    // writes a block like WriteBlock, to the FIFO of one port (an index into outputs()) only.
+    void WritePortBlock (std::string_view block, size_t tokens, size_t port);
+
     virtual void Cleanup();
 
     virtual void Reset();
@@ -155,15 +248,36 @@ public:
 
     [[nodiscard]] bool is_root() const { return isroot_; }
 
+    // variables the node runs with unless the run's environment sets them, e.g. the environment
+    // of the subgraph file it was inlined from.
+    void set_environment_defaults (const json& defaults) { defaults_ = defaults; }
+    [[nodiscard]] const json& environment_defaults() const { return defaults_; }
+
+    // the run's environment over the node's defaults.
+    [[nodiscard]] json environment (const json& env) const;
+
     void set_batch_flag (const bool batch) { batch_ = batch; }
     [[nodiscard]] bool batch_flag() const { return batch_; }
 
+    // bytes of tokens a batch holds in memory before it spills sorted runs to the sandbox.
+    void set_batch_memory (size_t bytes) { batch_memory_ = bytes; }
+    [[nodiscard]] size_t batch_memory() const { return batch_memory_; }
+
+    // the sorted list of the batch being processed, one token per line; empty outside batch mode.
+    [[nodiscard]] const string& batchfile() const { return batchfile_; }
+
     void set_test_flag (const bool test) { test_ = test; }
     [[nodiscard]] bool test_flag() const { return test_; }
 
     void set_outputfile (const string& output) { outputfile_ = output; }
     string outputfile() { return outputfile_; }
 
+    void set_event_fd (int fd) { event_fd_ = fd; }
+    [[nodiscard]] int event_fd() const { return event_fd_; }
+
+    [[nodiscard]] size_t tokens_read() const { return tokensread_; }
+    [[nodiscard]] size_t tokens_written() const { return tokenswritten_; }
+
     void set_threadname (const string& threadname) {
         threadname_ = threadname;
         el::Helpers::setThreadName (threadname_);
@@ -181,6 +295,7 @@ public:
     }
 #endif
 
+    // joins inputs in memory; batch execution itself goes through BatchSpool.
     static void concat_inputs (vector<string>& inputs)
     {
         // drop EOF and concatenate inputs into a newline-separated string.
@@ -203,13 +318,21 @@ protected:
     std::pair<int, int> size_;
     DaisyNodeType type_;
     bool batch_;
+    size_t batch_memory_;
+    string batchfile_;
     bool test_;
     string outputfile_;
+    json defaults_;
 
     bool isroot_;
-    std::list<string> inputs_;
-    std::list<string> outputs_;
+    // FIFO names per port, in connection order; a port repeats when the same pair of
+    // nodes is connected more than once.
+    vector<string> inputs_;
+    vector<string> outputs_;
     atomic<bool> terminate_;
+    // a cancelled node drops its work but keeps draining inputs until EOF, so that upstream
+    // nodes never block opening a FIFO that has no reader left.
+    atomic<bool> cancelled_;
     string threadname_;
 
 #ifdef _WIN32
@@ -231,12 +354,47 @@ protected:
     std::thread thread_;
     NodeThreadContext* context_{};
 #else
-    map<const string, int> fd_in_;
-    map<const string, int> fd_out_;
+    // one slot per distinct FIFO, kept as ready-made pollfd arrays so the I/O loops poll
+    // them directly. fifo_in_/fifo_out_ hold the matching names.
+    vector<struct pollfd> fd_in_;
+    vector<struct pollfd> fd_out_;
+    vector<string> fifo_in_;
+    vector<string> fifo_out_;
+    // the fd_out_ slot of each output port, -1 if its FIFO could not be opened; built by
+    // OpenOutputs so that writes to a port never look up FIFO names.
+    vector<int> port_out_;
 #endif
 
     int eofs_;
     size_t totalbytesread_;
     size_t totalbyteswritten_;
+    size_t tokensread_;
+    size_t tokenswritten_;
+
+    // progress reporting; -1 when nobody is listening.
+    int event_fd_;
+    std::chrono::steady_clock::time_point reported_;
+
+#ifndef _WIN32
+    // writes block to every fd_out_ slot whose events are set, clearing them as each finishes.
+    void write_armed_ (std::string_view block);
+#endif
+
+    // sorts a collected batch into batchfile_ and hands it to Execute() as the only token;
+    // false if the list could not be written.
+    bool finish_batch_ (BatchSpool& spool, vector<string>& inputs);
+
+    void progress_()
+    {
+        if (event_fd_ < 0) {
+            return;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - reported_ >= std::chrono::milliseconds (250)) {
+            reported_ = now;
+            Report (DC_NODE_PROGRESS);
+        }
+    }
 };
 } // namespace daisychain
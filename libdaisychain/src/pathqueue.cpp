@@ -0,0 +1,157 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "pathqueue.h"
+#include <algorithm>
+#include <climits>
+
+
+namespace daisychain {
+using namespace std;
+
+
+PathQueue::PathQueue (std::chrono::milliseconds quiescence, std::chrono::milliseconds debounce, size_t capacity) :
+    quiescence_ (quiescence),
+    debounce_ (debounce),
+    capacity_ (std::max (capacity, size_t (1)))
+{
+}
+
+
+void
+PathQueue::Push (const string& path, Clock::time_point now)
+{
+    auto it = pending_index_.find (path);
+
+    if (it != pending_index_.end()) {
+        // restart the window and move the path behind the others.
+        it->second->time = now;
+        pending_.splice (pending_.end(), pending_, it->second);
+        ++merged_;
+        return;
+    }
+
+    expire_ (now);
+
+    if (recent_index_.count (path)) {
+        ++merged_;
+        return;
+    }
+
+    if (pending_.size() >= capacity_) {
+        ++dropped_;
+        return;
+    }
+
+    pending_.push_back ({path, now});
+    pending_index_[path] = std::prev (pending_.end());
+} // PathQueue::Push
+
+
+void
+PathQueue::Pop (Clock::time_point now, vector<string>& ready)
+{
+    expire_ (now);
+
+    while (!pending_.empty() && pending_.front().time + quiescence_ <= now) {
+        auto path = std::move (pending_.front().path);
+        pending_index_.erase (path);
+        pending_.pop_front();
+
+        ready.push_back (path);
+        sent_ (std::move (path), now);
+    }
+} // PathQueue::Pop
+
+
+void
+PathQueue::Drain (vector<string>& ready)
+{
+    auto now = Clock::now();
+
+    for (auto& entry : pending_) {
+        ready.push_back (entry.path);
+        sent_ (std::move (entry.path), now);
+    }
+
+    pending_.clear();
+    pending_index_.clear();
+} // PathQueue::Drain
+
+
+void
+PathQueue::Clear()
+{
+    pending_.clear();
+    pending_index_.clear();
+    recent_.clear();
+    recent_index_.clear();
+} // PathQueue::Clear
+
+
+std::optional<PathQueue::Clock::time_point>
+PathQueue::deadline() const
+{
+    if (pending_.empty()) {
+        return std::nullopt;
+    }
+
+    return pending_.front().time + quiescence_;
+} // PathQueue::deadline
+
+
+int
+PathQueue::timeout (Clock::time_point now) const
+{
+    auto next = deadline();
+
+    if (!next) {
+        return -1;
+    }
+
+    if (*next <= now) {
+        return 0;
+    }
+
+    // round up, so the wait does not end just short of the deadline.
+    auto wait = std::chrono::ceil<std::chrono::milliseconds> (*next - now).count();
+
+    return int (std::min<int64_t> (wait, INT_MAX));
+} // PathQueue::timeout
+
+
+void
+PathQueue::expire_ (Clock::time_point now)
+{
+    while (!recent_.empty() && now - recent_.front().time >= debounce_) {
+        recent_index_.erase (recent_.front().path);
+        recent_.pop_front();
+    }
+} // PathQueue::expire_
+
+
+void
+PathQueue::sent_ (string path, Clock::time_point now)
+{
+    if (debounce_.count() <= 0) {
+        return;
+    }
+
+    auto it = recent_index_.find (path);
+
+    if (it != recent_index_.end()) {
+        recent_.erase (it->second);
+        recent_index_.erase (it);
+    }
+
+    if (recent_.size() >= capacity_) {
+        recent_index_.erase (recent_.front().path);
+        recent_.pop_front();
+    }
+
+    recent_.push_back ({std::move (path), now});
+    recent_index_[recent_.back().path] = std::prev (recent_.end());
+} // PathQueue::sent_
+} // namespace daisychain
@@ -0,0 +1,92 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include <chrono>
+#include <list>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace daisychain {
+using namespace std;
+
+
+// Coalesces file events per path before they are sent on. A path is ready once no event has
+// arrived for it for the quiescence window, so a burst of writes becomes one token. A path that
+// was sent less than debounce ago is not queued again.
+//
+// Both tables are bounded: events for new paths are dropped while capacity paths are pending,
+// and the oldest sent paths are forgotten once capacity of them are remembered.
+class PathQueue
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    PathQueue() = default;
+
+    PathQueue (std::chrono::milliseconds quiescence, std::chrono::milliseconds debounce, size_t capacity);
+
+    void Push (const string& path, Clock::time_point now);
+
+    // moves the paths that have been quiet long enough into ready, oldest first.
+    void Pop (Clock::time_point now, vector<string>& ready);
+
+    // moves every pending path into ready, quiet or not.
+    void Drain (vector<string>& ready);
+
+    // forgets pending and sent paths; the counters are kept.
+    void Clear();
+
+    // when the next pending path becomes ready.
+    [[nodiscard]] std::optional<Clock::time_point> deadline() const;
+
+    // milliseconds until deadline(), for poll(); -1 when nothing is pending.
+    [[nodiscard]] int timeout (Clock::time_point now) const;
+
+    [[nodiscard]] size_t size() const { return pending_.size(); }
+
+    [[nodiscard]] bool empty() const { return pending_.empty(); }
+
+    // events folded into a pending or recently sent path.
+    [[nodiscard]] uint64_t merged() const { return merged_; }
+
+    // events lost to a full queue, or reported lost by the caller.
+    [[nodiscard]] uint64_t dropped() const { return dropped_; }
+
+    void add_dropped (uint64_t count) { dropped_ += count; }
+
+private:
+    struct Entry
+    {
+        string path;
+        Clock::time_point time;
+    };
+
+    using List = std::list<Entry>;
+
+    void expire_ (Clock::time_point now);
+
+    void sent_ (string path, Clock::time_point now);
+
+    std::chrono::milliseconds quiescence_{200};
+    std::chrono::milliseconds debounce_{2000};
+    size_t capacity_ = 65536;
+
+    // ordered by last event; the front is the next to become ready.
+    List pending_;
+    std::unordered_map<string, List::iterator> pending_index_;
+
+    // ordered by send time; the front expires first.
+    List recent_;
+    std::unordered_map<string, List::iterator> recent_index_;
+
+    uint64_t merged_ = 0;
+    uint64_t dropped_ = 0;
+};
+} // namespace daisychain
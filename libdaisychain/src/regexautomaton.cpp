@@ -0,0 +1,686 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "regexautomaton.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+
+namespace daisychain {
+using namespace std;
+
+
+namespace {
+// NFA states a single pattern may expand to, counted repetitions included.
+constexpr size_t MAX_PATTERN_STATES = 10000;
+// DFA states kept before the cache is dropped and rebuilt on demand.
+constexpr size_t MAX_DFA_STATES = 4096;
+constexpr int MAX_REPEAT = 1000;
+constexpr int MAX_DEPTH = 256;
+} // namespace
+
+
+// Recursive descent over the supported subset. Anything else makes Parse() return false; it
+// is never an error here, std::regex gets the final say on such patterns.
+class RegexAutomaton::Parser
+{
+public:
+    Parser (std::string_view pattern, vector<Ast>& ast, vector<ByteSet>& sets) :
+        pattern_ (pattern),
+        ast_ (ast),
+        sets_ (sets)
+    {
+    }
+
+    bool Parse (int& root)
+    {
+        // with full-match semantics, ^ and $ at the very ends are no-ops.
+        if (!pattern_.empty() && pattern_.front() == '^') {
+            pattern_.remove_prefix (1);
+        }
+
+        if (!pattern_.empty() && pattern_.back() == '$') {
+            size_t backslashes = 0;
+            for (auto it = pattern_.rbegin() + 1; it != pattern_.rend() && *it == '\\'; ++it) {
+                ++backslashes;
+            }
+            if (backslashes % 2 == 0) {
+                pattern_.remove_suffix (1);
+            }
+        }
+
+        return alternation_ (root) && pos_ == pattern_.size();
+    }
+
+private:
+    [[nodiscard]] bool end_() const { return pos_ >= pattern_.size(); }
+
+    [[nodiscard]] char peek_ (size_t ahead = 0) const
+    {
+        return pos_ + ahead < pattern_.size() ? pattern_[pos_ + ahead] : '\0';
+    }
+
+    int node_ (Ast::Kind kind, int set = -1)
+    {
+        ast_.push_back ({kind, set, {}, 0, 0});
+        return int (ast_.size() - 1);
+    }
+
+    int set_ (const ByteSet& set)
+    {
+        sets_.push_back (set);
+        return node_ (Ast::SET, int (sets_.size() - 1));
+    }
+
+    bool alternation_ (int& node)
+    {
+        if (++depth_ > MAX_DEPTH) {
+            return false;
+        }
+
+        int branch;
+        if (!concatenation_ (branch)) {
+            return false;
+        }
+
+        if (peek_() == '|') {
+            node = node_ (Ast::ALT);
+            ast_[node].children.push_back (branch);
+
+            while (peek_() == '|') {
+                ++pos_;
+                if (!concatenation_ (branch)) {
+                    return false;
+                }
+                ast_[node].children.push_back (branch);
+            }
+        }
+        else {
+            node = branch;
+        }
+
+        --depth_;
+        return true;
+    }
+
+    bool concatenation_ (int& node)
+    {
+        node = node_ (Ast::CONCAT);
+
+        while (!end_() && peek_() != '|' && peek_() != ')') {
+            int atom;
+            if (!atom_ (atom) || !quantifier_ (atom)) {
+                return false;
+            }
+            ast_[node].children.push_back (atom);
+        }
+
+        return true;
+    }
+
+    bool atom_ (int& node)
+    {
+        char c = pattern_[pos_++];
+
+        switch (c) {
+            case '(':
+                if (peek_() == '?') {
+                    if (peek_ (1) != ':') {
+                        return false;
+                    }
+                    pos_ += 2;
+                }
+                if (!alternation_ (node) || peek_() != ')') {
+                    return false;
+                }
+                ++pos_;
+                return true;
+            case '[':
+                return class_ (node);
+            case '.': {
+                ByteSet set;
+                set.set();
+                set.reset ('\n');
+                set.reset ('\r');
+                node = set_ (set);
+                return true;
+            }
+            case '\\': {
+                ByteSet set;
+                bool single;
+                if (!escape_ (set, single, false)) {
+                    return false;
+                }
+                node = set_ (set);
+                return true;
+            }
+            case '^':
+            case '$':
+            case '*':
+            case '+':
+            case '?':
+            case '{':
+            case '}':
+            case ']':
+                return false;
+            default: {
+                ByteSet set;
+                set.set (static_cast<unsigned char> (c));
+                node = set_ (set);
+                return true;
+            }
+        }
+    }
+
+    bool quantifier_ (int& node)
+    {
+        int min;
+        int max;
+
+        switch (peek_()) {
+            case '*': min = 0; max = -1; ++pos_; break;
+            case '+': min = 1; max = -1; ++pos_; break;
+            case '?': min = 0; max = 1; ++pos_; break;
+            case '{':
+                ++pos_;
+                if (!number_ (min)) {
+                    return false;
+                }
+                max = min;
+                if (peek_() == ',') {
+                    ++pos_;
+                    max = -1;
+                    if (peek_() != '}' && (!number_ (max) || max < min)) {
+                        return false;
+                    }
+                }
+                if (peek_() != '}') {
+                    return false;
+                }
+                ++pos_;
+                break;
+            default:
+                return true;
+        }
+
+        // lazy quantifiers accept the same strings under full-match semantics.
+        if (peek_() == '?') {
+            ++pos_;
+        }
+
+        if (std::strchr ("*+?{", peek_()) != nullptr && peek_() != '\0') {
+            return false;
+        }
+
+        int repeat = node_ (Ast::REPEAT);
+        ast_[repeat].children.push_back (node);
+        ast_[repeat].min = min;
+        ast_[repeat].max = max;
+        node = repeat;
+
+        return true;
+    }
+
+    bool number_ (int& value)
+    {
+        if (!std::isdigit (static_cast<unsigned char> (peek_()))) {
+            return false;
+        }
+
+        value = 0;
+        while (std::isdigit (static_cast<unsigned char> (peek_()))) {
+            value = value * 10 + (peek_() - '0');
+            ++pos_;
+            if (value > MAX_REPEAT) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool class_ (int& node)
+    {
+        ByteSet set;
+        bool negate = false;
+
+        if (peek_() == '^') {
+            negate = true;
+            ++pos_;
+        }
+
+        // [] and [^] are legal ECMAScript but rare enough to leave to std::regex.
+        if (peek_() == ']') {
+            return false;
+        }
+
+        while (peek_() != ']') {
+            ByteSet item;
+            bool single;
+
+            if (!class_item_ (item, single)) {
+                return false;
+            }
+
+            if (peek_() == '-' && peek_ (1) != ']' && peek_ (1) != '\0') {
+                // a class escape cannot start a range.
+                if (!single) {
+                    return false;
+                }
+
+                ++pos_;
+                ByteSet last;
+                bool last_single;
+
+                if (!class_item_ (last, last_single) || !last_single) {
+                    return false;
+                }
+
+                auto lo = first_ (item);
+                auto hi = first_ (last);
+                if (lo > hi) {
+                    return false;
+                }
+                for (auto c = lo; c <= hi; ++c) {
+                    item.set (c);
+                }
+            }
+
+            set |= item;
+        }
+
+        ++pos_;
+
+        if (negate) {
+            set.flip();
+        }
+
+        node = set_ (set);
+        return true;
+    }
+
+    bool class_item_ (ByteSet& item, bool& single)
+    {
+        if (end_()) {
+            return false;
+        }
+
+        char c = pattern_[pos_++];
+
+        if (c == '\\') {
+            return escape_ (item, single, true);
+        }
+        if (c == '[') {
+            return false;
+        }
+
+        item.set (static_cast<unsigned char> (c));
+        single = true;
+        return true;
+    }
+
+    bool escape_ (ByteSet& set, bool& single, bool in_class)
+    {
+        if (end_()) {
+            return false;
+        }
+
+        char c = pattern_[pos_++];
+        single = false;
+
+        ByteSet digits;
+        for (char d = '0'; d <= '9'; ++d) {
+            digits.set (static_cast<unsigned char> (d));
+        }
+
+        ByteSet word = digits;
+        for (char l = 'a'; l <= 'z'; ++l) {
+            word.set (static_cast<unsigned char> (l));
+            word.set (static_cast<unsigned char> (l - 'a' + 'A'));
+        }
+        word.set ('_');
+
+        ByteSet space;
+        for (char s : {' ', '\t', '\n', '\v', '\f', '\r'}) {
+            space.set (static_cast<unsigned char> (s));
+        }
+
+        switch (c) {
+            case 'd': set = digits; return true;
+            case 'D': set = ~digits; return true;
+            case 'w': set = word; return true;
+            case 'W': set = ~word; return true;
+            case 's': set = space; return true;
+            case 'S': set = ~space; return true;
+            case 't': c = '\t'; break;
+            case 'n': c = '\n'; break;
+            case 'r': c = '\r'; break;
+            case 'f': c = '\f'; break;
+            case 'v': c = '\v'; break;
+            default:
+                if (c == '\0' || (std::strchr ("^$\\.*+?()[]{}|/", c) == nullptr && !(in_class && c == '-'))) {
+                    return false;
+                }
+                break;
+        }
+
+        set.reset();
+        set.set (static_cast<unsigned char> (c));
+        single = true;
+
+        return true;
+    }
+
+    static unsigned int first_ (const ByteSet& set)
+    {
+        for (unsigned int c = 0; c < 256; ++c) {
+            if (set.test (c)) {
+                return c;
+            }
+        }
+        return 0;
+    }
+
+    std::string_view pattern_;
+    size_t pos_ = 0;
+    int depth_ = 0;
+    vector<Ast>& ast_;
+    vector<ByteSet>& sets_;
+};
+
+
+bool
+RegexAutomaton::Add (const string& pattern, size_t index)
+{
+    auto states = states_.size();
+    auto sets = sets_.size();
+
+    vector<Ast> ast;
+    int root;
+    Fragment fragment;
+    Parser parser (pattern, ast, sets_);
+
+    if (!parser.Parse (root) || !compile_ (ast, root, fragment, states + MAX_PATTERN_STATES)) {
+        states_.resize (states);
+        sets_.resize (sets);
+        return false;
+    }
+
+    int match = state_ (State::MATCH);
+    states_[match].pattern = index;
+    patch_ (fragment.holes, match);
+    starts_.push_back (fragment.start);
+
+    flush_();
+
+    return true;
+} // RegexAutomaton::Add
+
+
+void
+RegexAutomaton::Clear()
+{
+    states_.clear();
+    sets_.clear();
+    starts_.clear();
+    flush_();
+} // RegexAutomaton::Clear
+
+
+void
+RegexAutomaton::Match (std::string_view token, vector<size_t>& matches) const
+{
+    if (starts_.empty()) {
+        return;
+    }
+
+    int dstate = start_();
+
+    for (auto c : token) {
+        // no NFA state left to advance: the rest of the token cannot match.
+        if (dstates_[dstate].nfa.empty()) {
+            return;
+        }
+
+        auto byte = static_cast<unsigned char> (c);
+        int next = transitions_[size_t (dstate) * 256 + byte];
+
+        dstate = next >= 0 ? next : step_ (dstate, byte);
+    }
+
+    const auto& accepts = dstates_[dstate].accepts;
+    matches.insert (matches.end(), accepts.begin(), accepts.end());
+} // RegexAutomaton::Match
+
+
+int
+RegexAutomaton::state_ (State::Kind kind, int set)
+{
+    states_.push_back ({kind, set, -1, -1, 0});
+    return int (states_.size() - 1);
+} // RegexAutomaton::state_
+
+
+void
+RegexAutomaton::patch_ (const vector<pair<int, int>>& holes, int target)
+{
+    for (const auto& [state, which] : holes) {
+        (which == 0 ? states_[state].out : states_[state].out1) = target;
+    }
+} // RegexAutomaton::patch_
+
+
+bool
+RegexAutomaton::compile_ (const vector<Ast>& ast, int node, Fragment& fragment, size_t limit)
+{
+    if (states_.size() > limit) {
+        return false;
+    }
+
+    // joins b after a; a may be empty (start -1).
+    auto append = [this] (Fragment& a, Fragment& b) {
+        if (a.start == -1) {
+            a = std::move (b);
+            return;
+        }
+        patch_ (a.holes, b.start);
+        a.holes = std::move (b.holes);
+    };
+
+    const auto& entry = ast[size_t (node)];
+
+    switch (entry.kind) {
+        case Ast::SET: {
+            int s = state_ (State::SET, entry.set);
+            fragment = {s, {{s, 0}}};
+            return true;
+        }
+        case Ast::CONCAT: {
+            fragment = {-1, {}};
+            for (auto child : entry.children) {
+                Fragment next;
+                if (!compile_ (ast, child, next, limit)) {
+                    return false;
+                }
+                append (fragment, next);
+            }
+            break;
+        }
+        case Ast::ALT: {
+            vector<Fragment> branches (entry.children.size());
+            for (size_t i = 0; i < branches.size(); ++i) {
+                if (!compile_ (ast, entry.children[i], branches[i], limit)) {
+                    return false;
+                }
+            }
+
+            int start = branches.back().start;
+            for (auto i = branches.size() - 1; i-- > 0;) {
+                int split = state_ (State::SPLIT);
+                states_[split].out = branches[i].start;
+                states_[split].out1 = start;
+                start = split;
+            }
+
+            fragment = {start, {}};
+            for (auto& branch : branches) {
+                fragment.holes.insert (fragment.holes.end(), branch.holes.begin(), branch.holes.end());
+            }
+            return true;
+        }
+        case Ast::REPEAT: {
+            fragment = {-1, {}};
+            int child = entry.children.front();
+
+            for (int i = 0; i < entry.min; ++i) {
+                Fragment next;
+                if (!compile_ (ast, child, next, limit)) {
+                    return false;
+                }
+                append (fragment, next);
+            }
+
+            auto optional = entry.max == -1 ? 1 : entry.max - entry.min;
+
+            for (int i = 0; i < optional; ++i) {
+                Fragment body;
+                if (!compile_ (ast, child, body, limit)) {
+                    return false;
+                }
+
+                int split = state_ (State::SPLIT);
+                states_[split].out = body.start;
+
+                Fragment next{split, {{split, 1}}};
+                if (entry.max == -1) {
+                    patch_ (body.holes, split);
+                }
+                else {
+                    next.holes.insert (next.holes.end(), body.holes.begin(), body.holes.end());
+                }
+                append (fragment, next);
+            }
+            break;
+        }
+    }
+
+    if (fragment.start == -1) {
+        int s = state_ (State::EPSILON);
+        fragment = {s, {{s, 0}}};
+    }
+
+    return true;
+} // RegexAutomaton::compile_
+
+
+int
+RegexAutomaton::start_() const
+{
+    if (dstart_ < 0) {
+        auto seeds = starts_;
+        dstart_ = intern_ (seeds);
+    }
+
+    return dstart_;
+} // RegexAutomaton::start_
+
+
+int
+RegexAutomaton::step_ (int dstate, unsigned char c) const
+{
+    vector<int> seeds;
+
+    for (auto s : dstates_[size_t (dstate)].nfa) {
+        if (sets_[size_t (states_[size_t (s)].set)].test (c)) {
+            seeds.push_back (states_[size_t (s)].out);
+        }
+    }
+
+    if (dstates_.size() >= MAX_DFA_STATES) {
+        flush_();
+        return intern_ (seeds);
+    }
+
+    int next = intern_ (seeds);
+    transitions_[size_t (dstate) * 256 + c] = next;
+
+    return next;
+} // RegexAutomaton::step_
+
+
+int
+RegexAutomaton::intern_ (vector<int>& seeds) const
+{
+    if (marks_.size() < states_.size()) {
+        marks_.resize (states_.size(), 0);
+    }
+    if (++generation_ == 0) {
+        std::fill (marks_.begin(), marks_.end(), 0);
+        generation_ = 1;
+    }
+
+    // epsilon closure; the key also holds the MATCH states reached.
+    DState dstate;
+    vector<int> key;
+
+    while (!seeds.empty()) {
+        auto s = seeds.back();
+        seeds.pop_back();
+
+        if (s < 0 || marks_[size_t (s)] == generation_) {
+            continue;
+        }
+        marks_[size_t (s)] = generation_;
+
+        const auto& state = states_[size_t (s)];
+
+        switch (state.kind) {
+            case State::SET:
+                dstate.nfa.push_back (s);
+                key.push_back (s);
+                break;
+            case State::SPLIT:
+                seeds.push_back (state.out1);
+                seeds.push_back (state.out);
+                break;
+            case State::EPSILON:
+                seeds.push_back (state.out);
+                break;
+            case State::MATCH:
+                dstate.accepts.push_back (state.pattern);
+                key.push_back (s);
+                break;
+        }
+    }
+
+    std::sort (key.begin(), key.end());
+
+    auto it = dindex_.find (key);
+    if (it != dindex_.end()) {
+        return it->second;
+    }
+
+    std::sort (dstate.nfa.begin(), dstate.nfa.end());
+    std::sort (dstate.accepts.begin(), dstate.accepts.end());
+
+    auto id = int (dstates_.size());
+    dstates_.push_back (std::move (dstate));
+    dindex_.emplace (std::move (key), id);
+    transitions_.resize (transitions_.size() + 256, -1);
+
+    return id;
+} // RegexAutomaton::intern_
+
+
+void
+RegexAutomaton::flush_() const
+{
+    dstates_.clear();
+    dindex_.clear();
+    transitions_.clear();
+    dstart_ = -1;
+} // RegexAutomaton::flush_
+} // namespace daisychain
@@ -0,0 +1,104 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace daisychain {
+using namespace std;
+
+
+// Linear-time matcher for the common subset of ECMAScript regular expressions: literals,
+// `.`, classes, \d \w \s, groups, alternation, * + ? and {m,n}, with ^ and $ at the ends.
+// Patterns are compiled into one Thompson NFA and run through a DFA that is built lazily, one
+// state per distinct set of NFA states, so every token is examined once per byte for all
+// patterns together. Add() refuses anything outside the subset (backreferences, lookaround,
+// word boundaries, ...) so the caller can fall back to std::regex.
+//
+// Matching uses the same full-match semantics as std::regex_match.
+class RegexAutomaton
+{
+public:
+    RegexAutomaton() = default;
+
+    // false when the pattern is not supported; the automaton is left unchanged.
+    bool Add (const string& pattern, size_t index);
+
+    void Clear();
+
+    // appends the indices of all matching patterns, in the order they were added.
+    void Match (std::string_view token, vector<size_t>& matches) const;
+
+    [[nodiscard]] bool empty() const { return starts_.empty(); }
+
+private:
+    using ByteSet = std::bitset<256>;
+
+    struct State
+    {
+        enum Kind : uint8_t { SET, SPLIT, EPSILON, MATCH } kind;
+        int set = -1;
+        int out = -1;
+        int out1 = -1;
+        size_t pattern = 0;
+    };
+
+    struct Ast
+    {
+        enum Kind : uint8_t { SET, CONCAT, ALT, REPEAT } kind;
+        int set = -1;
+        vector<int> children;
+        int min = 0;
+        int max = 0;
+    };
+
+    struct Fragment
+    {
+        int start;
+        vector<pair<int, int>> holes;
+    };
+
+    struct DState
+    {
+        vector<int> nfa;
+        vector<size_t> accepts;
+    };
+
+    class Parser;
+
+    int state_ (State::Kind kind, int set = -1);
+
+    void patch_ (const vector<pair<int, int>>& holes, int target);
+
+    bool compile_ (const vector<Ast>& ast, int node, Fragment& fragment, size_t limit);
+
+    int start_() const;
+
+    int step_ (int dstate, unsigned char c) const;
+
+    int intern_ (vector<int>& seeds) const;
+
+    void flush_() const;
+
+    vector<State> states_;
+    vector<ByteSet> sets_;
+    vector<int> starts_;
+
+    // lazily built DFA; flushed when it grows past a bound.
+    mutable vector<DState> dstates_;
+    mutable std::map<vector<int>, int> dindex_;
+    mutable vector<int> transitions_;
+    mutable int dstart_ = -1;
+    mutable vector<uint32_t> marks_;
+    mutable uint32_t generation_ = 0;
+};
+} // namespace daisychain
@@ -4,32 +4,409 @@
 // See LICENSE file for full license text.
 
 #include "remotenode.h"
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+#ifndef _WIN32
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
 
 
 namespace daisychain {
 using namespace std;
 
 
-RemoteNode::RemoteNode()
+RemoteNode::RemoteNode() :
+    window_ (8)
 {
     type_ = DaisyNodeType::DC_REMOTE;
+    set_name (DaisyNodeNameByType[type_]);
     set_host_id ("");
 }
 
 
+void
+RemoteNode::Initialize (json& keydata, bool keep_uuid)
+{
+    Node::Initialize (keydata, keep_uuid);
+
+    json::iterator jit = keydata.begin();
+    const auto& uuid = jit.key();
+    auto data = keydata[uuid];
+
+    set_host_id (data.count ("host_id") ? data["host_id"] : "");
+    set_command (data.count ("command") ? data["command"] : "");
+    set_outputfile (data.count ("outputfile") ? data["outputfile"] : "");
+
+    if (data.count ("window")) {
+        set_window (data["window"].get<unsigned int>());
+    }
+
+    set_secret_file (data.count ("secret_file") ? data["secret_file"] : "");
+}
+
+
 bool
-RemoteNode::Execute (const string& sandbox)
+RemoteNode::Execute (vector<string>& inputs, const string& sandbox, json& vars)
 {
-    return true;
+    TIMED_SCOPE (timerObj, LOGNODE);
+
+    LINFO << "Executing " << (isroot_ ? "root: " : "node: ") << name_;
+
+#ifdef _WIN32
+    LERROR << LOGNODE << "Remote execution is not supported on Windows.";
+
+    return false;
+#else
+    bool stat = true;
+    bool eof = isroot_;
+    uint64_t seq = 0;
+    std::deque<pair<uint64_t, string>> pending;
+
+    connections_.clear();
+    lost_.clear();
+
+    if (test_) {
+        // tokens pass through without contacting a worker.
+        while (eofs_ <= fd_in_.size() && !terminate_.load()) {
+            vector<string> outputs;
+
+            for (const auto& input : inputs) {
+                if (input != "EOF") {
+                    LTEST << LOGNODE << host_id_ << "\n" << command_ << " " << input;
+                    outputs.push_back (input);
+                }
+            }
+
+            if (!outputs.empty()) {
+                OpenOutputs (sandbox);
+                WriteTokens (outputs);
+                CloseOutputs();
+            }
+
+            inputs.clear();
+
+            if (isroot_ || eofs_ == fd_in_.size()) {
+                break;
+            }
+            ReadInputs (inputs);
+        }
+
+        if (!isroot_) {
+            CloseInputs();
+        }
+
+        OpenOutputs (sandbox);
+        WriteOutputs ("EOF");
+        CloseOutputs();
+        Reset();
+
+        return true;
+    }
+
+    vector<string> addresses;
+    m_split (host_id_, ", ", addresses);
+
+    for (const auto& address : addresses) {
+        Connection connection;
+        connection.address = address;
+
+        if (connect_ (connection, vars)) {
+            connections_.push_back (std::move (connection));
+        }
+    }
+
+    if (connections_.empty()) {
+        LERROR << LOGNODE << "No remote worker available: " << host_id_;
+        stat = false;
+    }
+
+    auto enqueue = [&] (vector<string>& tokens) {
+        for (const auto& token : tokens) {
+            if (token != "EOF") {
+                pending.emplace_back (seq++, token);
+            }
+        }
+        tokens.clear();
+    };
+
+    enqueue (inputs);
+
+    while (!connections_.empty()) {
+        // read on only while the workers could take what is queued, so that a full FIFO holds
+        // upstream back rather than the whole stream piling up here.
+        bool reading = !eof && pending.size() < size_t (window_) * connections_.size();
+
+        if (reading) {
+            ReadInputs (inputs);
+            enqueue (inputs);
+            eof = eofs_ == fd_in_.size();
+        }
+
+        if (cancelled_.load()) {
+            pending.clear();
+        }
+
+        // hand out tokens while a worker has room in its window.
+        for (auto& connection : connections_) {
+            while (connection.fd != -1 && connection.inflight.size() < window_ && !pending.empty()) {
+                auto item = pending.front();
+                pending.pop_front();
+
+                if (!m_send_all (connection.fd, "T " + std::to_string (item.first) + " " + item.second + "\n")) {
+                    pending.push_front (item);
+                    disconnect_ (connection, pending);
+                    break;
+                }
+
+                connection.inflight.push_back (item);
+            }
+        }
+
+        // lost workers leave the pool, but their counts stay for Stats.
+        auto lost = std::stable_partition (connections_.begin(), connections_.end(),
+                                           [] (const Connection& connection) { return connection.fd != -1; });
+        std::move (lost, connections_.end(), std::back_inserter (lost_));
+        connections_.erase (lost, connections_.end());
+
+        bool busy = std::any_of (connections_.begin(), connections_.end(),
+                                 [] (const Connection& connection) { return !connection.inflight.empty(); });
+
+        if (eof && pending.empty() && !busy) {
+            break;
+        }
+
+        // collect results and acknowledgements.
+        vector<struct pollfd> pfds;
+        for (const auto& connection : connections_) {
+            pfds.push_back ({connection.fd, POLLIN, 0});
+        }
+
+        if (poll (pfds.data(), pfds.size(), reading ? 2 : 50) <= 0) {
+            continue;
+        }
+
+        vector<string> results;
+
+        for (size_t i = 0; i < pfds.size(); ++i) {
+            if (!pfds[i].revents) {
+                continue;
+            }
+
+            auto& connection = connections_[i];
+            vector<string> lines;
+
+            if (!m_recv_lines (connection.fd, connection.buffer, lines)) {
+                LWARN << LOGNODE << "Lost worker: " << connection.address;
+                disconnect_ (connection, pending);
+            }
+
+            for (const auto& line : lines) {
+                auto space = line.find (' ', 2);
+
+                if (line.size() < 3 || space == string::npos) {
+                    continue;
+                }
+
+                uint64_t id = 0;
+                auto [ptr, ec] = std::from_chars (line.data() + 2, line.data() + space, id);
+
+                if (ec != std::errc() || ptr != line.data() + space || (line[0] != 'R' && line[0] != 'A')) {
+                    LWARN << LOGNODE << "Malformed reply from worker " << connection.address << ", dropping it.";
+                    disconnect_ (connection, pending);
+                    break;
+                }
+
+                if (line[0] == 'R') {
+                    results.push_back (line.substr (space + 1));
+                }
+                else if (line[0] == 'A') {
+                    std::erase_if (connection.inflight, [id] (const auto& item) { return item.first == id; });
+                    ++connection.completed;
+                    connection.finished = std::chrono::steady_clock::now();
+
+                    if (line.substr (space + 1) != "1") {
+                        LERROR << LOGNODE << "Remote command failed on " << connection.address;
+                        stat = false;
+                    }
+                }
+            }
+        }
+
+        if (!results.empty()) {
+            OpenOutputs (sandbox);
+            for (const auto& result : results) {
+                WriteOutputs (result);
+            }
+            CloseOutputs();
+        }
+    }
+
+    // the loop ends early only when no worker is left, however the last one was lost.
+    if ((!pending.empty() || !eof) && !cancelled_.load()) {
+        LERROR << LOGNODE << "No remote worker left, " << pending.size() << " tokens"
+               << (eof ? "" : " and the rest of the input") << " not processed.";
+        stat = false;
+    }
+
+    for (auto& connection : connections_) {
+        if (connection.fd != -1) {
+            m_send_all (connection.fd, "E\n");
+            close (connection.fd);
+            connection.fd = -1;
+        }
+    }
+
+    if (!isroot_) {
+        // keep draining so upstream nodes can finish when the workers are gone.
+        while (eofs_ < fd_in_.size()) {
+            inputs.clear();
+            ReadInputs (inputs);
+        }
+
+        CloseInputs();
+    }
+
+    OpenOutputs (sandbox);
+    WriteOutputs ("EOF");
+    CloseOutputs();
+    Stats();
+    Reset();
+
+    return stat;
+#endif
 } // RemoteNode::Execute
 
 
+bool
+RemoteNode::connect_ (Connection& connection, json& vars)
+{
+#ifdef _WIN32
+    return false;
+#else
+    auto colon = connection.address.rfind (':');
+    string host = colon == string::npos ? connection.address : connection.address.substr (0, colon);
+    string port = colon == string::npos ? std::to_string (DAISY_WORKER_PORT) : connection.address.substr (colon + 1);
+
+    struct addrinfo hints{};
+    struct addrinfo* results = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo (host.c_str(), port.c_str(), &hints, &results) != 0) {
+        LERROR << LOGNODE << "Cannot resolve worker: " << connection.address;
+        return false;
+    }
+
+    for (auto* info = results; info != nullptr; info = info->ai_next) {
+        int fd = socket (info->ai_family, info->ai_socktype, info->ai_protocol);
+
+        if (fd == -1) {
+            continue;
+        }
+
+        if (connect (fd, info->ai_addr, info->ai_addrlen) == 0) {
+            connection.fd = fd;
+            break;
+        }
+
+        close (fd);
+    }
+
+    freeaddrinfo (results);
+
+    if (connection.fd == -1) {
+        LERROR << LOGNODE << "Cannot connect to worker: " << connection.address;
+        return false;
+    }
+
+    int enable = 1;
+    setsockopt (connection.fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof (enable));
+
+    // the worker runs an ordinary command line node built from this header.
+    json header;
+    header["node"][id_] = {
+        {"type", DC_COMMANDLINE},
+        {"name", name_},
+        {"command", command_},
+        {"batch", false},
+        {"outputfile", outputfile_}
+    };
+    header["env"] = vars;
+    header["secret"] = m_worker_secret (secret_file_);
+
+    LWARN_IF (header["secret"].get<string>().empty()) << LOGNODE << "No worker secret set; the worker will refuse the session.";
+
+    if (!m_send_all (connection.fd, "H " + header.dump() + "\n")) {
+        close (connection.fd);
+        connection.fd = -1;
+        return false;
+    }
+
+    connection.started = std::chrono::steady_clock::now();
+    connection.finished = connection.started;
+    LDEBUG << LOGNODE << "Connected to worker: " << connection.address;
+
+    return true;
+#endif
+} // RemoteNode::connect_
+
+
+void
+RemoteNode::disconnect_ (Connection& connection, std::deque<pair<uint64_t, string>>& pending)
+{
+#ifndef _WIN32
+    if (connection.fd != -1) {
+        close (connection.fd);
+        connection.fd = -1;
+    }
+#endif
+
+    // unacknowledged tokens go back to the queue for the remaining workers.
+    pending.insert (pending.begin(), connection.inflight.begin(), connection.inflight.end());
+    connection.inflight.clear();
+} // RemoteNode::disconnect_
+
+
+void
+RemoteNode::Stats()
+{
+    auto report = [this] (const Connection& connection, const char* note) {
+        auto seconds = std::chrono::duration<double> (connection.finished - connection.started).count();
+
+        LINFO << LOGNODE << "worker " << connection.address << ": " << connection.completed << " tokens, "
+              << (seconds > 0 ? double (connection.completed) / seconds : 0.0) << " tokens/s" << note;
+    };
+
+    for (const auto& connection : connections_) {
+        report (connection, "");
+    }
+
+    for (const auto& connection : lost_) {
+        report (connection, " (lost)");
+    }
+
+    Node::Stats();
+} // RemoteNode::Stats
+
+
 json
 RemoteNode::Serialize()
 {
-    return {
-        {id_, {{"name", name_}, {"type", type_}, {"host_id", host_id_}}}
-    };
+    auto json_ = Node::Serialize();
+    json_[id_]["host_id"] = host_id_;
+    json_[id_]["command"] = command_;
+    json_[id_]["outputfile"] = outputfile_;
+    json_[id_]["window"] = window_;
+
+    if (!secret_file_.empty()) {json_[id_]["secret_file"] = secret_file_;}
+
+    if (size_ != std::pair<int, int>(0,0)) {json_[id_]["size"] = size_;}
+
+    return json_;
 } // RemoteNode::Serialize
 
 
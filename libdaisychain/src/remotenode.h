@@ -5,24 +5,77 @@
 
 #pragma once
 
+#include <chrono>
+#include <deque>
 #include "node.h"
+#include "worker.h"
 
 
 namespace daisychain {
-class RemoteNode : public Node
+// Runs a command line on one or more `daisy --worker` agents instead of locally. host_id is a
+// comma separated list of host:port pairs; tokens are spread over the workers with at most
+// `window` tokens in flight per worker, and results come back as this node's outputs. Workers
+// only take connections that present their shared secret: the contents of secret_file when it
+// is set, else what m_worker_secret finds in the environment. In test mode no worker is
+// contacted; the command is logged and tokens pass through.
+//
+// Wire protocol, one line per message:
+//   client -> worker   H <json header>, T <seq> <token>, E
+//   worker -> client   R <seq> <output token>, A <seq> <0|1>
+class RemoteNode final : public Node
 {
 public:
     RemoteNode();
 
-    bool Execute (const string& sandbox);
+    void Initialize (json&, bool) override;
+
+    bool Execute (vector<string>& inputs, const string& sandbox, json& vars) override;
 
     json Serialize() override;
 
+    void Stats() override;
+
     void set_host_id (const string& host_id);
 
     string host_id();
 
+    void set_command (const string& cmd) { command_ = cmd; }
+
+    string command() { return command_; }
+
+    void set_window (unsigned int window) { window_ = window ? window : 1; }
+
+    [[nodiscard]] unsigned int window() const { return window_; }
+
+    void set_secret_file (const string& file) { secret_file_ = file; }
+
+    string secret_file() { return secret_file_; }
+
 private:
+    // not exposed
+    using Node::set_batch_flag;
+
+    struct Connection
+    {
+        string address;
+        int fd = -1;
+        string buffer;
+        std::deque<pair<uint64_t, string>> inflight;
+        size_t completed = 0;
+        std::chrono::steady_clock::time_point started;
+        std::chrono::steady_clock::time_point finished;
+    };
+
+    bool connect_ (Connection& connection, json& vars);
+
+    void disconnect_ (Connection& connection, std::deque<pair<uint64_t, string>>& pending);
+
     string host_id_;
+    string command_;
+    unsigned int window_;
+    string secret_file_;
+    vector<Connection> connections_;
+    // workers lost during the run, kept for Stats.
+    vector<Connection> lost_;
 };
 } // namespace daisychain
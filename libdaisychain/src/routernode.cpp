@@ -0,0 +1,264 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "routernode.h"
+
+
+namespace daisychain {
+using namespace std;
+
+
+RouterNode::RouterNode() :
+    match_all_ (false),
+    default_port_ (-1)
+{
+    type_ = DaisyNodeType::DC_ROUTER;
+    set_name (DaisyNodeNameByType[type_]);
+}
+
+
+void
+RouterNode::Initialize (json& keydata, bool keep_uuid)
+{
+    Node::Initialize (keydata, keep_uuid);
+
+    json::iterator jit = keydata.begin();
+    const auto& uuid = jit.key();
+    auto data = keydata[uuid];
+
+    rules_.clear();
+
+    if (data.count ("rules")) {
+        for (const auto& rule : data["rules"]) {
+            AddRule (rule["pattern"],
+                     rule.count ("regex") && rule["regex"].get<bool>(),
+                     rule.count ("port") ? rule["port"].get<unsigned int>() : 0);
+        }
+    }
+
+    set_match_all (data.count ("match_all") && data["match_all"].get<bool>());
+    set_default_port (data.count ("default_port") ? data["default_port"].get<int>() : -1);
+}
+
+
+bool
+RouterNode::Execute (vector<string>& inputs, const string& sandbox, json& vars)
+{
+    LINFO << "Executing " << (isroot_ ? "root: " : "node: ") << name_;
+
+    matcher_.Clear();
+
+    try {
+        for (const auto& rule : rules_) {
+            matcher_.Add (rule.pattern, rule.regex);
+        }
+    }
+    catch (const std::regex_error& e) {
+        LERROR << "regex_error caught: " << e.what();
+        OpenOutputs (sandbox);
+        WriteOutputs ("EOF");
+        CloseOutputs();
+
+        return false;
+    }
+
+    for (const auto& rule : rules_) {
+        LWARN_IF (rule.port >= outputs_.size()) << LOGNODE << "Rule " << rule.pattern
+                                                << " routes to unconnected port " << rule.port;
+    }
+
+    // a token goes out once per FIFO, however many of its ports share one.
+    targets_.clear();
+    for (size_t port = 0; port < outputs_.size(); ++port) {
+        auto first = std::find (outputs_.begin(), outputs_.end(), outputs_[port]);
+        targets_.push_back (size_t (first - outputs_.begin()));
+    }
+
+    blocks_.assign (outputs_.size(), string());
+    counts_.assign (outputs_.size(), 0);
+
+    if (isroot_) {
+        OpenOutputs (sandbox);
+        for (auto& input : inputs) {
+            if (input != "EOF") {
+                route_ (input);
+            }
+        }
+        flush_();
+        CloseOutputs();
+    }
+    else {
+        while (eofs_ <= fd_in_.size() && !terminate_.load()) {
+            OpenOutputs (sandbox);
+            for (auto& input : inputs) {
+                if (input != "EOF") {
+                    route_ (input);
+                }
+            }
+            flush_();
+            CloseOutputs();
+
+            inputs.clear();
+
+            if (eofs_ == fd_in_.size()) {
+                break;
+            }
+            ReadInputs (inputs);
+        }
+        CloseInputs();
+    }
+
+    // all processing is done for this node. Send EOF downstream.
+    OpenOutputs (sandbox);
+    WriteOutputs ("EOF");
+    CloseOutputs();
+    Stats();
+    Reset();
+
+    return true;
+} // RouterNode::Execute
+
+
+void
+RouterNode::route_ (const string& input)
+{
+    ports_.clear();
+
+    string path;
+    matcher_.Match (token_path (input, path), matches_);
+
+    if (matches_.empty()) {
+        if (default_port_ >= 0) {
+            ports_.push_back (size_t (default_port_));
+        }
+    }
+    else if (match_all_) {
+        for (auto index : matches_) {
+            ports_.push_back (rules_[index].port);
+        }
+    }
+    else {
+        ports_.push_back (rules_[matches_.front()].port);
+    }
+
+    // ports_ becomes the distinct targets, the block for each being where input goes.
+    for (auto& port : ports_) {
+        port = port < targets_.size() ? targets_[port] : targets_.size();
+    }
+
+    std::sort (ports_.begin(), ports_.end());
+    ports_.erase (std::unique (ports_.begin(), ports_.end()), ports_.end());
+
+    if (!ports_.empty() && ports_.back() == targets_.size()) {
+        ports_.pop_back();
+    }
+
+    if (ports_.empty()) {
+        LDEBUG << "No Match." << input;
+        return;
+    }
+
+    LDEBUG << "Routed: " << input;
+
+    for (size_t i = 0; i < ports_.size(); ++i) {
+        auto port = ports_[i];
+        auto& block = blocks_[port];
+
+        if (!block.empty() && block.size() + input.size() + 1 > DAISY_BLOCK_SIZE) {
+            WritePortBlock (block, counts_[port], port);
+            block.clear();
+            counts_[port] = 0;
+        }
+
+        block += input;
+        block += '\n';
+
+        // a token sent to several ports counts once.
+        counts_[port] += i == 0;
+    }
+} // RouterNode::route_
+
+
+void
+RouterNode::flush_()
+{
+    for (size_t port = 0; port < blocks_.size(); ++port) {
+        if (!blocks_[port].empty()) {
+            WritePortBlock (blocks_[port], counts_[port], port);
+            blocks_[port].clear();
+            counts_[port] = 0;
+        }
+    }
+} // RouterNode::flush_
+
+
+json
+RouterNode::Serialize()
+{
+    auto json_ = Node::Serialize();
+    json rules = json::array();
+
+    for (const auto& rule : rules_) {
+        rules.push_back ({{"pattern", rule.pattern}, {"regex", rule.regex}, {"port", rule.port}});
+    }
+
+    json_[id_]["rules"] = rules;
+    json_[id_]["match_all"] = match_all_;
+    json_[id_]["default_port"] = default_port_;
+
+    if (size_ != std::pair<int, int>(0,0)) {json_[id_]["size"] = size_;}
+
+    return json_;
+} // RouterNode::Serialize
+
+
+void
+RouterNode::AddRule (const string& pattern, bool is_regex, unsigned int port)
+{
+    rules_.push_back ({pattern, is_regex, port});
+} // RouterNode::AddRule
+
+
+void
+RouterNode::set_rules (const vector<RouterRule>& rules)
+{
+    rules_ = rules;
+} // RouterNode::set_rules
+
+
+vector<RouterRule>
+RouterNode::rules() const
+{
+    return rules_;
+} // RouterNode::rules
+
+
+void
+RouterNode::set_match_all (bool match_all)
+{
+    match_all_ = match_all;
+} // RouterNode::set_match_all
+
+
+bool
+RouterNode::match_all() const
+{
+    return match_all_;
+} // RouterNode::match_all
+
+
+void
+RouterNode::set_default_port (int port)
+{
+    default_port_ = port;
+} // RouterNode::set_default_port
+
+
+int
+RouterNode::default_port() const
+{
+    return default_port_;
+} // RouterNode::default_port
+} // namespace daisychain
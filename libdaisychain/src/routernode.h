@@ -0,0 +1,76 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include "matcher.h"
+#include "node.h"
+
+
+namespace daisychain {
+struct RouterRule
+{
+    string pattern;
+    bool regex = false;
+    // index into the node's outputs, in connection order.
+    unsigned int port = 0;
+};
+
+
+// Sends each token to the output port of the first matching rule, or to the ports of every
+// matching rule with match_all. All patterns go through one Matcher, so a single router
+// replaces a fan of FilterNodes that would each read the whole stream. Tokens that match no
+// rule go to default_port, or are dropped when it is -1.
+class RouterNode final : public Node
+{
+public:
+    RouterNode();
+
+    void Initialize (json&, bool) override;
+
+    bool Execute (vector<string>& input, const string& sandbox, json& vars) override;
+
+    json Serialize() override;
+
+    void AddRule (const string& pattern, bool is_regex, unsigned int port);
+
+    void set_rules (const vector<RouterRule>& rules);
+
+    vector<RouterRule> rules() const;
+
+    void set_match_all (bool match_all);
+
+    bool match_all() const;
+
+    void set_default_port (int port);
+
+    int default_port() const;
+
+private:
+    // not exposed
+    using Node::set_batch_flag;
+    using Node::set_outputfile;
+
+    // appends input to the block of each port it goes to, writing out blocks that are full.
+    void route_ (const string& input);
+
+    // writes out every port's block.
+    void flush_();
+
+    vector<RouterRule> rules_;
+    bool match_all_;
+    int default_port_;
+
+    Matcher matcher_;
+    vector<size_t> matches_;
+    vector<size_t> ports_;
+
+    // per output port: the first port on the same FIFO, which holds the block for both, and
+    // the pending block with the number of tokens it counts for.
+    vector<size_t> targets_;
+    vector<string> blocks_;
+    vector<size_t> counts_;
+};
+} // namespace daisychain
@@ -0,0 +1,235 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "settlewheel.h"
+#include <algorithm>
+#include <climits>
+
+
+// slots in the wheel; a path is never scheduled more than one turn ahead.
+#define WHEEL_SLOTS 256
+
+// ticks per settle window, which is how closely the window is kept to.
+#define TICKS_PER_PERIOD 16
+
+
+namespace daisychain {
+using namespace std;
+
+
+SettleWheel::SettleWheel (std::chrono::milliseconds settle, string marker, Clock::time_point now) :
+    settle_ (std::max (settle, std::chrono::milliseconds (0))),
+    marker_ (std::move (marker)),
+    start_ (now),
+    slots_ (WHEEL_SLOTS)
+{
+    if (settle_.count() > 0) {
+        period_ = settle_;
+    }
+
+    tick_ = std::max (period_ / TICKS_PER_PERIOD, std::chrono::milliseconds (10));
+}
+
+
+void
+SettleWheel::Add (const string& path, Clock::time_point now, vector<string>& ready)
+{
+    if (index_.count (path)) {
+        return;
+    }
+
+    TreeIndex::FileInfo info;
+
+    if (!marker_.empty() && TreeIndex::Stat (path + marker_, info)) {
+        ready.push_back (path);
+        ++marked_;
+        return;
+    }
+
+    // a file that is already gone has nothing left to send.
+    if (!TreeIndex::Stat (path, info)) {
+        return;
+    }
+
+    auto due = tick_of (now + period_);
+    auto slot = due % slots_.size();
+
+    slots_[slot].push_back ({path, info, now, due});
+    index_[path] = {slot, std::prev (slots_[slot].end())};
+} // SettleWheel::Add
+
+
+bool
+SettleWheel::Mark (const string& path, vector<string>& ready)
+{
+    if (marker_.empty() || path.size() <= marker_.size() || !path.ends_with (marker_)) {
+        return false;
+    }
+
+    auto it = index_.find (path.substr (0, path.size() - marker_.size()));
+
+    if (it != index_.end()) {
+        ready.push_back (it->first);
+        slots_[it->second.first].erase (it->second.second);
+        index_.erase (it);
+        ++marked_;
+    }
+
+    return true;
+} // SettleWheel::Mark
+
+
+void
+SettleWheel::Advance (Clock::time_point now, vector<string>& ready)
+{
+    if (now < start_) {
+        return;
+    }
+
+    auto target = uint64_t ((now - start_) / tick_);
+
+    // after a long wait, one turn still looks at every slot once.
+    auto first = std::max (current_ + 1, target >= slots_.size() ? target - slots_.size() + 1 : 0);
+
+    for (auto tick = first; tick <= target; ++tick) {
+        auto& slot = slots_[tick % slots_.size()];
+
+        for (auto it = slot.begin(); it != slot.end();) {
+            if (it->due > target) {
+                ++it;
+                continue;
+            }
+
+            bool gone = false;
+
+            if (check_ (*it, now, gone) || gone) {
+                if (!gone) {
+                    ready.push_back (it->path);
+                }
+                index_.erase (it->path);
+                it = slot.erase (it);
+            }
+            else {
+                auto next = std::next (it);
+                schedule_ (it, slot);
+                it = next;
+            }
+        }
+    }
+
+    current_ = std::max (current_, target);
+} // SettleWheel::Advance
+
+
+void
+SettleWheel::Drain (vector<string>& ready)
+{
+    for (auto& slot : slots_) {
+        for (auto& entry : slot) {
+            ready.push_back (std::move (entry.path));
+        }
+        slot.clear();
+    }
+
+    index_.clear();
+} // SettleWheel::Drain
+
+
+void
+SettleWheel::Clear()
+{
+    for (auto& slot : slots_) {
+        slot.clear();
+    }
+
+    index_.clear();
+} // SettleWheel::Clear
+
+
+int
+SettleWheel::timeout (Clock::time_point now) const
+{
+    if (index_.empty()) {
+        return -1;
+    }
+
+    // slots are only looked at on their tick, so the wait is to the next one holding a path.
+    for (auto tick = current_ + 1; tick <= current_ + slots_.size(); ++tick) {
+        if (slots_[tick % slots_.size()].empty()) {
+            continue;
+        }
+
+        auto at = start_ + tick_ * tick;
+
+        if (at <= now) {
+            return 0;
+        }
+
+        auto wait = std::chrono::ceil<std::chrono::milliseconds> (at - now).count();
+
+        return int (std::min<int64_t> (wait, INT_MAX));
+    }
+
+    return 0;
+} // SettleWheel::timeout
+
+
+uint64_t
+SettleWheel::tick_of (Clock::time_point time) const
+{
+    if (time <= start_) {
+        return 0;
+    }
+
+    // rounded up, so a path is not looked at before it is due.
+    return uint64_t ((time - start_ + tick_ - Clock::duration (1)) / tick_);
+} // SettleWheel::tick_of
+
+
+void
+SettleWheel::schedule_ (Slot::iterator entry, Slot& from)
+{
+    auto slot = entry->due % slots_.size();
+
+    slots_[slot].splice (slots_[slot].end(), from, entry);
+    index_[entry->path].first = slot;
+} // SettleWheel::schedule_
+
+
+bool
+SettleWheel::check_ (Entry& entry, Clock::time_point now, bool& gone)
+{
+    TreeIndex::FileInfo info;
+
+    if (!marker_.empty() && TreeIndex::Stat (entry.path + marker_, info)) {
+        ++marked_;
+        return true;
+    }
+
+    if (!TreeIndex::Stat (entry.path, info)) {
+        gone = true;
+        return false;
+    }
+
+    if (settle_.count() == 0) {
+        entry.due = tick_of (now + period_);
+        return false;
+    }
+
+    if (!(info == entry.info)) {
+        // still being written; the window starts over.
+        entry.info = info;
+        entry.stable_since = now;
+    }
+    else if (now - entry.stable_since >= settle_) {
+        ++settled_;
+        return true;
+    }
+
+    entry.due = tick_of (entry.stable_since + settle_);
+
+    return false;
+} // SettleWheel::check_
+} // namespace daisychain
@@ -0,0 +1,97 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include <chrono>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "treeindex.h"
+
+
+namespace daisychain {
+using namespace std;
+
+
+// Holds paths until their files are complete. A path is released once its size and mtime have
+// not changed for the settle window, or once a marker file named path + marker exists; either
+// policy may be off. Writers that reopen a file to append get past a close-write event, but not
+// past this.
+//
+// Paths wait in a timing wheel: adding, rechecking and releasing a path cost the same however
+// many are waiting, and each waiting path is checked about once per settle window.
+class SettleWheel
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    SettleWheel() = default;
+
+    SettleWheel (std::chrono::milliseconds settle, string marker, Clock::time_point now);
+
+    [[nodiscard]] bool active() const { return settle_.count() > 0 || !marker_.empty(); }
+
+    // starts holding path, unless it is held already. A path whose marker exists is ready at once.
+    void Add (const string& path, Clock::time_point now, vector<string>& ready);
+
+    // whether path is a marker file. If so, the path it marks is released into ready.
+    bool Mark (const string& path, vector<string>& ready);
+
+    // checks the paths that are due and moves those that settled into ready.
+    void Advance (Clock::time_point now, vector<string>& ready);
+
+    // moves every held path into ready, settled or not.
+    void Drain (vector<string>& ready);
+
+    void Clear();
+
+    // milliseconds until the next slot with paths in it, for poll(); -1 when nothing is held.
+    [[nodiscard]] int timeout (Clock::time_point now) const;
+
+    [[nodiscard]] size_t size() const { return index_.size(); }
+
+    [[nodiscard]] bool empty() const { return index_.empty(); }
+
+    // paths released by their marker, and by staying unchanged.
+    [[nodiscard]] uint64_t marked() const { return marked_; }
+
+    [[nodiscard]] uint64_t settled() const { return settled_; }
+
+private:
+    struct Entry
+    {
+        string path;
+        TreeIndex::FileInfo info;
+        Clock::time_point stable_since;
+        uint64_t due;       // tick
+    };
+
+    using Slot = std::list<Entry>;
+
+    [[nodiscard]] uint64_t tick_of (Clock::time_point time) const;
+
+    // moves an entry to the slot of its due tick.
+    void schedule_ (Slot::iterator entry, Slot& from);
+
+    // true once the entry may go; gone is set when its file is.
+    bool check_ (Entry& entry, Clock::time_point now, bool& gone);
+
+    std::chrono::milliseconds settle_{0};
+    string marker_;
+    // how often a path is looked at when only the marker releases it.
+    std::chrono::milliseconds period_{1000};
+    std::chrono::milliseconds tick_{100};
+    Clock::time_point start_;
+    uint64_t current_ = 0;
+
+    vector<Slot> slots_;
+    std::unordered_map<string, pair<size_t, Slot::iterator>> index_;
+
+    uint64_t marked_ = 0;
+    uint64_t settled_ = 0;
+};
+} // namespace daisychain
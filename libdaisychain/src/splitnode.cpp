@@ -0,0 +1,193 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "splitnode.h"
+#include <algorithm>
+#include <thread>
+
+
+namespace daisychain {
+using namespace std;
+
+
+SplitNode::SplitNode() :
+    chunk_size_ (64 * 1024 * 1024),
+    chunks_ (0),
+    delimiter_ ("\n"),
+    threads_ (0)
+{
+    type_ = DaisyNodeType::DC_SPLIT;
+    set_name (DaisyNodeNameByType[type_]);
+}
+
+
+void
+SplitNode::Initialize (json& keydata, bool keep_uuid)
+{
+    Node::Initialize (keydata, keep_uuid);
+
+    json::iterator jit = keydata.begin();
+    const auto& uuid = jit.key();
+    auto data = keydata[uuid];
+
+    set_chunk_size (data.count ("chunk_size") ? data["chunk_size"].get<size_t>() : 64 * 1024 * 1024);
+    set_chunks (data.count ("chunks") ? data["chunks"].get<size_t>() : 0);
+    set_delimiter (data.count ("delimiter") ? data["delimiter"].get<string>() : "\n");
+    set_threads (data.count ("threads") ? data["threads"].get<unsigned int>() : 0);
+}
+
+
+bool
+SplitNode::Execute (vector<string>& inputs, const string& sandbox, json& vars)
+{
+    LINFO << "Executing " << (isroot_ ? "root: " : "node: ") << name_;
+
+    if (delimiter_.empty() || (chunk_size_ == 0 && chunks_ == 0)) {
+        LERROR << LOGNODE << "A split needs a delimiter and a chunk size or count.";
+        OpenOutputs (sandbox);
+        WriteOutputs ("EOF");
+        CloseOutputs();
+
+        return false;
+    }
+
+    if (isroot_) {
+        split_ (inputs, sandbox);
+    }
+    else {
+        while (eofs_ <= fd_in_.size() && !terminate_.load()) {
+            split_ (inputs, sandbox);
+
+            inputs.clear();
+
+            if (eofs_ == fd_in_.size()) {
+                break;
+            }
+            ReadInputs (inputs);
+        }
+        CloseInputs();
+    }
+
+    // all processing is done for this node. Send EOF downstream.
+    OpenOutputs (sandbox);
+    WriteOutputs ("EOF");
+    CloseOutputs();
+    Stats();
+    Reset();
+
+    return true;
+} // SplitNode::Execute
+
+
+void
+SplitNode::split_ (vector<string>& inputs, const string& sandbox)
+{
+    vector<string> ranges;
+    vector<size_t> bounds;
+    string scratch;
+
+    for (const auto& input : inputs) {
+        if (input == "EOF" || cancelled_.load()) {
+            continue;
+        }
+
+        const auto& path = token_path (input, scratch);
+        MappedFile file (path);
+
+        if (!file.is_open()) {
+            LWARN << LOGNODE << "Cannot read file to split: " << path;
+            continue;
+        }
+
+        boundaries_ (file.view(), bounds);
+
+        for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+            // ranges carry the attributes of the file they came from.
+            auto range = input;
+            set_token_attribute (range, "chunk", int64_t (i));
+            set_token_attribute (range, "chunk_offset", int64_t (bounds[i]));
+            set_token_attribute (range, "chunk_length", int64_t (bounds[i + 1] - bounds[i]));
+            ranges.push_back (std::move (range));
+        }
+
+        LDEBUG << LOGNODE << path << ": " << bounds.size() - 1 << " ranges.";
+    }
+
+    if (!ranges.empty()) {
+        OpenOutputs (sandbox);
+        WriteTokens (ranges);
+        CloseOutputs();
+    }
+} // SplitNode::split_
+
+
+void
+SplitNode::boundaries_ (std::string_view data, vector<size_t>& bounds) const
+{
+    bounds.clear();
+
+    auto size = data.size();
+
+    if (size == 0) {
+        return;
+    }
+
+    auto step = chunks_ ? std::max<size_t> ((size + chunks_ - 1) / chunks_, 1) : chunk_size_;
+    auto count = (size + step - 1) / step;
+
+    bounds.assign (count + 1, size);
+    bounds[0] = 0;
+
+    // each range but the first starts just past the first delimiter that ends at or after its
+    // nominal offset; a delimiter ending exactly there leaves the offset as it is.
+    auto find = [&] (size_t i) {
+        auto from = i * step - std::min (i * step, delimiter_.size());
+        auto found = data.find (delimiter_, from);
+
+        bounds[i] = found == std::string_view::npos ? size : found + delimiter_.size();
+    };
+
+    auto workers = std::min<size_t> (threads_ ? threads_ : std::max (1u, std::thread::hardware_concurrency()), count - 1);
+
+    if (workers <= 1) {
+        for (size_t i = 1; i < count; ++i) {
+            find (i);
+        }
+    }
+    else {
+        vector<std::thread> pool;
+
+        for (size_t w = 0; w < workers; ++w) {
+            pool.emplace_back ([&, w] {
+                for (size_t i = 1 + w; i < count; i += workers) {
+                    find (i);
+                }
+            });
+        }
+
+        for (auto& thread : pool) {
+            thread.join();
+        }
+    }
+
+    // records longer than a range swallow the ranges after them.
+    bounds.erase (std::unique (bounds.begin(), bounds.end()), bounds.end());
+} // SplitNode::boundaries_
+
+
+json
+SplitNode::Serialize()
+{
+    auto json_ = Node::Serialize();
+    json_[id_]["chunk_size"] = chunk_size_;
+    json_[id_]["chunks"] = chunks_;
+    json_[id_]["delimiter"] = delimiter_;
+    json_[id_]["threads"] = threads_;
+
+    if (size_ != std::pair<int, int>(0,0)) {json_[id_]["size"] = size_;}
+
+    return json_;
+} // SplitNode::Serialize
+} // namespace daisychain
@@ -0,0 +1,69 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include "mappedfile.h"
+#include "node.h"
+
+
+namespace daisychain {
+// Splits each input file into byte ranges that end on record boundaries, so that a distro can
+// hand the parts of one large file to many workers. Each range goes downstream as the file's
+// path with the attributes "chunk" (its index), "chunk_offset" and "chunk_length"; a command
+// gets the last two as ${CHUNK_OFFSET} and ${CHUNK_LENGTH}, for example
+// `tail -c +$((CHUNK_OFFSET + 1)) "${INPUT}" | head -c ${CHUNK_LENGTH}`.
+//
+// Ranges are chunk_size bytes, or the file's size over chunks when that is set, moved forward
+// to just past the next delimiter. Only the bytes from each nominal offset to the next
+// delimiter are read, through a memory mapping and by several threads at once, so splitting
+// costs a few pages per range however large the file is.
+class SplitNode final : public Node
+{
+public:
+    SplitNode();
+
+    void Initialize (json&, bool) override;
+
+    bool Execute (vector<string>& input, const string& sandbox, json& vars) override;
+
+    json Serialize() override;
+
+    // bytes per range before moving to a boundary.
+    void set_chunk_size (size_t bytes) { chunk_size_ = bytes; }
+
+    [[nodiscard]] size_t chunk_size() const { return chunk_size_; }
+
+    // ranges per file; overrides chunk_size when not 0.
+    void set_chunks (size_t chunks) { chunks_ = chunks; }
+
+    [[nodiscard]] size_t chunks() const { return chunks_; }
+
+    // what ends a record; a newline by default.
+    void set_delimiter (const string& delimiter) { delimiter_ = delimiter; }
+
+    string delimiter() const { return delimiter_; }
+
+    // 0 uses one thread per core.
+    void set_threads (unsigned int threads) { threads_ = threads; }
+
+    [[nodiscard]] unsigned int threads() const { return threads_; }
+
+private:
+    // not exposed
+    using Node::set_batch_flag;
+    using Node::set_outputfile;
+
+    void split_ (vector<string>& inputs, const string& sandbox);
+
+    // the offsets at which the ranges of a file start, and its size last.
+    void boundaries_ (std::string_view data, vector<size_t>& bounds) const;
+
+    size_t chunk_size_;
+    size_t chunks_;
+    string delimiter_;
+    unsigned int threads_;
+};
+} // namespace daisychain
@@ -0,0 +1,84 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "subgraphnode.h"
+
+
+namespace daisychain {
+using namespace std;
+
+
+SubgraphNode::SubgraphNode()
+{
+    type_ = DaisyNodeType::DC_SUBGRAPH;
+    set_name (DaisyNodeNameByType[type_]);
+}
+
+
+SubgraphNode::SubgraphNode (const string& filename) :
+    filename_ (filename)
+{
+    type_ = DaisyNodeType::DC_SUBGRAPH;
+    set_name (DaisyNodeNameByType[type_]);
+}
+
+
+void
+SubgraphNode::Initialize (json& keydata, bool keep_uuid)
+{
+    Node::Initialize (keydata, keep_uuid);
+
+    json::iterator jit = keydata.begin();
+    const auto& uuid = jit.key();
+    auto data = keydata[uuid];
+
+    set_filename (data.count ("file") ? data["file"] : "");
+}
+
+
+bool
+SubgraphNode::Execute (vector<string>&, const string& sandbox, json&)
+{
+    // only reached when the graph file could not be inlined. Downstream nodes still get their
+    // EOF, so the run fails instead of hanging.
+    LERROR << LOGNODE << "Subgraph was not inlined: " << filename_;
+
+    if (!isroot_) {
+        CloseInputs();
+    }
+
+    OpenOutputs (sandbox);
+    WriteOutputs ("EOF");
+    CloseOutputs();
+
+    return false;
+} // SubgraphNode::Execute
+
+
+json
+SubgraphNode::Serialize()
+{
+    auto json_ = Node::Serialize();
+    json_[id_]["file"] = filename_;
+
+    if (size_ != std::pair<int, int>(0,0)) {json_[id_]["size"] = size_;}
+
+    return json_;
+} // SubgraphNode::Serialize
+
+
+void
+SubgraphNode::set_filename (const string& filename)
+{
+    filename_ = filename;
+} // SubgraphNode::set_filename
+
+
+string
+SubgraphNode::filename()
+{
+    return filename_;
+} // SubgraphNode::filename
+} // namespace daisychain
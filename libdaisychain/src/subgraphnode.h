@@ -0,0 +1,41 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include "node.h"
+
+
+namespace daisychain {
+// Placeholder for another graph file (.dcg). It never runs on its own: Graph::Compile()
+// replaces it with the nodes of the referenced graph, so they share the parent's sandbox and
+// run for the whole execution. Parent inputs feed the subgraph's roots and its leaves feed
+// the parent's outputs, both in the file's node order. The file's environment becomes the
+// default environment of its nodes; the plan is rebuilt when the file changes.
+class SubgraphNode final : public Node
+{
+public:
+    SubgraphNode();
+
+    explicit SubgraphNode (const string& filename);
+
+    void Initialize (json&, bool) override;
+
+    bool Execute (vector<string>& input, const string& sandbox, json& vars) override;
+
+    json Serialize() override;
+
+    void set_filename (const string& filename);
+
+    string filename();
+
+private:
+    // not exposed
+    using Node::set_batch_flag;
+    using Node::set_outputfile;
+
+    string filename_;
+};
+} // namespace daisychain
@@ -0,0 +1,201 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "throttlenode.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+namespace daisychain {
+using namespace std;
+
+
+ThrottleNode::ThrottleNode() :
+    rate_ (0.0),
+    burst_ (1),
+    tokens_ (0.0),
+    passed_ (0),
+    held_ (0)
+{
+    type_ = DaisyNodeType::DC_THROTTLE;
+    set_name (DaisyNodeNameByType[type_]);
+}
+
+
+void
+ThrottleNode::Initialize (json& keydata, bool keep_uuid)
+{
+    Node::Initialize (keydata, keep_uuid);
+
+    json::iterator jit = keydata.begin();
+    const auto& uuid = jit.key();
+    auto data = keydata[uuid];
+
+    set_rate (data.count ("rate") ? data["rate"].get<double>() : 0.0);
+    set_burst (data.count ("burst") ? data["burst"].get<size_t>() : 1);
+}
+
+
+bool
+ThrottleNode::Execute (vector<string>& inputs, const string& sandbox, json& vars)
+{
+    LINFO << "Executing " << (isroot_ ? "root: " : "node: ") << name_;
+
+    if (!(rate_ >= 0.0) || std::isinf (rate_)) {
+        LERROR << LOGNODE << "Invalid throttle rate: " << rate_;
+        OpenOutputs (sandbox);
+        WriteOutputs ("EOF");
+        CloseOutputs();
+
+        return false;
+    }
+
+    // the bucket starts full, so the first burst goes out at once.
+    tokens_ = double (std::max<size_t> (burst_, 1));
+    refilled_ = Clock::now();
+    passed_ = 0;
+    held_ = 0;
+
+    if (isroot_) {
+        pace_ (inputs, sandbox);
+    }
+    else {
+        while (eofs_ <= fd_in_.size() && !terminate_.load()) {
+            pace_ (inputs, sandbox);
+
+            inputs.clear();
+
+            if (eofs_ == fd_in_.size()) {
+                break;
+            }
+            ReadInputs (inputs);
+        }
+        CloseInputs();
+    }
+
+    // all processing is done for this node. Send EOF downstream.
+    OpenOutputs (sandbox);
+    WriteOutputs ("EOF");
+    CloseOutputs();
+    Stats();
+    Reset();
+
+    return true;
+} // ThrottleNode::Execute
+
+
+void
+ThrottleNode::pace_ (vector<string>& inputs, const string& sandbox)
+{
+    std::erase (inputs, "EOF");
+
+    size_t next = 0;
+
+    // a cancelled run drops what is held and keeps reading, so upstream is not blocked.
+    while (next < inputs.size() && !cancelled_.load() && !terminate_.load()) {
+        auto now = Clock::now();
+        auto count = std::min (available_ (now), inputs.size() - next);
+
+        if (count == 0) {
+            wait_ (now);
+            continue;
+        }
+
+        // what may go now goes as one write.
+        vector<string> tokens (std::make_move_iterator (inputs.begin() + long (next)),
+                               std::make_move_iterator (inputs.begin() + long (next + count)));
+        next += count;
+        passed_ += count;
+
+        if (rate_ > 0.0) {
+            tokens_ -= double (count);
+        }
+
+        OpenOutputs (sandbox);
+        WriteTokens (tokens);
+        CloseOutputs();
+    }
+} // ThrottleNode::pace_
+
+
+size_t
+ThrottleNode::available_ (Clock::time_point now)
+{
+    if (rate_ <= 0.0) {
+        return std::numeric_limits<size_t>::max();
+    }
+
+    auto elapsed = std::chrono::duration<double> (now - refilled_).count();
+    tokens_ = std::min (tokens_ + elapsed * rate_, double (std::max<size_t> (burst_, 1)));
+    refilled_ = now;
+
+    return size_t (tokens_);
+} // ThrottleNode::available_
+
+
+void
+ThrottleNode::wait_ (Clock::time_point now)
+{
+    auto due = now + std::chrono::duration_cast<Clock::duration> (
+                         std::chrono::duration<double> ((1.0 - tokens_) / rate_));
+
+    std::unique_lock lock (mutex_);
+    cv_.wait_until (lock, due, [this] { return cancelled_.load() || terminate_.load(); });
+
+    held_ += uint64_t (std::chrono::duration_cast<std::chrono::milliseconds> (Clock::now() - now).count());
+} // ThrottleNode::wait_
+
+
+void
+ThrottleNode::wake_()
+{
+    // taken so that a wait_() about to sleep sees the flag first.
+    {
+        std::lock_guard lock (mutex_);
+    }
+    cv_.notify_all();
+} // ThrottleNode::wake_
+
+
+void
+ThrottleNode::Cancel()
+{
+    Node::Cancel();
+    wake_();
+} // ThrottleNode::Cancel
+
+
+#ifdef _WIN32
+void
+ThrottleNode::Stop()
+{
+    Node::Stop();
+    wake_();
+} // ThrottleNode::Stop
+#endif
+
+
+json
+ThrottleNode::Serialize()
+{
+    auto json_ = Node::Serialize();
+    json_[id_]["rate"] = rate_;
+    json_[id_]["burst"] = burst_;
+
+    if (size_ != std::pair<int, int>(0,0)) {json_[id_]["size"] = size_;}
+
+    return json_;
+} // ThrottleNode::Serialize
+
+
+void
+ThrottleNode::Stats()
+{
+    LINFO << LOGNODE << "tokens passed: " << passed_ << ", held back: " << held_ << " ms";
+
+    Node::Stats();
+} // ThrottleNode::Stats
+} // namespace daisychain
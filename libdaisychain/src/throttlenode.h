@@ -0,0 +1,81 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include "node.h"
+
+
+namespace daisychain {
+// Passes tokens on no faster than rate per second, as a token bucket: up to burst tokens may go
+// at once after a quiet spell, and the bucket refills at rate. Tokens that are held wait on a
+// deadline for the next one to be due rather than polling, and a cancel wakes the wait.
+//
+// Put in front of a stage that hits a shared resource, it sets the pace for everything
+// downstream of it; with a distro after it, the limit is for all the branches together.
+class ThrottleNode final : public Node
+{
+public:
+    ThrottleNode();
+
+    void Initialize (json&, bool) override;
+
+    bool Execute (vector<string>& input, const string& sandbox, json& vars) override;
+
+    json Serialize() override;
+
+    void Stats() override;
+
+    void Cancel() override;
+
+#ifdef _WIN32
+    void Stop() override;
+#endif
+
+    // tokens per second; 0 lets every token through at once.
+    void set_rate (double rate) { rate_ = rate; }
+
+    [[nodiscard]] double rate() const { return rate_; }
+
+    // tokens that may go out together; at least 1.
+    void set_burst (size_t burst) { burst_ = burst; }
+
+    [[nodiscard]] size_t burst() const { return burst_; }
+
+private:
+    // not exposed
+    using Node::set_batch_flag;
+    using Node::set_outputfile;
+
+    using Clock = std::chrono::steady_clock;
+
+    // sends inputs downstream at the rate allowed.
+    void pace_ (vector<string>& inputs, const string& sandbox);
+
+    // tokens that may go now, after refilling the bucket for the time gone by; those that go
+    // are taken out of it by the caller.
+    size_t available_ (Clock::time_point now);
+
+    // waits until the next token is due, or for a cancel.
+    void wait_ (Clock::time_point now);
+
+    void wake_();
+
+    double rate_;
+    size_t burst_;
+
+    double tokens_;
+    Clock::time_point refilled_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+
+    uint64_t passed_;
+    uint64_t held_;
+};
+} // namespace daisychain
@@ -0,0 +1,104 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "token.h"
+#include <charconv>
+
+
+namespace daisychain {
+using namespace std;
+
+
+namespace {
+void
+append_clean (string& token, std::string_view text)
+{
+    for (auto c : text) {
+        token += (c == TOKEN_RS || c == TOKEN_US || c == '\n' || c == '\r' || c == '\t') ? ' ' : c;
+    }
+}
+
+
+// where the field of the named attribute starts (at its RS) and ends; npos if there is none.
+pair<size_t, size_t>
+find_attribute (std::string_view token, std::string_view name)
+{
+    auto pos = token.find (TOKEN_RS);
+
+    while (pos != std::string_view::npos) {
+        auto next = token.find (TOKEN_RS, pos + 1);
+        auto field = token.substr (pos + 1, next == std::string_view::npos ? std::string_view::npos : next - pos - 1);
+
+        if (field.size() > name.size() && field[name.size()] == TOKEN_US && field.starts_with (name)) {
+            return {pos, next == std::string_view::npos ? token.size() : next};
+        }
+
+        pos = next;
+    }
+
+    return {std::string_view::npos, std::string_view::npos};
+}
+} // namespace
+
+
+bool
+token_attribute (std::string_view token, std::string_view name, std::string_view& value)
+{
+    auto [begin, end] = find_attribute (token, name);
+
+    if (begin == std::string_view::npos) {
+        return false;
+    }
+
+    value = token.substr (begin + name.size() + 2, end - begin - name.size() - 2);
+    return true;
+} // token_attribute
+
+
+bool
+token_attribute (std::string_view token, std::string_view name, int64_t& value)
+{
+    std::string_view text;
+
+    if (!token_attribute (token, name, text)) {
+        return false;
+    }
+
+    auto [ptr, ec] = std::from_chars (text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && ptr == text.data() + text.size();
+} // token_attribute
+
+
+void
+set_token_attribute (string& token, std::string_view name, std::string_view value)
+{
+    auto [begin, end] = find_attribute (token, name);
+
+    if (begin != std::string_view::npos) {
+        token.erase (begin, end - begin);
+    }
+
+    token += TOKEN_RS;
+    append_clean (token, name);
+    token += TOKEN_US;
+    append_clean (token, value);
+} // set_token_attribute
+
+
+void
+set_token_attribute (string& token, std::string_view name, int64_t value)
+{
+    set_token_attribute (token, name, std::string_view (std::to_string (value)));
+} // set_token_attribute
+
+
+void
+merge_token_attributes (string& token, std::string_view from)
+{
+    for_each_attribute (from, [&token] (std::string_view name, std::string_view value) {
+        set_token_attribute (token, name, value);
+    });
+} // merge_token_attributes
+} // namespace daisychain
@@ -0,0 +1,101 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+
+namespace daisychain {
+using namespace std;
+
+
+// A token is a line of text, usually a path. It may carry attributes after the path:
+//
+//     path RS name US value RS name US value ...
+//
+// RS and US are the ASCII record and unit separators, which do not turn up in paths or in what
+// commands print. A token without attributes is just its path, so nodes that pass tokens on keep
+// the attributes for free, and nodes that look at the path take it with token_path(). Values are
+// text; integers are written in decimal.
+static constexpr char TOKEN_RS = '\x1e';
+static constexpr char TOKEN_US = '\x1f';
+
+
+[[nodiscard]] inline bool
+has_attributes (std::string_view token)
+{
+    return token.find (TOKEN_RS) != std::string_view::npos;
+}
+
+
+[[nodiscard]] inline std::string_view
+token_path (std::string_view token)
+{
+    return token.substr (0, token.find (TOKEN_RS));
+}
+
+
+// the path of token; scratch holds a copy only when the token has attributes.
+inline const string&
+token_path (const string& token, string& scratch)
+{
+    auto end = token.find (TOKEN_RS);
+
+    if (end == string::npos) {
+        return token;
+    }
+
+    scratch.assign (token, 0, end);
+    return scratch;
+}
+
+
+// the attributes of token with their leading separator, ready to append to another path.
+[[nodiscard]] inline std::string_view
+token_attributes (std::string_view token)
+{
+    auto begin = token.find (TOKEN_RS);
+    return begin == std::string_view::npos ? std::string_view() : token.substr (begin);
+}
+
+
+// false if token has no attribute by that name.
+bool token_attribute (std::string_view token, std::string_view name, std::string_view& value);
+
+bool token_attribute (std::string_view token, std::string_view name, int64_t& value);
+
+// adds an attribute, or replaces the value of the one with that name. Separators and line breaks
+// in name or value are replaced by spaces.
+void set_token_attribute (string& token, std::string_view name, std::string_view value);
+
+void set_token_attribute (string& token, std::string_view name, int64_t value);
+
+// sets every attribute of from on token, replacing those with the same name.
+void merge_token_attributes (string& token, std::string_view from);
+
+
+// calls f (name, value) for each attribute of token, in order.
+template <typename F>
+void
+for_each_attribute (std::string_view token, F f)
+{
+    auto pos = token.find (TOKEN_RS);
+
+    while (pos != std::string_view::npos) {
+        auto next = token.find (TOKEN_RS, pos + 1);
+        auto field = token.substr (pos + 1, next == std::string_view::npos ? std::string_view::npos : next - pos - 1);
+        auto split = field.find (TOKEN_US);
+
+        if (split != std::string_view::npos) {
+            f (field.substr (0, split), field.substr (split + 1));
+        }
+
+        pos = next;
+    }
+}
+} // namespace daisychain
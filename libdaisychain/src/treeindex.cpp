@@ -0,0 +1,857 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "treeindex.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include "mappedfile.h"
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+
+namespace fs = std::filesystem;
+
+
+namespace daisychain {
+using namespace std;
+
+
+namespace {
+string
+join_path (const string& directory, const string& name)
+{
+    if (!directory.empty() && directory.back() == '/') {
+        return directory + name;
+    }
+
+    return directory + "/" + name;
+}
+
+
+// trailing separators would make the subtree ranges below miss.
+string
+normalize (string path)
+{
+    while (path.size() > 1 && path.back() == '/') {
+        path.pop_back();
+    }
+
+    return path;
+}
+
+
+// whether path, somewhere under root, is one of root's own entries.
+bool
+is_direct_child (const string& root, const string& path)
+{
+    auto start = root.size() + (root.back() == '/' ? 0 : 1);
+    return path.find ('/', start) == string::npos;
+}
+
+
+unsigned int
+pool_size (unsigned int threads)
+{
+    return threads ? threads : std::max (1u, std::thread::hardware_concurrency());
+}
+
+
+#ifndef _WIN32
+TreeIndex::FileInfo
+to_info (const struct stat& status)
+{
+    TreeIndex::FileInfo info;
+    info.size = uint64_t (status.st_size);
+#ifdef __APPLE__
+    info.mtime = int64_t (status.st_mtimespec.tv_sec) * 1000000000 + status.st_mtimespec.tv_nsec;
+#else
+    info.mtime = int64_t (status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+#endif
+    info.inode = uint64_t (status.st_ino);
+    info.device = uint64_t (status.st_dev);
+
+    return info;
+}
+#endif
+
+
+#ifdef __linux__
+// the record layout getdents64 returns; glibc does not export it under this name.
+struct linux_dirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+
+#ifndef _WIN32
+// calls each (fd, name, type) for the entries of a directory, without "." and "..". fd is the
+// open directory, for lookups relative to it.
+template <typename Each>
+bool
+read_directory (const string& directory, TreeIndex::FileInfo* info, Each each)
+{
+    auto type_of = [] (unsigned char type) {
+        switch (type) {
+            case DT_DIR: return TreeIndex::EntryType::DIRECTORY;
+            case DT_LNK: return TreeIndex::EntryType::SYMLINK;
+            case DT_UNKNOWN: return TreeIndex::EntryType::UNKNOWN;
+            default: return TreeIndex::EntryType::FILE;
+        }
+    };
+
+    auto skip = [] (const char* name) {
+        return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+    };
+
+#ifdef __linux__
+    int fd = open (directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+#else
+    DIR* dir = opendir (directory.c_str());
+    int fd = dir != nullptr ? dirfd (dir) : -1;
+#endif
+
+    if (fd == -1) {
+        return false;
+    }
+
+    if (info != nullptr) {
+        struct stat status{};
+        if (fstat (fd, &status) == 0) {
+            *info = to_info (status);
+        }
+    }
+
+#ifdef __linux__
+    // large reads straight from the kernel, without readdir's per-entry calls.
+    alignas (linux_dirent64) char buffer[64 * 1024];
+    long numbytes;
+
+    while ((numbytes = syscall (SYS_getdents64, fd, buffer, sizeof (buffer))) > 0) {
+        for (long offset = 0; offset < numbytes;) {
+            auto* record = reinterpret_cast<linux_dirent64*> (buffer + offset);
+            offset += record->d_reclen;
+
+            if (!skip (record->d_name)) {
+                each (fd, record->d_name, type_of (record->d_type));
+            }
+        }
+    }
+
+    close (fd);
+
+    return numbytes == 0;
+#else
+    while (auto* record = readdir (dir)) {
+        if (!skip (record->d_name)) {
+            each (fd, record->d_name, type_of (record->d_type));
+        }
+    }
+
+    closedir (dir);
+
+    return true;
+#endif
+} // read_directory
+#endif
+
+
+// the start of a saved index; the byte order mark rejects files from other machines.
+constexpr char STATE_MAGIC[4] = {'D', 'C', 'T', 'I'};
+constexpr uint32_t STATE_VERSION = 1;
+constexpr uint32_t STATE_ORDER = 0x01020304;
+
+
+// whether path is root or somewhere under it.
+bool
+is_under (const string& root, const string& path)
+{
+    if (!path.starts_with (root)) {
+        return false;
+    }
+
+    return path.size() == root.size() || root.back() == '/' || path[root.size()] == '/';
+}
+
+
+// the directory part of a path and the name in it.
+pair<string, string>
+split_path (const string& path)
+{
+    auto slash = path.rfind ('/');
+
+    if (slash == string::npos) {
+        return {".", path};
+    }
+
+    return {slash == 0 ? "/" : path.substr (0, slash), path.substr (slash + 1)};
+}
+
+
+bool
+by_name (const pair<string, TreeIndex::FileInfo>& a, const pair<string, TreeIndex::FileInfo>& b)
+{
+    return a.first < b.first;
+}
+} // namespace
+
+
+bool
+TreeIndex::List (const string& directory, vector<Entry>& entries, FileInfo* info)
+{
+#ifdef _WIN32
+    std::error_code ec;
+
+    for (const auto& item : fs::directory_iterator (directory, ec)) {
+        auto type = item.is_symlink (ec) ? EntryType::SYMLINK
+                  : item.is_directory (ec) ? EntryType::DIRECTORY
+                  : EntryType::FILE;
+        entries.push_back ({item.path().filename().string(), type});
+    }
+
+    if (info != nullptr) {
+        Stat (directory, *info);
+    }
+
+    return !ec;
+#else
+    return read_directory (directory, info, [&entries] (int, const char* name, EntryType type) {
+        entries.push_back ({name, type});
+    });
+#endif
+} // TreeIndex::List
+
+
+bool
+TreeIndex::Stat (const string& path, FileInfo& info, EntryType* type)
+{
+#ifdef _WIN32
+    std::error_code ec;
+    auto status = fs::symlink_status (path, ec);
+
+    if (ec || !fs::exists (status)) {
+        return false;
+    }
+
+    info = FileInfo{};
+    if (fs::is_regular_file (status)) {
+        info.size = fs::file_size (path, ec);
+    }
+    info.mtime = fs::last_write_time (path, ec).time_since_epoch().count();
+
+    if (type != nullptr) {
+        *type = fs::is_symlink (status) ? EntryType::SYMLINK
+              : fs::is_directory (status) ? EntryType::DIRECTORY
+              : EntryType::FILE;
+    }
+#else
+    struct stat status{};
+
+    if (lstat (path.c_str(), &status) == -1) {
+        return false;
+    }
+
+    info = to_info (status);
+
+    if (type != nullptr) {
+        *type = S_ISDIR (status.st_mode) ? EntryType::DIRECTORY
+              : S_ISLNK (status.st_mode) ? EntryType::SYMLINK
+              : EntryType::FILE;
+    }
+#endif
+
+    return true;
+} // TreeIndex::Stat
+
+
+void
+TreeIndex::Scan (const string& path, bool recursive, unsigned int threads, vector<string>* changed,
+                 vector<string>* subdirectories)
+{
+    auto root = normalize (path);
+
+    FileInfo info;
+    auto type = EntryType::UNKNOWN;
+    bool exists = Stat (root, info, &type);
+
+    if (!exists || type != EntryType::DIRECTORY) {
+        // a single file, or nothing left to index under root.
+        forget_ (root);
+
+        if (exists) {
+            const auto* indexed = find_ (root);
+            if (changed != nullptr && (indexed == nullptr || !(*indexed == info))) {
+                changed->push_back (root);
+            }
+        }
+
+        put_ (root, exists ? &info : nullptr);
+        return;
+    }
+
+    Folders fresh;
+    collect_ ({root}, recursive, threads, fresh, recursive ? nullptr : subdirectories);
+
+    if (changed != nullptr) {
+        for (const auto& [directory, folder] : fresh) {
+            compare_ (directory, folder, *changed);
+        }
+    }
+
+    // files indexed on their own are now part of their directory.
+    auto prefix = root.back() == '/' ? root : root + "/";
+
+    for (auto it = files_.lower_bound (prefix); it != files_.end() && it->first.starts_with (prefix);) {
+        it = (recursive || is_direct_child (root, it->first)) ? files_.erase (it) : std::next (it);
+    }
+
+    if (recursive) {
+        forget_ (root);
+        directories_.merge (fresh);
+    }
+    else if (fresh.count (root)) {
+        // a shallow scan only knows about the root itself; keep what was indexed below it.
+        directories_[root] = std::move (fresh[root]);
+    }
+} // TreeIndex::Scan
+
+
+void
+TreeIndex::Rescan (const vector<string>& directories, unsigned int threads, vector<string>* changed,
+                   vector<string>* subdirectories)
+{
+    vector<string> roots;
+    roots.reserve (directories.size());
+
+    for (const auto& directory : directories) {
+        roots.push_back (normalize (directory));
+    }
+
+    Folders fresh;
+    collect_ (roots, false, threads, fresh, subdirectories);
+
+    for (const auto& root : roots) {
+        auto it = fresh.find (root);
+
+        if (it != fresh.end()) {
+            if (changed != nullptr) {
+                compare_ (root, it->second, *changed);
+            }
+            directories_[root] = std::move (it->second);
+        }
+        else if (FileInfo info; !Stat (root, info)) {
+            forget_ (root);
+        }
+    }
+} // TreeIndex::Rescan
+
+
+void
+TreeIndex::Update (const string& path)
+{
+    FileInfo info;
+    EntryType type;
+
+    if (!Stat (path, info, &type)) {
+        put_ (path, nullptr);
+    }
+    else if (type != EntryType::DIRECTORY) {
+        put_ (path, &info);
+    }
+} // TreeIndex::Update
+
+
+void
+TreeIndex::Stale (unsigned int threads, vector<string>& directories) const
+{
+    vector<const Folders::value_type*> items;
+    items.reserve (directories_.size());
+
+    for (const auto& item : directories_) {
+        items.push_back (&item);
+    }
+
+    std::atomic<size_t> next = 0;
+    std::mutex mutex;
+
+    auto worker = [&] () {
+        vector<string> stale;
+        FileInfo info;
+
+        for (size_t i = next++; i < items.size(); i = next++) {
+            const auto& [path, folder] = *items[i];
+
+            // a new, removed or renamed entry changes the directory's mtime.
+            if (!Stat (path, info) || info.mtime != folder.info.mtime || info.inode != folder.info.inode) {
+                stale.push_back (path);
+            }
+        }
+
+        std::lock_guard lock (mutex);
+        directories.insert (directories.end(), stale.begin(), stale.end());
+    };
+
+    auto count = std::min<size_t> (pool_size (threads), std::max<size_t> (items.size() / 256, 1));
+    vector<std::thread> pool;
+
+    for (size_t i = 1; i < count; ++i) {
+        pool.emplace_back (worker);
+    }
+
+    worker();
+
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    std::sort (directories.begin(), directories.end());
+} // TreeIndex::Stale
+
+
+void
+TreeIndex::Directories (const string& path, vector<pair<string, FileInfo>>& directories) const
+{
+    auto root = normalize (path);
+
+    if (auto it = directories_.find (root); it != directories_.end()) {
+        directories.emplace_back (root, it->second.info);
+    }
+
+    auto prefix = root.back() == '/' ? root : root + "/";
+
+    for (auto it = directories_.lower_bound (prefix); it != directories_.end() && it->first.starts_with (prefix); ++it) {
+        if (it->first != root) {
+            directories.emplace_back (it->first, it->second.info);
+        }
+    }
+} // TreeIndex::Directories
+
+
+bool
+TreeIndex::Save (const string& path) const
+{
+    static_assert (sizeof (FileInfo) == 32, "FileInfo is saved as it is laid out in memory");
+
+    // Layout: magic, version, byte order, folder count, file count. Each folder is its path, its
+    // info, a file count and the files, each a name and its info. Then each file indexed on its
+    // own, as a path and its info. Strings are a 32 bit length and the bytes.
+    auto temporary = path + ".tmp";
+    std::ofstream out (temporary, std::ios::binary | std::ios::trunc);
+
+    auto put = [&out] (const auto& value) { out.write (reinterpret_cast<const char*> (&value), sizeof (value)); };
+
+    auto put_string = [&out, &put] (const string& text) {
+        put (uint32_t (text.size()));
+        out.write (text.data(), std::streamsize (text.size()));
+    };
+
+    out.write (STATE_MAGIC, sizeof (STATE_MAGIC));
+    put (STATE_VERSION);
+    put (STATE_ORDER);
+    put (uint64_t (directories_.size()));
+    put (uint64_t (files_.size()));
+
+    for (const auto& [directory, folder] : directories_) {
+        put_string (directory);
+        put (folder.info);
+        put (uint64_t (folder.files.size()));
+
+        for (const auto& [name, info] : folder.files) {
+            put_string (name);
+            put (info);
+        }
+    }
+
+    for (const auto& [file, info] : files_) {
+        put_string (file);
+        put (info);
+    }
+
+    out.close();
+
+    std::error_code ec;
+
+    if (!out) {
+        fs::remove (temporary, ec);
+        return false;
+    }
+
+    fs::rename (temporary, path, ec);
+
+    return !ec;
+} // TreeIndex::Save
+
+
+bool
+TreeIndex::Load (const string& path)
+{
+    Clear();
+
+    MappedFile file (path);
+
+    if (!file.is_open()) {
+        return false;
+    }
+
+    auto data = file.view();
+    size_t offset = 0;
+
+    // every read is checked against the end, so a truncated file fails instead of overrunning.
+    auto get = [&] (auto& value) {
+        if (data.size() - offset < sizeof (value)) {
+            return false;
+        }
+        std::memcpy (&value, data.data() + offset, sizeof (value));
+        offset += sizeof (value);
+        return true;
+    };
+
+    auto get_string = [&] (string& text) {
+        uint32_t length;
+        if (!get (length) || data.size() - offset < length) {
+            return false;
+        }
+        text.assign (data.data() + offset, length);
+        offset += length;
+        return true;
+    };
+
+    char magic[sizeof (STATE_MAGIC)];
+    uint32_t version, order;
+    uint64_t folders, files;
+
+    bool valid = get (magic) && std::memcmp (magic, STATE_MAGIC, sizeof (magic)) == 0 && get (version) &&
+                 version == STATE_VERSION && get (order) && order == STATE_ORDER && get (folders) && get (files);
+
+    for (uint64_t i = 0; valid && i < folders; ++i) {
+        string directory;
+        Folder folder;
+        uint64_t count;
+
+        valid = get_string (directory) && get (folder.info) && get (count);
+
+        for (uint64_t j = 0; valid && j < count; ++j) {
+            string name;
+            FileInfo info;
+            valid = get_string (name) && get (info);
+            folder.files.emplace_back (std::move (name), info);
+        }
+
+        directories_.emplace_hint (directories_.end(), std::move (directory), std::move (folder));
+    }
+
+    for (uint64_t i = 0; valid && i < files; ++i) {
+        string file_path;
+        FileInfo info;
+        valid = get_string (file_path) && get (info);
+        files_.emplace_hint (files_.end(), std::move (file_path), info);
+    }
+
+    if (!valid || offset != data.size()) {
+        Clear();
+        return false;
+    }
+
+    return true;
+} // TreeIndex::Load
+
+
+void
+TreeIndex::Retain (const vector<string>& paths)
+{
+    vector<string> roots;
+
+    for (const auto& path : paths) {
+        roots.push_back (normalize (path));
+    }
+
+    auto kept = [&roots] (const string& path) {
+        return std::any_of (roots.begin(), roots.end(), [&path] (const string& root) { return is_under (root, path); });
+    };
+
+    std::erase_if (directories_, [&kept] (const auto& item) { return !kept (item.first); });
+    std::erase_if (files_, [&kept] (const auto& item) { return !kept (item.first); });
+} // TreeIndex::Retain
+
+
+bool
+TreeIndex::contains (const string& path) const
+{
+    return directories_.count (path) || find_ (path) != nullptr;
+} // TreeIndex::contains
+
+
+void
+TreeIndex::Clear()
+{
+    files_.clear();
+    directories_.clear();
+} // TreeIndex::Clear
+
+
+size_t
+TreeIndex::file_count() const
+{
+    auto count = files_.size();
+
+    for (const auto& [path, folder] : directories_) {
+        count += folder.files.size();
+    }
+
+    return count;
+} // TreeIndex::file_count
+
+
+bool
+TreeIndex::visit_ (const string& directory, Folder& folder, vector<string>& subdirectories)
+{
+#ifdef _WIN32
+    vector<Entry> entries;
+
+    if (!List (directory, entries, &folder.info)) {
+        return false;
+    }
+
+    for (const auto& entry : entries) {
+        auto path = join_path (directory, entry.name);
+        auto type = entry.type;
+        FileInfo info;
+
+        if (type == EntryType::DIRECTORY) {
+            subdirectories.push_back (std::move (path));
+            continue;
+        }
+
+        if (!Stat (path, info, &type)) {
+            continue;
+        }
+
+        if (type == EntryType::DIRECTORY) {
+            subdirectories.push_back (std::move (path));
+        }
+        else {
+            folder.files.emplace_back (entry.name, info);
+        }
+    }
+#else
+    bool listed = read_directory (directory, &folder.info, [&] (int fd, const char* name, EntryType type) {
+        if (type == EntryType::DIRECTORY) {
+            subdirectories.push_back (join_path (directory, name));
+            return;
+        }
+
+        // relative to the open directory, so the path above it is not looked up again for every
+        // file; on NFS each of those lookups can be a round trip.
+        struct stat status{};
+
+        if (fstatat (fd, name, &status, AT_SYMLINK_NOFOLLOW) == -1) {
+            return;     // gone since it was listed
+        }
+
+        if (S_ISDIR (status.st_mode)) {
+            subdirectories.push_back (join_path (directory, name));
+        }
+        else {
+            folder.files.emplace_back (name, to_info (status));
+        }
+    });
+
+    if (!listed) {
+        return false;
+    }
+#endif
+
+    std::sort (folder.files.begin(), folder.files.end(), by_name);
+
+    return true;
+} // TreeIndex::visit_
+
+
+void
+TreeIndex::collect_ (vector<string> queue, bool recursive, unsigned int threads, Folders& fresh,
+                     vector<string>* subdirectories)
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t active = 0;
+
+    auto worker = [&] () {
+        Folders local;
+        vector<string> found;
+
+        std::unique_lock lock (mutex);
+
+        while (true) {
+            cv.wait (lock, [&] { return !queue.empty() || active == 0; });
+
+            if (queue.empty()) {
+                break;
+            }
+
+            // depth first keeps the queue short on wide trees.
+            auto directory = std::move (queue.back());
+            queue.pop_back();
+            ++active;
+
+            lock.unlock();
+            Folder folder;
+            if (visit_ (directory, folder, found)) {
+                local.emplace (std::move (directory), std::move (folder));
+            }
+            lock.lock();
+
+            --active;
+
+            if (recursive) {
+                queue.insert (queue.end(), std::make_move_iterator (found.begin()), std::make_move_iterator (found.end()));
+            }
+            else if (subdirectories != nullptr) {
+                subdirectories->insert (subdirectories->end(), std::make_move_iterator (found.begin()),
+                                        std::make_move_iterator (found.end()));
+            }
+
+            if ((recursive && !found.empty()) || (queue.empty() && active == 0)) {
+                cv.notify_all();
+            }
+
+            found.clear();
+        }
+
+        fresh.merge (local);
+    };
+
+    // a single shallow listing is not worth a thread.
+    auto count = recursive ? pool_size (threads) : std::min<size_t> (pool_size (threads), queue.size());
+    vector<std::thread> pool;
+
+    for (size_t i = 1; i < count; ++i) {
+        pool.emplace_back (worker);
+    }
+
+    worker();
+
+    for (auto& thread : pool) {
+        thread.join();
+    }
+} // TreeIndex::collect_
+
+
+void
+TreeIndex::compare_ (const string& directory, const Folder& folder, vector<string>& changed) const
+{
+    auto it = directories_.find (directory);
+
+    if (it == directories_.end()) {
+        for (const auto& [name, info] : folder.files) {
+            auto path = join_path (directory, name);
+            const auto* indexed = files_.empty() ? nullptr : find_ (path);
+
+            if (indexed == nullptr || !(*indexed == info)) {
+                changed.push_back (std::move (path));
+            }
+        }
+        return;
+    }
+
+    // both sides are sorted by name.
+    const auto& indexed = it->second.files;
+    auto old = indexed.begin();
+
+    for (const auto& [name, info] : folder.files) {
+        while (old != indexed.end() && old->first < name) {
+            ++old;
+        }
+
+        if (old == indexed.end() || old->first != name || !(old->second == info)) {
+            changed.push_back (join_path (directory, name));
+        }
+    }
+} // TreeIndex::compare_
+
+
+void
+TreeIndex::forget_ (const string& root)
+{
+    directories_.erase (root);
+
+    auto prefix = root.back() == '/' ? root : root + "/";
+
+    for (auto it = directories_.lower_bound (prefix); it != directories_.end() && it->first.starts_with (prefix);) {
+        it = directories_.erase (it);
+    }
+} // TreeIndex::forget_
+
+
+const TreeIndex::FileInfo*
+TreeIndex::find_ (const string& path) const
+{
+    if (auto it = files_.find (path); it != files_.end()) {
+        return &it->second;
+    }
+
+    auto [directory, name] = split_path (path);
+    auto folder = directories_.find (directory);
+
+    if (folder == directories_.end()) {
+        return nullptr;
+    }
+
+    const auto& files = folder->second.files;
+    auto it = std::lower_bound (files.begin(), files.end(), pair<string, FileInfo>{name, {}}, by_name);
+
+    return it != files.end() && it->first == name ? &it->second : nullptr;
+} // TreeIndex::find_
+
+
+void
+TreeIndex::put_ (const string& path, const FileInfo* info)
+{
+    auto [directory, name] = split_path (path);
+    auto folder = directories_.find (directory);
+
+    if (folder == directories_.end()) {
+        if (info != nullptr) {
+            files_[path] = *info;
+        }
+        else {
+            files_.erase (path);
+        }
+        return;
+    }
+
+    auto& files = folder->second.files;
+    auto it = std::lower_bound (files.begin(), files.end(), pair<string, FileInfo>{name, {}}, by_name);
+    bool found = it != files.end() && it->first == name;
+
+    if (info == nullptr) {
+        if (found) {
+            files.erase (it);
+        }
+    }
+    else if (found) {
+        it->second = *info;
+    }
+    else {
+        files.emplace (it, std::move (name), *info);
+    }
+} // TreeIndex::put_
+} // namespace daisychain
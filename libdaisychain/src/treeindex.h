@@ -0,0 +1,126 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+
+namespace daisychain {
+using namespace std;
+
+
+// The files and directories under a set of roots, with the size, mtime and inode of each as of
+// the last scan. Scans walk a tree with a pool of threads. A scan replaces what the index held
+// under its root and reports the files that are new or changed, which is what a watch that lost
+// events has missed. Files are kept by name under their directory, so a large tree costs little
+// more than its names and a directory can be rescanned on its own.
+class TreeIndex
+{
+public:
+    enum class EntryType : uint8_t { FILE, DIRECTORY, SYMLINK, UNKNOWN };
+
+    struct Entry
+    {
+        string name;
+        EntryType type;
+    };
+
+    struct FileInfo
+    {
+        uint64_t size = 0;
+        int64_t mtime = 0;      // nanoseconds since the epoch
+        uint64_t inode = 0;
+        uint64_t device = 0;
+
+        bool operator== (const FileInfo&) const = default;
+    };
+
+    // reads one directory, without "." and "..". info, when given, describes the directory itself.
+    static bool List (const string& directory, vector<Entry>& entries, FileInfo* info = nullptr);
+
+    // does not follow symlinks; false if the path is gone.
+    static bool Stat (const string& path, FileInfo& info, EntryType* type = nullptr);
+
+    // walks root, or only its entries unless recursive. Files that are new or changed since the
+    // last scan are appended to changed; without recursive, root's subdirectories go to
+    // subdirectories.
+    void Scan (const string& root, bool recursive, unsigned int threads, vector<string>* changed = nullptr,
+               vector<string>* subdirectories = nullptr);
+
+    // Scan without recursive for several directories at once. A directory that is gone leaves
+    // the index together with everything below it.
+    void Rescan (const vector<string>& directories, unsigned int threads, vector<string>* changed = nullptr,
+                 vector<string>* subdirectories = nullptr);
+
+    // records the current state of one file, or forgets it if it is gone.
+    void Update (const string& path);
+
+    // drops one file, so that the next scan reports it as new.
+    void Erase (const string& path) { put_ (path, nullptr); }
+
+    // indexed directories that changed or are gone since they were scanned, sorted.
+    void Stale (unsigned int threads, vector<string>& directories) const;
+
+    // indexed directories at or under root.
+    void Directories (const string& root, vector<pair<string, FileInfo>>& directories) const;
+
+    // writes the index to a file, which is replaced only once the new one is complete.
+    bool Save (const string& path) const;
+
+    // replaces the index with one written by Save(). False if the file is missing or damaged,
+    // and the index is then left empty.
+    bool Load (const string& path);
+
+    // drops whatever is not at or under one of roots.
+    void Retain (const vector<string>& roots);
+
+    [[nodiscard]] bool contains (const string& path) const;
+
+    void Clear();
+
+    [[nodiscard]] size_t file_count() const;
+
+    [[nodiscard]] size_t directory_count() const { return directories_.size(); }
+
+private:
+    // sorted by name.
+    using Files = vector<pair<string, FileInfo>>;
+
+    // a directory as of its last listing, and the files in it.
+    struct Folder
+    {
+        FileInfo info;
+        Files files;
+    };
+
+    using Folders = std::map<string, Folder>;
+
+    // lists one directory; its subdirectories go to subdirectories.
+    static bool visit_ (const string& directory, Folder& folder, vector<string>& subdirectories);
+
+    // lists directories with a pool of threads, and everything below them if recursive.
+    static void collect_ (vector<string> queue, bool recursive, unsigned int threads, Folders& fresh,
+                          vector<string>* subdirectories);
+
+    // appends the files in folder that are new or changed compared to the index.
+    void compare_ (const string& directory, const Folder& folder, vector<string>& changed) const;
+
+    // drops a directory and everything below it.
+    void forget_ (const string& root);
+
+    [[nodiscard]] const FileInfo* find_ (const string& path) const;
+
+    // records a file, or forgets it without info.
+    void put_ (const string& path, const FileInfo* info);
+
+    Folders directories_;
+    // files indexed on their own, outside any indexed directory.
+    std::map<string, FileInfo> files_;
+};
+} // namespace daisychain
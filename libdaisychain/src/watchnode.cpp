@@ -4,8 +4,10 @@
 // See LICENSE file for full license text.
 
 #include "watchnode.h"
+#include <algorithm>
 #include <filesystem>
 #include <cerrno>
+#include <unordered_set>
 
 
 namespace daisychain {
@@ -15,7 +17,15 @@ using namespace filesystem;
 
 WatchNode::WatchNode() :
     passthru_ (false),
-    recursive_ (false)
+    recursive_ (false),
+    quiescence_ (200),
+    debounce_ (2000),
+    settle_ (0),
+    max_pending_ (65536),
+    threads_ (0),
+    backend_ ("auto"),
+    interval_ (5000),
+    max_interval_ (60000)
 {
     type_ = DaisyNodeType::DC_WATCH;
     batch_ = true;
@@ -42,6 +52,46 @@ WatchNode::Initialize (json& keydata, bool keep_uuid)
     if (data.count ("recursive")) {
         set_recursive (data["recursive"]);
     }
+
+    if (data.count ("quiescence")) {
+        set_quiescence (data["quiescence"]);
+    }
+
+    if (data.count ("debounce")) {
+        set_debounce (data["debounce"]);
+    }
+
+    if (data.count ("settle")) {
+        set_settle (data["settle"]);
+    }
+
+    if (data.count ("marker")) {
+        set_marker (data["marker"]);
+    }
+
+    if (data.count ("max_pending")) {
+        set_max_pending (data["max_pending"]);
+    }
+
+    if (data.count ("threads")) {
+        set_threads (data["threads"]);
+    }
+
+    if (data.count ("backend")) {
+        set_backend (data["backend"]);
+    }
+
+    if (data.count ("interval")) {
+        set_interval (data["interval"]);
+    }
+
+    if (data.count ("max_interval")) {
+        set_max_interval (data["max_interval"]);
+    }
+
+    if (data.count ("state")) {
+        set_state (data["state"]);
+    }
 } // WatchNode::Initialize
 
 
@@ -53,33 +103,80 @@ WatchNode::Execute (vector<string>& inputs, const string& sandbox, json& vars)
 
     LINFO << "Executing " << (isroot_ ? "root: " : "node: ") << name_;
 
+    // downstream of other nodes, the paths to watch arrive as a batch list.
+    if (!batchfile_.empty()) {
+        inputs.clear();
+        BatchSpool::Read (batchfile_, inputs);
+    }
+
     if (!InitNotify()) {
         return false;
     }
 
+    // while polling, a changed path waits for a later poll that finds it unchanged.
+    bool polling = backend_ == "poll";
+    auto quiescence = polling ? std::max (quiescence_, interval_) : quiescence_;
+
+    queue_ = PathQueue (std::chrono::milliseconds (quiescence), std::chrono::milliseconds (debounce_),
+                        max_pending_);
+    settling_ = SettleWheel (std::chrono::milliseconds (settle_), marker_, std::chrono::steady_clock::now());
+
+    // outputs stay open while watching; passthru and events are written as they come.
+    OpenOutputs (sandbox);
+
+    // the watches are set up against the saved index, so only what changed since is sent.
+    resumed_ = !state_.empty() && index_.Load (state_);
+    LINFO_IF (resumed_) << LOGNODE << "Resuming from " << state_ << ": " << index_.file_count() << " files.";
+    LWARN_IF (!state_.empty() && !resumed_ && exists (filesystem::path (state_)))
+        << LOGNODE << "Cannot read saved state: " << state_;
+
+    vector<string> roots;
+
     for (auto& input : inputs) {
         if (input != "EOF") {
-            if (!Notify (sandbox, input)) {
+            input.resize (token_path (input).size());
+            roots.push_back (input);
+            if (!(polling ? snapshot_ (input) : Notify (input))) {
                 stat = false;
             }
         }
     }
 
+    if (resumed_) {
+        // paths watched in an earlier run but not now.
+        index_.Retain (roots);
+        resumed_ = false;
+    }
+    saved_ = std::chrono::steady_clock::now();
+
     if (stat) {
         if (!test_) {
             if (!inputs.empty() && inputs[inputs.size() - 1] == "EOF") {
                 inputs.pop_back();
             }
 
-            Monitor (sandbox);
+            if (polling) {
+                Poll();
+            }
+            else {
+                Monitor();
+            }
         }
 
+        checkpoint_ (true);
+
         RemoveWatches();
-        OpenOutputs (sandbox);
         WriteOutputs ("EOF");
         CloseOutputs();
+        Stats();
         Reset();
     }
+    else {
+        // nothing is watched; let the rest of the graph finish.
+        RemoveWatches();
+        WriteOutputs ("EOF");
+        CloseOutputs();
+    }
 
     return stat;
 } // WatchNode::Execute
@@ -92,6 +189,16 @@ WatchNode::Serialize()
     auto json = Node::Serialize();
     json[id_]["passthru"] = passthru_;
     json[id_]["recursive"] = recursive_;
+    json[id_]["quiescence"] = quiescence_;
+    json[id_]["debounce"] = debounce_;
+    json[id_]["settle"] = settle_;
+    json[id_]["marker"] = marker_;
+    json[id_]["max_pending"] = max_pending_;
+    json[id_]["threads"] = threads_;
+    json[id_]["backend"] = backend_;
+    json[id_]["interval"] = interval_;
+    json[id_]["max_interval"] = max_interval_;
+    json[id_]["state"] = state_;
 
     return json;
 } // WatchNode::Serialize
@@ -107,10 +214,304 @@ WatchNode::Cleanup()
 } // WatchNode::Cleanup
 
 
+// how often the saved state is brought up to date while the node runs.
+#define STATE_INTERVAL std::chrono::seconds (60)
+
+
+void
+WatchNode::Stats()
+{
+    LINFO << LOGNODE << "events merged: " << queue_.merged() << ", events dropped: " << queue_.dropped();
+    LINFO_IF (settling_.active()) << LOGNODE << "paths settled: " << settling_.settled()
+                                  << ", released by marker: " << settling_.marked();
+    LINFO_IF (polls_) << LOGNODE << "polls: " << polls_ << ", files indexed: " << index_.file_count()
+                      << ", folders: " << index_.directory_count();
+    Node::Stats();
+} // WatchNode::Stats
+
+
+#ifndef _WIN32
+bool
+WatchNode::snapshot_ (const string& path)
+{
+    std::error_code ec;
+    auto status = filesystem::status (path, ec);
+
+    if (ec || !exists (status)) {
+        LERROR << LOGNODE << "Cannot poll: " << path;
+        return false;
+    }
+
+    vector<string> found;
+    auto due = std::chrono::steady_clock::now() + std::chrono::milliseconds (interval_);
+
+    if (is_directory (status)) {
+        vector<pair<string, TreeIndex::FileInfo>> folders;
+        index_.Scan (path, recursive_, threads_, recursive_ || resumed_ ? &found : nullptr);
+        index_.Directories (path, folders);
+
+        for (const auto& folder : folders) {
+            schedule_[folder.first] = {due, 0};
+        }
+    }
+    else {
+        index_.Scan (path, false, threads_, resumed_ ? &found : nullptr);
+        polled_files_.push_back (path);
+
+        if (!resumed_) {
+            found.push_back (path);
+        }
+    }
+
+    LDEBUG << "Polling " << path << ": " << index_.file_count() << " files indexed.";
+
+    // All files found should pass through the graph initially.
+    if (passthru_ || resumed_) {
+        WriteTokens (found);
+        sent_ (found, false);
+    }
+
+    return true;
+} // WatchNode::snapshot_
+
+
+void
+WatchNode::Poll()
+{
+    auto interval = std::chrono::milliseconds (interval_);
+    auto next = std::chrono::steady_clock::now() + interval;
+    vector<string> changed;
+    vector<string> ready;
+
+    // runs until cancelled; Cancel() ends the wait. Sleeps until the next poll or until the
+    // oldest pending path has been quiet long enough.
+    while (!terminate_.load() && !cancelled_.load()) {
+        auto now = std::chrono::steady_clock::now();
+
+        if (now >= next) {
+            poll_ (now, changed);
+
+            // the next poll is counted from the end of this one, so a slow scan does not run
+            // back to back.
+            now = std::chrono::steady_clock::now();
+            next = now + interval;
+
+            for (const auto& path : changed) {
+                queue_.Push (path, now);
+            }
+            changed.clear();
+        }
+
+        // poll_() has indexed these already.
+        queue_.Pop (now, ready);
+        hold_ (now, ready);
+        WriteTokens (ready);
+        sent_ (ready, false);
+        unsaved_ += ready.size();
+        ready.clear();
+
+        checkpoint_ (false);
+
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds> (next - now);
+        if (auto timeout = timeout_ (now); timeout >= 0) {
+            wait = std::min (wait, std::chrono::milliseconds (timeout));
+        }
+
+        std::unique_lock lock (poll_mutex_);
+        poll_cv_.wait_for (lock, wait, [this] { return cancelled_.load() || terminate_.load(); });
+    }
+
+    // whatever is still waiting goes out before EOF; after Cancel() it is left for the next run.
+    drain_ (ready);
+    WriteTokens (ready);
+    sent_ (ready, false);
+} // WatchNode::Poll
+
+
+void
+WatchNode::poll_ (std::chrono::steady_clock::time_point now, vector<string>& changed)
+{
+    ++polls_;
+
+    // A folder's own mtime moves when entries are added, removed or renamed, so every folder
+    // costs one stat per poll. Files written in place show only in their own stat; a folder's
+    // files are checked on a schedule that backs off while nothing in it changes.
+    vector<string> folders;
+    index_.Stale (threads_, folders);
+    auto stale = folders.size();
+
+    for (const auto& [folder, schedule] : schedule_) {
+        if (schedule.due <= now) {
+            folders.push_back (folder);
+        }
+    }
+
+    std::sort (folders.begin(), folders.end());
+    folders.erase (std::unique (folders.begin(), folders.end()), folders.end());
+
+    vector<string> subdirectories;
+    index_.Rescan (folders, threads_, &changed, &subdirectories);
+
+    auto interval = std::chrono::milliseconds (interval_);
+    auto max_interval = std::max (std::chrono::milliseconds (max_interval_), interval);
+
+    // folders that appeared are indexed whole; what is in them is new.
+    if (recursive_) {
+        for (const auto& subdirectory : subdirectories) {
+            if (!index_.contains (subdirectory)) {
+                vector<pair<string, TreeIndex::FileInfo>> added;
+                index_.Scan (subdirectory, true, threads_, &changed);
+                index_.Directories (subdirectory, added);
+
+                for (const auto& folder : added) {
+                    schedule_[folder.first] = {now + interval, 0};
+                }
+            }
+        }
+    }
+
+    for (const auto& path : polled_files_) {
+        index_.Scan (path, false, threads_, &changed);
+    }
+
+    std::unordered_set<string> active;
+    for (const auto& path : changed) {
+        active.insert (path.substr (0, std::max<size_t> (path.rfind ('/'), 1)));
+    }
+
+    for (const auto& folder : folders) {
+        if (!index_.contains (folder)) {
+            schedule_.erase (folder);
+            continue;
+        }
+
+        auto& schedule = schedule_[folder];
+        schedule.quiet = active.count (folder) ? 0 : std::min (schedule.quiet + 1, 16u);
+
+        // up to a quarter longer per folder, so folders scanned together drift out of step and
+        // a large tree is not rescanned in one go.
+        auto wait = std::min<std::chrono::milliseconds> (interval * (1 << schedule.quiet), max_interval);
+        schedule.due = now + wait + wait * (std::hash<string>{} (folder) % 256) / 1024;
+    }
+
+    LDEBUG << "Poll " << polls_ << ": " << stale << " folders changed, " << folders.size() << " rescanned, "
+           << changed.size() << " files changed.";
+} // WatchNode::poll_
+#endif
+
+
+void
+WatchNode::wake_()
+{
+    // taken so that a Poll() about to wait sees the flag before it sleeps.
+    {
+        std::lock_guard lock (poll_mutex_);
+    }
+    poll_cv_.notify_all();
+} // WatchNode::wake_
+
+
+void
+WatchNode::checkpoint_ (bool force)
+{
+    if (state_.empty()) {
+        return;
+    }
+
+    // a path still waiting to be sent is already in the index; a save now would lose it if the
+    // node stopped before sending it.
+    auto now = std::chrono::steady_clock::now();
+
+    if (!force && (unsaved_ == 0 || now - saved_ < STATE_INTERVAL || timeout_ (now) >= 0)) {
+        return;
+    }
+
+    if (index_.Save (state_)) {
+        LDEBUG << "Saved " << index_.file_count() << " files to " << state_;
+        unsaved_ = 0;
+    }
+    else {
+        LWARN << LOGNODE << "Cannot save state: " << state_;
+    }
+
+    saved_ = now;
+} // WatchNode::checkpoint_
+
+
+void
+WatchNode::hold_ (std::chrono::steady_clock::time_point now, vector<string>& ready)
+{
+    if (!settling_.active()) {
+        return;
+    }
+
+    vector<string> quiet;
+    quiet.swap (ready);
+
+    for (const auto& path : quiet) {
+        if (!settling_.Mark (path, ready)) {
+            settling_.Add (path, now, ready);
+        }
+    }
+
+    settling_.Advance (now, ready);
+} // WatchNode::hold_
+
+
+void
+WatchNode::drain_ (vector<string>& ready)
+{
+    vector<string> pending;
+    queue_.Drain (pending);
+
+    for (auto& path : pending) {
+        if (!settling_.Mark (path, ready)) {
+            ready.push_back (std::move (path));
+        }
+    }
+
+    // files that never settled still go out; the node is stopping.
+    settling_.Drain (ready);
+} // WatchNode::drain_
+
+
+void
+WatchNode::sent_ (const vector<string>& paths, bool update)
+{
+    if (cancelled_.load()) {
+        for (const auto& path : paths) {
+            index_.Erase (path);
+        }
+    }
+    else if (update) {
+        for (const auto& path : paths) {
+            index_.Update (path);
+        }
+    }
+} // WatchNode::sent_
+
+
+int
+WatchNode::timeout_ (std::chrono::steady_clock::time_point now) const
+{
+    auto queued = queue_.timeout (now);
+    auto settling = settling_.timeout (now);
+
+    if (queued < 0 || settling < 0) {
+        return std::max (queued, settling);
+    }
+
+    return std::min (queued, settling);
+} // WatchNode::timeout_
+
+
 #ifdef __APPLE__
 #include <fcntl.h>
 #include <sys/event.h>
 
+// user event that wakes Monitor() when the node is cancelled.
+#define STOP_IDENT 1
+
 
 bool
 WatchNode::InitNotify()
@@ -124,6 +525,13 @@ WatchNode::InitNotify()
         stat = false;
     }
     else {
+        struct kevent kev{};
+        EV_SET (&kev, STOP_IDENT, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+
+        if (kevent (notify_fd_, &kev, 1, nullptr, 0, nullptr) == -1) {
+            LERROR << "Failed to add the stop event to kqueue.";
+            stat = false;
+        }
         LDEBUG << "kqueue initialized.";
     }
 
@@ -131,11 +539,33 @@ WatchNode::InitNotify()
 } // WatchNode::InitNotify
 
 
+void
+WatchNode::Cancel()
+{
+    Node::Cancel();
+    wake_();
+
+    if (notify_fd_ != -1) {
+        struct kevent kev{};
+        EV_SET (&kev, STOP_IDENT, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+        kevent (notify_fd_, &kev, 1, nullptr, 0, nullptr);
+    }
+} // WatchNode::Cancel
+
+
 bool
-WatchNode::Notify (const string& sandbox, const string& path)
+WatchNode::Notify (const string& path)
 {
     bool stat = true;
 
+    // kqueue needs no index; it is kept only for the saved state.
+    if (!state_.empty()) {
+        vector<string> changed;
+        index_.Scan (path, recursive_, threads_, resumed_ ? &changed : nullptr);
+        WriteTokens (changed);
+        sent_ (changed, false);
+    }
+
     std::vector<string> paths;
     paths.push_back (path);
 
@@ -168,10 +598,8 @@ WatchNode::Notify (const string& sandbox, const string& path)
             stat = false;
             LDEBUG << "Watch failed on: " << input;
         }
-        else if (passthru_ && is_regular_file (filesystem::path (input))) {
-            OpenOutputs (sandbox);
+        else if (passthru_ && !resumed_ && is_regular_file (filesystem::path (input))) {
             WriteOutputs (input);
-            CloseOutputs();
         }
     }
 
@@ -180,84 +608,104 @@ WatchNode::Notify (const string& sandbox, const string& path)
 
 
 void
-WatchNode::Monitor (const string& sandbox)
+WatchNode::Monitor()
 {
-    int numevents = -1;
-    struct kevent event{};
+    struct kevent events[64];
+    vector<string> ready;
+    bool stop = false;
 
-    // must be stopped with a SIGINT (ctrl-c).
-    while (true) {
-        numevents = kevent (notify_fd_, nullptr, 0, &event, 1, nullptr);
-        LDEBUG << "Num events: " << numevents;
-        if (numevents == -1) {
-            continue;
+    // runs until cancelled; Cancel() triggers the user event to end the wait.
+    while (!stop && !terminate_.load() && !cancelled_.load()) {
+        auto wait = timeout_ (std::chrono::steady_clock::now());
+        struct timespec timeout{wait / 1000, (wait % 1000) * 1000000L};
+
+        int numevents = kevent (notify_fd_, nullptr, 0, events, 64, wait < 0 ? nullptr : &timeout);
+
+        if (numevents == -1 && errno != EINTR) {
+            LERROR << LOGNODE << "kevent failed: " << strerror (errno);
+            break;
         }
 
-        string path = watch_fd_map_[static_cast<int> (event.ident)];
-        auto fs_path = filesystem::path (path);
+        LDEBUG_IF (numevents > 0) << "Num events: " << numevents;
+        auto now = std::chrono::steady_clock::now();
 
-        if (is_directory (fs_path) && recursive_) {
-            // New directory notification (add subdirectories to watch)
-            std::vector<string> newpaths;
-            for (const auto& comp : recursive_directory_iterator (path)) {
-                newpaths.push_back (comp.path());
-            }
-            if (newpaths.empty()) {
-                continue;
+        for (int i = 0; i < numevents; ++i) {
+            const auto& event = events[i];
+
+            if (event.filter == EVFILT_USER) {
+                stop = true;
+                break;
             }
-            for (auto& newpath : newpaths) {
-                bool found = false;
-                for (auto& fit : watch_fd_map_) {
-                    if (fit.second == newpath) {
-                        found = true;
-                        break;
-                    }
+
+            string path = watch_fd_map_[static_cast<int> (event.ident)];
+            auto fs_path = filesystem::path (path);
+
+            if (is_directory (fs_path) && recursive_) {
+                // New directory notification (add subdirectories to watch)
+                std::vector<string> newpaths;
+                for (const auto& comp : recursive_directory_iterator (path)) {
+                    newpaths.push_back (comp.path());
                 }
-                if (!found) {
-                    LDEBUG << "New file: " << newpath;
-                    Notify (sandbox, newpath);
+                for (auto& newpath : newpaths) {
+                    bool found = false;
+                    for (auto& fit : watch_fd_map_) {
+                        if (fit.second == newpath) {
+                            found = true;
+                            break;
+                        }
+                    }
+                    if (!found) {
+                        LDEBUG << "New file: " << newpath;
+                        Notify (newpath);
+                    }
                 }
             }
-        }
-        else {
-            bool transmit = false;
+            else {
+                bool transmit = false;
 
-            if (event.fflags & NOTE_WRITE) {
-                LDEBUG << "Written: " << path;
-                transmit = true;
-            }
-            else if (event.fflags & NOTE_DELETE || event.fflags & NOTE_RENAME) {
-                close (static_cast<int> (event.ident));
-                watch_fd_map_.erase (static_cast<int> (event.ident));
-                if (std::filesystem::exists (fs_path)) {
-                    Notify (sandbox, path);
-                    if (!passthru_) {
-                        transmit = true;
+                if (event.fflags & NOTE_WRITE) {
+                    LDEBUG << "Written: " << path;
+                    transmit = true;
+                }
+                else if (event.fflags & NOTE_DELETE || event.fflags & NOTE_RENAME) {
+                    close (static_cast<int> (event.ident));
+                    watch_fd_map_.erase (static_cast<int> (event.ident));
+                    if (std::filesystem::exists (fs_path)) {
+                        Notify (path);
+                        if (!passthru_) {
+                            transmit = true;
+                        }
+                    }
+                    else {
+                        LDEBUG << "File renamed or deleted: " << path;
                     }
                 }
-                else {
-                    LDEBUG << "File renamed or deleted: " << path;
+                else if (event.fflags & NOTE_FUNLOCK) {
+                    LDEBUG << "File Closed: " << path;
+                    transmit = true;
                 }
-            }
-            else if (event.fflags & NOTE_FUNLOCK) {
-                LDEBUG << "File Closed: " << path;
-                transmit = true;
-            }
-
-            if (transmit) {
-                // Time-based filtering of duplicates
-                auto now = std::chrono::steady_clock::now();
-                auto it = notifications_.find (path);
 
-                if (it == notifications_.end() || (now - it->second) >= debounce_time) {
-                    notifications_[path] = now;
-                    OpenOutputs (sandbox);
-                    WriteOutputs (path);
-                    CloseOutputs();
+                if (transmit) {
+                    queue_.Push (path, now);
                 }
             }
         }
+
+        now = std::chrono::steady_clock::now();
+        queue_.Pop (now, ready);
+        hold_ (now, ready);
+        WriteTokens (ready);
+        sent_ (ready, !state_.empty());
+        unsaved_ += ready.size();
+        ready.clear();
+
+        checkpoint_ (false);
     }
+
+    // whatever is still waiting goes out before EOF; after Cancel() it is left for the next run.
+    drain_ (ready);
+    WriteTokens (ready);
+    sent_ (ready, !state_.empty());
 } // WatchNode::Monitor
 
 
@@ -273,18 +721,42 @@ WatchNode::RemoveWatches()
 
 
 void
-WatchNode::RemoveMonitor() const
+WatchNode::RemoveMonitor()
 {
+    if (notify_fd_ != -1) {
+        close (notify_fd_);
+    }
+    notify_fd_ = -1;
 } // WatchNode::RemoveMonitor
 
 #endif
 
 
 #ifdef __linux__
+#include <atomic>
 #include <climits>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/fanotify.h>
 #include <sys/inotify.h>
+#include <sys/statfs.h>
 #include <unistd.h>
 
+// directories with events this recently are rescanned after a queue overflow.
+#define HOT_WINDOW std::chrono::seconds (60)
+
+// only what Monitor() acts on, so busy trees do not fill the queue with opens and reads.
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO)
+
+// the same events for a fanotify file system mark; FAN_ONDIR reports new folders too.
+#define FANOTIFY_MASK (FAN_CLOSE_WRITE | FAN_CREATE | FAN_MOVED_TO | FAN_ONDIR)
+
+// resolved directory handles kept before the cache starts over.
+#define HANDLE_CACHE 65536
+
 
 bool
 WatchNode::InitNotify()
@@ -292,175 +764,729 @@ WatchNode::InitNotify()
     bool stat = true;
 
     notify_fd_ = inotify_init1 (IN_CLOEXEC);
+    stop_fd_ = eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK);
 
-    if (notify_fd_ == -1) {
+    if (backend_ != "auto" && backend_ != "inotify" && backend_ != "fanotify" && backend_ != "poll") {
+        LERROR << LOGNODE << "Unknown backend: " << backend_;
+        stat = false;
+    }
+    else if (notify_fd_ == -1) {
         LERROR << "Failed to initialize inotify instance.";
         stat = false;
     }
+    else if (stop_fd_ == -1) {
+        LERROR << "Failed to create the stop eventfd.";
+        stat = false;
+    }
     else {
         LDEBUG << "inotify initialized.";
     }
 
+    // fanotify reports a whole file system from one mark, so large trees need no per-folder
+    // watches. It needs CAP_SYS_ADMIN; without it inotify is used.
+    if (stat && (backend_ == "fanotify" || (backend_ == "auto" && recursive_))) {
+#ifdef FAN_REPORT_DFID_NAME
+        fanotify_fd_ = fanotify_init (FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FAN_REPORT_DFID_NAME,
+                                      O_RDONLY | O_LARGEFILE);
+
+        if (fanotify_fd_ == -1) {
+            LWARN_IF (backend_ == "fanotify") << LOGNODE << "fanotify unavailable (" << strerror (errno)
+                                              << "); using inotify.";
+            LDEBUG_IF (backend_ == "auto") << "fanotify unavailable: " << strerror (errno);
+        }
+        else {
+            LDEBUG << "fanotify initialized.";
+        }
+#else
+        LWARN_IF (backend_ == "fanotify") << LOGNODE << "fanotify is not supported by this build; using inotify.";
+#endif
+    }
+
+    // every watched directory takes one of the user's watches.
+    std::ifstream limit ("/proc/sys/fs/inotify/max_user_watches");
+    if (!(limit >> watch_limit_)) {
+        watch_limit_ = 0;
+    }
+    LDEBUG << "inotify watch limit: " << watch_limit_;
+
     return stat;
 } // WatchNode::InitNotify
 
 
+void
+WatchNode::Cancel()
+{
+    Node::Cancel();
+    wake_();
+
+    if (stop_fd_ != -1) {
+        uint64_t one = 1;
+        [[maybe_unused]] auto numbytes = write (stop_fd_, &one, sizeof (one));
+    }
+} // WatchNode::Cancel
+
+
+namespace {
+// explains a failed inotify_add_watch.
+void
+log_watch_error (const string& path, int error)
+{
+    LERROR << "Watch failed on: " << path;
+
+    // Lifted right from the man pages.
+    switch (error) {
+    case EACCES:
+        LERROR << "Read access to the given file is not permitted.";
+        break;
+    case EBADF:
+        LERROR << "The given file descriptor is not valid.";
+        break;
+    case EEXIST:
+        LERROR << "Mask contains IN_MASK_CREATE and pathname refers "
+                  "to a file already being watched by the same fd.";
+        break;
+    case EFAULT:
+        LERROR << "Pathname points outside of the process's accessible address space.";
+        break;
+    case EINVAL:
+        LERROR << "The given event mask contains no valid events; or mask contains "
+                  "both IN_MASK_ADD and IN_MASK_CREATE; or fd is not an inotify file "
+                  "descriptor.";
+        break;
+    case ENAMETOOLONG:
+        LERROR << "Pathname is too long.";
+        break;
+    case ENOENT:
+        LERROR << "A directory component in pathname does not exist or is a dangling "
+                  "symbolic link.";
+        break;
+    case ENOMEM:
+        LERROR << "Insufficient kernel memory was available.";
+        break;
+    case ENOSPC:
+        LERROR << "The user limit on the total number of inotify watches was reached "
+                  "or the kernel failed to allocate a needed resource.";
+        break;
+    case ENOTDIR:
+        LERROR << "Mask contains IN_ONLYDIR and pathname is not a directory.";
+        break;
+    }
+} // log_watch_error
+
+
+// statfs and fanotify describe the same 64 bit file system id with different types.
+template <typename T>
+uint64_t
+fsid_key (const T& fsid)
+{
+    static_assert (sizeof (T) == sizeof (uint64_t));
+    uint64_t key;
+    std::memcpy (&key, &fsid, sizeof (key));
+    return key;
+} // fsid_key
+
+
+string
+strip_separators (string path)
+{
+    while (path.size() > 1 && path.back() == '/') {
+        path.pop_back();
+    }
+
+    return path;
+} // strip_separators
+} // namespace
+
+
 bool
-WatchNode::Notify (const string& sandbox, const string& path)
+WatchNode::Notify (const string& path)
 {
-    bool stat = true;
+    vector<string> found;
+    bool stat = fanotify_fd_ != -1 ? mark_ (path, found) : watch_ (path, found);
 
-    std::vector<string> paths;
-    paths.push_back (path);
+    // All files found should pass through the graph initially.
+    if (stat && (passthru_ || resumed_)) {
+        WriteTokens (found);
+        sent_ (found, false);
+    }
 
-    // If path specified is a directory, then traverse and find all files and folders.
-    auto fs_path = filesystem::path (path);
-    if (recursive_ && is_directory (fs_path)) {
-        for (const auto& comp: recursive_directory_iterator (path)) {
-            paths.push_back (comp.path());
+    return stat;
+} // WatchNode::Notify
+
+
+bool
+WatchNode::watch_ (const string& path, vector<string>& found)
+{
+    // A directory tree is scanned in parallel and all of its folders are watched. Otherwise the
+    // path is a single file or folder and gets an explicit watch.
+    if (recursive_ && is_directory (filesystem::path (path))) {
+        return watch_tree_ (path, found);
+    }
+
+    vector<string> stale;
+    index_.Scan (path, false, threads_, resumed_ ? &found : nullptr);
+    bool stat = add_watches_ ({{path, {}}}, stale);
+
+    if (!resumed_ && is_regular_file (filesystem::path (path))) {
+        found.push_back (path);
+    }
+
+    return stat;
+} // WatchNode::watch_
+
+
+bool
+WatchNode::watch_tree_ (const string& root, vector<string>& found)
+{
+    vector<string> roots{root};
+    auto first = found.size();
+
+    // a directory that changed between its scan and its watch is scanned again; anything after
+    // the watch is reported by inotify.
+    for (int round = 0; !roots.empty() && round < 3; ++round) {
+        vector<pair<string, TreeIndex::FileInfo>> directories;
+        vector<string> stale;
+
+        for (const auto& directory : roots) {
+            index_.Scan (directory, true, threads_, &found);
+            index_.Directories (directory, directories);
+        }
+
+        if (!add_watches_ (directories, stale)) {
+            return false;
         }
+
+        roots.swap (stale);
     }
 
-    for (const auto& input : paths) {
-        fs_path = filesystem::path (input);
+    std::sort (found.begin() + first, found.end());
+    found.erase (std::unique (found.begin() + first, found.end()), found.end());
 
-        // If paths.size() > 1 then we traversed a hierarchy. We only want to set watches on folders
-        // when dealing with a traversal. Otherwise, if paths.size() == 1 then we're dealing with a
-        // single file and want to set an explicit watch on it.
-        if (is_directory (fs_path) || paths.size() == 1) {
-            int watch_fd_ = inotify_add_watch (notify_fd_, input.c_str(), IN_ALL_EVENTS);
+    return true;
+} // WatchNode::watch_tree_
 
-            if (watch_fd_ != -1) {
-                watch_fd_map_[watch_fd_] = input;
-                LDEBUG << "Added watch on: " << input;
-            }
-            else {
-                stat = false;
-                LERROR << "Watch failed on: " << input;
-
-                // Lifted right from the man pages.
-                switch (errno) {
-                case EACCES:
-                    LERROR << "Read access to the given file is not permitted.";
-                    break;
-                case EBADF:
-                    LERROR << "The given file descriptor is not valid.";
-                    break;
-                case EEXIST:
-                    LERROR << "Mask contains IN_MASK_CREATE and pathname refers "
-                              "to a file already being watched by the same fd.";
-                    break;
-                case EFAULT:
-                    LERROR << "Pathname points outside of the process's accessible address space.";
-                    break;
-                case EINVAL:
-                    LERROR << "The given event mask contains no valid events; or mask contains "
-                              "both IN_MASK_ADD and IN_MASK_CREATE; or fd is not an inotify file "
-                              "descriptor.";
-                    break;
-                case ENAMETOOLONG:
-                    LERROR << "Pathname is too long.";
-                    break;
-                case ENOENT:
-                    LERROR << "A directory component in pathname does not exist or is a dangling "
-                              "symbolic link.";
-                    break;
-                case ENOMEM:
-                    LERROR << "Insufficient kernel memory was available.";
-                    break;
-                case ENOSPC:
-                    LERROR << "The user limit on the total number of inotify watches was reached "
-                              "or the kernel failed to allocate a needed resource.";
-                    break;
-                case ENOTDIR:
-                    LERROR << "Mask contains IN_ONLYDIR and pathname is not a directory.";
-                    break;
+
+bool
+WatchNode::add_watches_ (const vector<pair<string, TreeIndex::FileInfo>>& directories, vector<string>& stale)
+{
+    vector<const pair<string, TreeIndex::FileInfo>*> pending;
+
+    for (const auto& directory : directories) {
+        if (!watched_.count (directory.first)) {
+            pending.push_back (&directory);
+        }
+    }
+
+    if (pending.empty()) {
+        return true;
+    }
+
+    if (watch_limit_ && watched_.size() + pending.size() > watch_limit_) {
+        LERROR << LOGNODE << "Cannot watch " << pending.size() << " more paths: fs.inotify.max_user_watches is "
+               << watch_limit_ << " and this node already watches " << watched_.size()
+               << ". Raise the limit (sysctl fs.inotify.max_user_watches) or watch a smaller tree.";
+        return false;
+    }
+
+    std::atomic<size_t> next = 0;
+    std::atomic<bool> full = false;
+    vector<pair<string, int>> errors;
+
+    auto worker = [&] () {
+        vector<string> changed;
+        vector<pair<int, const string*>> added;
+        vector<pair<string, int>> failed;
+        TreeIndex::FileInfo info;
+
+        for (size_t i = next++; i < pending.size() && !full.load(); i = next++) {
+            const auto& [path, indexed] = *pending[i];
+            int wd = inotify_add_watch (notify_fd_, path.c_str(), WATCH_MASK);
+
+            if (wd == -1) {
+                if (errno == ENOSPC) {
+                    full.store (true);
                 }
+                else if (errno != ENOENT || path == pending.front()->first) {
+                    // a folder removed while the tree was scanned is not an error.
+                    failed.emplace_back (path, errno);
+                }
+                continue;
+            }
+
+            added.emplace_back (wd, &path);
+
+            if (indexed.inode != 0 && (!TreeIndex::Stat (path, info) || info.mtime != indexed.mtime)) {
+                changed.push_back (path);
             }
         }
-        // All files found should pass through the graph initially.
-        if (passthru_ && is_regular_file (fs_path)) {
-            OpenOutputs (sandbox);
-            WriteOutputs (input);
-            CloseOutputs();
+
+        std::lock_guard lock (watch_mutex_);
+
+        for (const auto& [wd, path] : added) {
+            watch_fd_map_[wd] = *path;
+            watched_[*path] = wd;
         }
+
+        stale.insert (stale.end(), changed.begin(), changed.end());
+        errors.insert (errors.end(), failed.begin(), failed.end());
+    };
+
+    auto count = std::min<size_t> (threads_ ? threads_ : std::max (1u, std::thread::hardware_concurrency()),
+                                   std::max<size_t> (pending.size() / 256, 1));
+    vector<std::thread> pool;
+
+    for (size_t i = 1; i < count; ++i) {
+        pool.emplace_back (worker);
     }
 
-    return stat;
-} // WatchNode::Notify
+    worker();
 
+    for (auto& thread : pool) {
+        thread.join();
+    }
 
-#define BUF_LEN (100 * (sizeof (struct inotify_event) + NAME_MAX + 1))
+    LDEBUG << "Added " << pending.size() << " watches, " << watched_.size() << " in total.";
 
-void
-WatchNode::Monitor (const string& sandbox)
+    for (const auto& [path, error] : errors) {
+        log_watch_error (path, error);
+    }
+
+    if (full.load()) {
+        LERROR << LOGNODE << "The inotify watch limit was reached after " << watched_.size()
+               << " watches (fs.inotify.max_user_watches is " << watch_limit_
+               << "). Raise the limit (sysctl fs.inotify.max_user_watches) or watch a smaller tree.";
+        return false;
+    }
+
+    return errors.empty();
+} // WatchNode::add_watches_
+
+
+#ifdef FAN_REPORT_DFID_NAME
+bool
+WatchNode::mark_ (const string& given, vector<string>& found)
+{
+    auto path = strip_separators (given);
+    std::error_code ec;
+    auto canonical = filesystem::canonical (path, ec);
+
+    if (ec) {
+        log_watch_error (path, ec.value());
+        return false;
+    }
+
+    // one mark covers the whole file system; events are matched against the roots as they come.
+    struct statfs info{};
+    bool stat = statfs (path.c_str(), &info) == 0;
+    auto fsid = fsid_key (info.f_fsid);
+
+    if (stat && !mount_fds_.count (fsid)) {
+        stat = fanotify_mark (fanotify_fd_, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, FANOTIFY_MASK, AT_FDCWD,
+                              path.c_str()) == 0;
+
+        if (stat) {
+            // directory handles in events are opened relative to this; O_PATH is not accepted.
+            int fd = open (path.c_str(), O_RDONLY | O_CLOEXEC);
+            stat = fd != -1;
+            if (stat) {
+                mount_fds_[fsid] = fd;
+            }
+        }
+    }
+
+    if (stat) {
+        roots_.emplace_back (path, canonical.string());
+
+        if (recursive_ && is_directory (canonical)) {
+            index_.Scan (path, true, threads_, &found);
+        }
+        else {
+            index_.Scan (path, false, threads_, resumed_ ? &found : nullptr);
+            if (!resumed_ && is_regular_file (canonical)) {
+                found.push_back (path);
+            }
+        }
+
+        LDEBUG << "fanotify marked the file system of: " << path;
+        return true;
+    }
+
+    // e.g. a file system without file handles, or a second one with the same id. Everything
+    // goes back to inotify; files already found were sent, so earlier roots are not sent again.
+    LWARN << LOGNODE << "fanotify cannot watch " << path << " (" << strerror (errno) << "); using inotify.";
+
+    close (fanotify_fd_);
+    fanotify_fd_ = -1;
+
+    for (const auto& [id, fd] : mount_fds_) {
+        close (fd);
+    }
+    mount_fds_.clear();
+    handles_.clear();
+
+    vector<string> ignored;
+    stat = true;
+
+    for (const auto& root : roots_) {
+        stat = watch_ (root.first, ignored) && stat;
+    }
+    roots_.clear();
+
+    return watch_ (path, found) && stat;
+} // WatchNode::mark_
+
+
+bool
+WatchNode::resolve_ (uint64_t fsid, const void* handle, string& directory)
+{
+    auto* file = static_cast<file_handle*> (const_cast<void*> (handle));
+
+    string key (reinterpret_cast<const char*> (&fsid), sizeof (fsid));
+    key.append (static_cast<const char*> (handle), sizeof (file_handle) + file->handle_bytes);
+
+    if (auto it = handles_.find (key); it != handles_.end()) {
+        directory = it->second;
+        return true;
+    }
+
+    auto mount = mount_fds_.find (fsid);
+    if (mount == mount_fds_.end()) {
+        return false;
+    }
+
+    // a directory that is already gone cannot be opened, and nothing in it is reported.
+    int fd = open_by_handle_at (mount->second, file, O_PATH | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+
+    char buffer[PATH_MAX];
+    auto link = "/proc/self/fd/" + std::to_string (fd);
+    auto length = readlink (link.c_str(), buffer, sizeof (buffer));
+    close (fd);
+
+    if (length <= 0 || size_t (length) == sizeof (buffer)) {
+        return false;
+    }
+
+    directory.assign (buffer, size_t (length));
+
+    if (directory.ends_with (" (deleted)")) {
+        return false;
+    }
+
+    if (handles_.size() >= HANDLE_CACHE) {
+        handles_.clear();
+    }
+    handles_.emplace (std::move (key), directory);
+
+    return true;
+} // WatchNode::resolve_
+
+
+bool
+WatchNode::read_fanotify_ (std::chrono::steady_clock::time_point now, vector<string>& found)
 {
-    struct pollfd pfds[1];
-    pfds[0].fd = notify_fd_;
-    pfds[0].events = POLLIN;
+    alignas (fanotify_event_metadata) char buffer[64 * 1024];
+    bool overflow = false;
 
-    // must be stopped with a SIGINT (ctrl-c).
-    while (true) {
-        auto ret = poll (pfds, 1, 2);
+    auto numbytes = read (fanotify_fd_, buffer, sizeof (buffer));
+    auto* metadata = reinterpret_cast<fanotify_event_metadata*> (buffer);
+
+    for (; numbytes > 0 && FAN_EVENT_OK (metadata, numbytes); metadata = FAN_EVENT_NEXT (metadata, numbytes)) {
+        if (metadata->vers != FANOTIFY_METADATA_VERSION) {
+            LERROR << LOGNODE << "fanotify metadata version mismatch.";
+            break;
+        }
 
-        if (ret <= 0 || !pfds[0].revents) {
+        if (metadata->mask & FAN_Q_OVERFLOW) {
+            queue_.add_dropped (1);
+            overflow = true;
             continue;
         }
 
-        char buffer[BUF_LEN];
-        ssize_t bytesread = read (notify_fd_, buffer, BUF_LEN);
+        auto* fid = reinterpret_cast<fanotify_event_info_fid*> (metadata + 1);
 
-        if (bytesread <= 0) {
+        if (metadata->event_len <= metadata->metadata_len ||
+            fid->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME) {
             continue;
         }
 
-        char* p;
-        inotify_event* ev;
+        // the record holds the parent's handle, followed by the entry's name.
+        auto* handle = reinterpret_cast<file_handle*> (fid->handle);
+        const char* name = reinterpret_cast<const char*> (handle->f_handle + handle->handle_bytes);
+        string directory;
 
-        for (p = buffer; p < buffer + bytesread;) {
-            ev = (struct inotify_event*)p;
-            string input;
+        if (!resolve_ (fsid_key (fid->fsid), handle, directory)) {
+            continue;
+        }
 
-            if (ev->mask & IN_CLOSE_WRITE) {
-                input = ev->name;
-                if (input.empty()) {
-                    input = watch_fd_map_[ev->wd];
-                }
-                else {
-                    input = watch_fd_map_[ev->wd] + "/" + ev->name;
+        bool folder = metadata->mask & FAN_ONDIR;
+
+        // a renamed folder changes the path of everything cached below it.
+        if (folder && (metadata->mask & FAN_MOVED_TO)) {
+            handles_.clear();
+        }
+
+        // the mark reports the whole file system; most of it is not being watched.
+        auto path = under_root_ (directory == "/" ? directory + name : directory + "/" + name);
+        if (path.empty()) {
+            continue;
+        }
+
+        auto parent = under_root_ (directory);
+        hot_[parent.empty() ? path : parent] = now;
+
+        if (folder) {
+            // a folder moved in brings its files; a new one is indexed for overflow recovery.
+            if (recursive_) {
+                index_.Scan (path, true, threads_, &found);
+            }
+            continue;
+        }
+
+        LDEBUG << "File changed: " << path;
+        queue_.Push (path, now);
+    }
+
+    return overflow;
+} // WatchNode::read_fanotify_
+
+
+string
+WatchNode::under_root_ (const string& path) const
+{
+    for (const auto& [given, canonical] : roots_) {
+        if (path == canonical) {
+            return given;
+        }
+
+        auto prefix = canonical == "/" ? canonical : canonical + "/";
+
+        if (!path.starts_with (prefix)) {
+            continue;
+        }
+
+        auto rest = path.substr (prefix.size());
+
+        if (recursive_ || rest.find ('/') == string::npos) {
+            return given == "/" ? given + rest : given + "/" + rest;
+        }
+    }
+
+    return {};
+} // WatchNode::under_root_
+#else
+bool
+WatchNode::mark_ (const string& path, vector<string>& found)
+{
+    return watch_ (path, found);
+} // WatchNode::mark_
+
+
+bool
+WatchNode::resolve_ (uint64_t fsid, const void* handle, string& directory)
+{
+    return false;
+} // WatchNode::resolve_
+
+
+bool
+WatchNode::read_fanotify_ (std::chrono::steady_clock::time_point now, vector<string>& found)
+{
+    return false;
+} // WatchNode::read_fanotify_
+
+
+string
+WatchNode::under_root_ (const string& path) const
+{
+    return {};
+} // WatchNode::under_root_
+#endif
+
+
+void
+WatchNode::recover_ (vector<string>& changed)
+{
+    auto now = std::chrono::steady_clock::now();
+
+    // events were lost. Folders that gained, lost or renamed entries show a new mtime; files
+    // written in place are looked for in the folders that were busy when the queue overflowed.
+    vector<string> roots;
+    index_.Stale (threads_, roots);
+
+    for (auto it = hot_.begin(); it != hot_.end();) {
+        if (now - it->second < HOT_WINDOW) {
+            roots.push_back (it->first);
+            ++it;
+        }
+        else {
+            it = hot_.erase (it);
+        }
+    }
+
+    std::sort (roots.begin(), roots.end());
+    roots.erase (std::unique (roots.begin(), roots.end()), roots.end());
+
+    LWARN << LOGNODE << "Event queue overflowed; rescanning " << roots.size() << " of "
+          << index_.directory_count() << " folders.";
+
+    for (const auto& root : roots) {
+        vector<string> subdirectories;
+        index_.Scan (root, false, threads_, &changed, &subdirectories);
+
+        if (!recursive_) {
+            continue;
+        }
+
+        // folders created while events were lost are walked, and watched unless the fanotify
+        // mark already covers them.
+        for (const auto& subdirectory : subdirectories) {
+            if (fanotify_fd_ != -1) {
+                if (!index_.contains (subdirectory)) {
+                    index_.Scan (subdirectory, true, threads_, &changed);
                 }
-                LDEBUG << "File changed: " << input;
             }
-            else if (ev->mask & IN_CREATE || ev->mask & IN_MOVED_TO) {
-                if (ev->mask & IN_ISDIR) {
-                    // A new directory exists; create a watch on it.
-                    auto fullpath = watch_fd_map_[ev->wd] + "/" + ev->name;
-                    Notify (sandbox, fullpath);
+            else if (!watched_.count (subdirectory)) {
+                watch_tree_ (subdirectory, changed);
+            }
+        }
+    }
+} // WatchNode::recover_
+
+
+#define BUF_LEN (100 * (sizeof (struct inotify_event) + NAME_MAX + 1))
+
+bool
+WatchNode::read_inotify_ (std::chrono::steady_clock::time_point now, vector<string>& found)
+{
+    alignas (inotify_event) char buffer[BUF_LEN];
+    bool overflow = false;
+
+    ssize_t bytesread = read (notify_fd_, buffer, BUF_LEN);
+
+    for (char* p = buffer; p < buffer + bytesread;) {
+        auto* ev = reinterpret_cast<inotify_event*> (p);
+        p += sizeof (struct inotify_event) + ev->len;
+
+        if (ev->mask & IN_Q_OVERFLOW) {
+            queue_.add_dropped (1);
+            overflow = true;
+            continue;
+        }
+
+        if (ev->mask & IN_IGNORED) {
+            // the folder is gone, and the kernel dropped its watch.
+            watched_.erase (watch_fd_map_[ev->wd]);
+            watch_fd_map_.erase (ev->wd);
+            continue;
+        }
+
+        hot_[watch_fd_map_[ev->wd]] = now;
+
+        string input;
+
+        if (ev->mask & IN_CLOSE_WRITE) {
+            input = ev->name;
+            if (input.empty()) {
+                input = watch_fd_map_[ev->wd];
+            }
+            else {
+                input = watch_fd_map_[ev->wd] + "/" + ev->name;
+            }
+            LDEBUG << "File changed: " << input;
+        }
+        else if (ev->mask & IN_CREATE || ev->mask & IN_MOVED_TO) {
+            if (ev->mask & IN_ISDIR) {
+                // A new directory exists; create a watch on it. Files written into it before
+                // the watch was in place are found by the scan.
+                auto fullpath = watch_fd_map_[ev->wd] + "/" + ev->name;
+
+                if (recursive_) {
+                    watch_tree_ (fullpath, found);
                 }
                 else {
-                    input = watch_fd_map_[ev->wd] + "/" + ev->name;
-                    LDEBUG << "New or renamed file: " << input;
+                    Notify (fullpath);
                 }
             }
+            else {
+                input = watch_fd_map_[ev->wd] + "/" + ev->name;
+                LDEBUG << "New or renamed file: " << input;
+            }
+        }
 
-            if (!input.empty()) {
-                // Time-based filtering of duplicates
-                auto now = std::chrono::steady_clock::now();
-                auto it = notifications_.find (input);
+        if (!input.empty()) {
+            queue_.Push (input, now);
+        }
+    }
 
-                if (it == notifications_.end() || (now - it->second) >= debounce_time) {
-                    notifications_[input] = now;
-                    OpenOutputs (sandbox);
-                    WriteOutputs (input);
-                    CloseOutputs();
-                }
+    return overflow;
+} // WatchNode::read_inotify_
+
+
+void
+WatchNode::Monitor()
+{
+    struct pollfd pfds[2];
+    pfds[1] = {stop_fd_, POLLIN, 0};
+
+    vector<string> ready;
+    vector<string> found;
+
+    // runs until cancelled; Cancel() writes to stop_fd_ to end the wait. The poll sleeps until
+    // an event arrives or the oldest pending path has been quiet long enough.
+    while (!terminate_.load() && !cancelled_.load()) {
+        // inotify takes over if fanotify gives up on a root.
+        pfds[0] = {fanotify_fd_ != -1 ? fanotify_fd_ : notify_fd_, POLLIN, 0};
+
+        auto ret = poll (pfds, 2, timeout_ (std::chrono::steady_clock::now()));
+
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
             }
+            LERROR << LOGNODE << "poll failed: " << strerror (errno);
+            break;
+        }
+
+        if (pfds[1].revents) {
+            break;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        bool overflow = false;
+
+        if (pfds[0].revents & POLLIN) {
+            overflow = fanotify_fd_ != -1 ? read_fanotify_ (now, found) : read_inotify_ (now, found);
+        }
 
-            input.clear();
+        if (overflow) {
+            recover_ (found);
+        }
 
-            p += sizeof (struct inotify_event) + ev->len;
+        for (const auto& path : found) {
+            queue_.Push (path, now);
         }
+        found.clear();
+
+        now = std::chrono::steady_clock::now();
+        queue_.Pop (now, ready);
+        hold_ (now, ready);
+
+        // the index follows what was sent, so a rescan does not send it again.
+        WriteTokens (ready);
+        sent_ (ready, true);
+        unsaved_ += ready.size();
+        ready.clear();
+
+        checkpoint_ (false);
     }
+
+    // whatever is still waiting goes out before EOF; after Cancel() it is left for the next run.
+    drain_ (ready);
+    WriteTokens (ready);
+    sent_ (ready, true);
 } // WatchNode::Monitor
 
 
@@ -471,14 +1497,30 @@ WatchNode::RemoveWatches()
         inotify_rm_watch (notify_fd_, wd);
     }
     watch_fd_map_.clear();
+    watched_.clear();
     LDEBUG << "Removed watched paths.";
 } // WatchNode::RemoveWatches
 
 
 void
-WatchNode::RemoveMonitor() const
+WatchNode::RemoveMonitor()
 {
-    close (notify_fd_);
+    if (notify_fd_ != -1) {
+        close (notify_fd_);
+    }
+    if (stop_fd_ != -1) {
+        close (stop_fd_);
+    }
+    if (fanotify_fd_ != -1) {
+        close (fanotify_fd_);
+    }
+    for (const auto& [fsid, fd] : mount_fds_) {
+        close (fd);
+    }
+    notify_fd_ = -1;
+    stop_fd_ = -1;
+    fanotify_fd_ = -1;
+    mount_fds_.clear();
 } // WatchNode::RemoveMonitor
 
 #endif // ifdef __linux__
@@ -491,25 +1533,35 @@ WatchNode::Execute (vector<string>& inputs, const string& sandbox, json& vars)
     bool stat = true;
 
     LINFO << "Executing " << (isroot_ ? "root: " : "node: ") << name_;
+    LWARN_IF (backend_ == "poll") << LOGNODE << "The poll backend is not available on Windows.";
+    LWARN_IF (!state_.empty()) << LOGNODE << "Saved state is not available on Windows.";
+
+    // downstream of other nodes, the paths to watch arrive as a batch list.
+    if (!batchfile_.empty()) {
+        inputs.clear();
+        BatchSpool::Read (batchfile_, inputs);
+    }
 
     if (!InitNotify()) {
         return false;
     }
 
+    queue_ = PathQueue (std::chrono::milliseconds (quiescence_), std::chrono::milliseconds (debounce_),
+                        max_pending_);
+    settling_ = SettleWheel (std::chrono::milliseconds (settle_), marker_, std::chrono::steady_clock::now());
+
     std::vector<path> allpaths;
 
     for (const auto& input : inputs) {
         if (input == "EOF") continue;
-        allpaths.emplace_back (input);
+        allpaths.emplace_back (string (token_path (input)));
     }
 
     for (const auto& path: allpaths) {
         if (is_regular_file (path)) {
             watch_files_.insert (path.string());
             if (passthru_) {
-                OpenOutputs (sandbox);
                 WriteOutputs (path.string());
-                CloseOutputs();
             }
         }
         else if (is_directory (path)) {
@@ -530,14 +1582,14 @@ WatchNode::Execute (vector<string>& inputs, const string& sandbox, json& vars)
     if (recursive_) {
         auto common_folders = m_minimum_root (allpaths);
         for (auto& folder: common_folders) {
-            if (!Notify (sandbox, folder.string())) {
+            if (!Notify (folder.string())) {
                 stat = false;
             }
         }
     }
     else {
         for (auto& folder: watch_dirs_) {
-            if (!Notify (sandbox, folder)) {
+            if (!Notify (folder)) {
                 stat = false;
             }
         }
@@ -547,7 +1599,7 @@ WatchNode::Execute (vector<string>& inputs, const string& sandbox, json& vars)
         if (!inputs.empty() && inputs[inputs.size() - 1] == "EOF") {
             inputs.pop_back();
         }
-        Monitor (sandbox);
+        Monitor();
     }
 
     OpenOutputs (sandbox);
@@ -555,6 +1607,7 @@ WatchNode::Execute (vector<string>& inputs, const string& sandbox, json& vars)
     CloseOutputs();
 
     RemoveWatches();
+    Stats();
     Reset();
 
     return stat;
@@ -570,6 +1623,17 @@ WatchNode::Stop()
 } // WatchNode::Stop
 
 
+void
+WatchNode::Cancel()
+{
+    Node::Cancel();
+
+    if (iocp_ != nullptr) {
+        PostQueuedCompletionStatus (iocp_, 0, 0, nullptr);
+    }
+} // WatchNode::Cancel
+
+
 bool
 WatchNode::InitNotify()
 {
@@ -585,7 +1649,7 @@ WatchNode::InitNotify()
 
 
 bool
-WatchNode::Notify (const string& sandbox, const string& path)
+WatchNode::Notify (const string& path)
 {
     bool stat = true;
 
@@ -639,39 +1703,45 @@ WatchNode::Notify (const string& sandbox, const string& path)
 } // WatchNode::Notify
 
 
-void WatchNode::Monitor (const std::string& sandbox) {
+void WatchNode::Monitor() {
     ULONG num_removed = 0;
+    vector<string> ready;
+    bool stop = false;
+
+    while (!stop && !terminate_.load() && !cancelled_.load()) {
+        // wakes for the next completion, or when the oldest pending path has been quiet long enough.
+        auto wait = timeout_ (std::chrono::steady_clock::now());
 
-    while (!terminate_.load()) {
         OVERLAPPED_ENTRY overlapped[MAXIMUM_WAIT_OBJECTS];
         BOOL success = GetQueuedCompletionStatusEx(
             iocp_,
             overlapped,
             MAXIMUM_WAIT_OBJECTS,
             &num_removed,
-            INFINITE,
+            wait < 0 ? INFINITE : DWORD (wait),
             FALSE);
 
         if (!success) {
             const DWORD error = GetLastError();
-            if (error == WAIT_TIMEOUT) {
-                continue; // Timeout reached, check for termination
+            if (error != WAIT_TIMEOUT) {
+                LERROR << "GetQueuedCompletionStatusEx failed with error: " << error;
+                break;
             }
-            LERROR << "GetQueuedCompletionStatusEx failed with error: " << error;
-            break;
+            num_removed = 0;
         }
 
-        std::vector<std::string> batch_modified_files;
+        auto now = std::chrono::steady_clock::now();
 
-        for (ULONG i = 0; i < num_removed; ++i) {
+        for (ULONG i = 0; i < num_removed && !stop; ++i) {
             LPOVERLAPPED lpOverlapped = overlapped[i].lpOverlapped;
             ULONG_PTR completionkey = overlapped[i].lpCompletionKey;
             DWORD bytes_transferred = overlapped[i].dwNumberOfBytesTransferred;
 
             if (lpOverlapped == nullptr && completionkey == 0) {
-                // Exit signal via PostQueuedCompletionStatus in Stop().
+                // Exit signal via PostQueuedCompletionStatus in Stop() or Cancel().
                 LDEBUG << "Exiting Monitor().";
-                return;
+                stop = true;
+                break;
             }
 
             auto* dirinfo = reinterpret_cast<DirectoryInfo*>(completionkey);
@@ -693,6 +1763,7 @@ void WatchNode::Monitor (const std::string& sandbox) {
 
             if (!success) {
                 LERROR << "ReadDirectoryChangesW failed with error: " << GetLastError();
+                stop = true;
                 break;
             }
 
@@ -734,23 +1805,25 @@ void WatchNode::Monitor (const std::string& sandbox) {
                         continue; // Skip directories
                     }
 
-                    auto fullpathstr = fs_path.string();
-                    auto now = std::chrono::steady_clock::now();
-                    auto it = notifications_.find (fullpathstr);
-                    if (it == notifications_.end() || (now - it->second) >= debounce_time) {
-                        notifications_[fullpathstr] = now;
-                        batch_modified_files.push_back (fullpathstr);
-                    }
+                    queue_.Push (fs_path.string(), now);
                 }
             } while (notify->NextEntryOffset != 0 && !terminate_.load());
         }
 
-        if (!batch_modified_files.empty() && !terminate_.load()) {
-            for (const auto& filename : batch_modified_files) {
-                WriteOutputs (filename);
-            }
+        if (!terminate_.load()) {
+            now = std::chrono::steady_clock::now();
+            queue_.Pop (now, ready);
+            hold_ (now, ready);
+            WriteTokens (ready);
+            ready.clear();
         }
     }
+
+    // whatever is still settling goes out before EOF.
+    if (!terminate_.load()) {
+        drain_ (ready);
+        WriteTokens (ready);
+    }
 }
 
 
@@ -776,7 +1849,7 @@ WatchNode::RemoveWatches()
 
 
 void
-WatchNode::RemoveMonitor() const
+WatchNode::RemoveMonitor()
 {
 } // WatchNode::RemoveMonitor
 #endif
@@ -5,13 +5,25 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <mutex>
 #include <queue>
 #include <set>
 #include "node.h"
+#include "pathqueue.h"
+#include "settlewheel.h"
+#include "treeindex.h"
 #include "utils.h"
 
 
 namespace daisychain {
+// Watches files and directories and sends the paths of files as they are written. Events are
+// merged per path until the path has been quiet for the quiescence window, then sent in blocks.
+// Runs until cancelled; Cancel() wakes the event loop and EOF is sent. Paths still waiting then
+// are discarded, like any output of a cancelled node; with a saved state they are left out of it,
+// so the next run sends them.
+// The "poll" backend finds changes by rescanning instead, for file systems such as NFS where
+// other machines' writes raise no events.
 class WatchNode final : public Node
 {
 public:
@@ -31,6 +43,10 @@ public:
 
     void Cleanup() override;
 
+    void Cancel() override;
+
+    void Stats() override;
+
     void Reset() override
     {
 #ifdef _WIN32
@@ -46,7 +62,20 @@ public:
         }
 #endif
         watch_fd_map_.clear();
-        notifications_.clear();
+        queue_.Clear();
+        settling_.Clear();
+        index_.Clear();
+        schedule_.clear();
+        polled_files_.clear();
+        polls_ = 0;
+        resumed_ = false;
+        unsaved_ = 0;
+#ifdef __linux__
+        watched_.clear();
+        hot_.clear();
+        roots_.clear();
+        handles_.clear();
+#endif
         Node::Reset();
     }
 
@@ -58,23 +87,177 @@ public:
 
     void set_recursive (bool recursive) { recursive_ = recursive; }
 
+    // milliseconds a path must go without events before it is sent.
+    [[nodiscard]] int quiescence() const { return quiescence_; }
+
+    void set_quiescence (int milliseconds) { quiescence_ = milliseconds; }
+
+    // milliseconds after a path is sent during which new events for it are merged into that send.
+    [[nodiscard]] int debounce() const { return debounce_; }
+
+    void set_debounce (int milliseconds) { debounce_ = milliseconds; }
+
+    // milliseconds a file's size and mtime must stay the same before its path is sent; 0 sends
+    // it once its events are quiet.
+    [[nodiscard]] int settle() const { return settle_; }
+
+    void set_settle (int milliseconds) { settle_ = milliseconds; }
+
+    // suffix of a marker file, such as ".done". A path is sent as soon as path + marker exists,
+    // or once it settles if settle is set too. Marker files are not sent.
+    [[nodiscard]] string marker() const { return marker_; }
+
+    void set_marker (const string& suffix) { marker_ = suffix; }
+
+    // paths that may wait at once; events for further paths are dropped.
+    [[nodiscard]] size_t max_pending() const { return max_pending_; }
+
+    void set_max_pending (size_t count) { max_pending_ = count; }
+
+    // threads used to set up recursive watches and to rescan; 0 uses one per core.
+    [[nodiscard]] unsigned int threads() const { return threads_; }
+
+    void set_threads (unsigned int threads) { threads_ = threads; }
+
+    // "poll" rescans the watched tree every interval (Linux and macOS). The rest are Linux only:
+    // "inotify" watches every folder; "fanotify" marks whole file systems and needs CAP_SYS_ADMIN;
+    // "auto" tries fanotify for recursive watches and falls back to inotify.
+    [[nodiscard]] string backend() const { return backend_; }
+
+    void set_backend (const string& backend) { backend_ = backend; }
+
+    // milliseconds between polls. Every folder is checked on each poll; the files in it are
+    // checked less often while it stays quiet, up to max_interval apart.
+    [[nodiscard]] int interval() const { return interval_; }
+
+    void set_interval (int milliseconds) { interval_ = milliseconds; }
+
+    [[nodiscard]] int max_interval() const { return max_interval_; }
+
+    void set_max_interval (int milliseconds) { max_interval_ = milliseconds; }
+
+    // a file that keeps the index of the watched tree between runs. When it is there at start,
+    // the files that changed since it was saved are sent in place of passthru. Not on Windows.
+    [[nodiscard]] string state() const { return state_; }
+
+    void set_state (const string& path) { state_ = path; }
+
 private:
     bool InitNotify();
 
-    bool Notify (const string& sandbox, const string& path);
+    bool Notify (const string& path);
 
-    void Monitor (const string& sandbox);
+    void Monitor();
 
     void RemoveWatches();
 
-    void RemoveMonitor() const;
+    void RemoveMonitor();
+
+    void Poll();
+
+    // indexes a path to poll; its files are sent with passthru.
+    bool snapshot_ (const string& path);
+
+    // one poll; files that are new or changed go to changed.
+    void poll_ (std::chrono::steady_clock::time_point now, vector<string>& changed);
+
+    // ends a wait in Poll().
+    void wake_();
+
+    // saves the index to state_ once in a while, when everything it holds has been sent.
+    void checkpoint_ (bool force);
+
+    // replaces paths out of the queue in ready with those that are complete, and holds the rest.
+    void hold_ (std::chrono::steady_clock::time_point now, vector<string>& ready);
+
+    // everything still waiting, at shutdown. It is sent if the event loop failed; after Cancel()
+    // nothing is written and sent_() keeps it out of the index.
+    void drain_ (vector<string>& ready);
+
+    // after paths were written: with update, the index records them as sent. A cancelled node
+    // writes nothing, so they leave the index instead and a run resumed from it sends them.
+    void sent_ (const vector<string>& paths, bool update);
+
+    // milliseconds until a waiting path may be ready; -1 when none is waiting.
+    [[nodiscard]] int timeout_ (std::chrono::steady_clock::time_point now) const;
+
+    // when the files of a folder are next checked while polling.
+    struct Schedule
+    {
+        std::chrono::steady_clock::time_point due;
+        unsigned int quiet = 0;     // checks in a row that found nothing
+    };
 
     bool passthru_;
     bool recursive_;
-    int notify_fd_ = 0;
+    int quiescence_;
+    int debounce_;
+    int settle_;
+    string marker_;
+    size_t max_pending_;
+    unsigned int threads_;
+    string backend_;
+    int interval_;
+    int max_interval_;
+    string state_;
+    int notify_fd_ = -1;
+    int stop_fd_ = -1;
     map<int, string> watch_fd_map_;
-    std::unordered_map<string, std::chrono::steady_clock::time_point> notifications_;
-    std::chrono::milliseconds debounce_time = std::chrono::milliseconds (2000);
+    PathQueue queue_;
+    SettleWheel settling_;
+    TreeIndex index_;
+
+    std::unordered_map<string, Schedule> schedule_;
+    vector<string> polled_files_;
+    uint64_t polls_ = 0;
+
+    // set while the watches are set up from a saved index.
+    bool resumed_ = false;
+    size_t unsaved_ = 0;
+    std::chrono::steady_clock::time_point saved_;
+    std::mutex poll_mutex_;
+    std::condition_variable poll_cv_;
+
+#ifdef __linux__
+    // sets up inotify watches for path; files found go to found.
+    bool watch_ (const string& path, vector<string>& found);
+
+    // scans a directory tree and watches every directory in it; files found go to found.
+    bool watch_tree_ (const string& root, vector<string>& found);
+
+    // marks the file system of path with fanotify. On failure fanotify is given up and the
+    // paths marked so far are watched with inotify.
+    bool mark_ (const string& path, vector<string>& found);
+
+    // watches the directories not watched yet; those that changed after their scan go to stale.
+    bool add_watches_ (const vector<pair<string, TreeIndex::FileInfo>>& directories, vector<string>& stale);
+
+    // after a queue overflow: rescans what may have changed, files found go to changed.
+    void recover_ (vector<string>& changed);
+
+    // read one batch of events; true if the kernel queue overflowed.
+    bool read_inotify_ (std::chrono::steady_clock::time_point now, vector<string>& found);
+
+    bool read_fanotify_ (std::chrono::steady_clock::time_point now, vector<string>& found);
+
+    // the path of the directory behind a file handle reported by fanotify.
+    bool resolve_ (uint64_t fsid, const void* handle, string& directory);
+
+    // the path as the node reports it if it is under a fanotify root, or an empty string.
+    [[nodiscard]] string under_root_ (const string& path) const;
+
+    std::mutex watch_mutex_;
+    std::unordered_map<string, int> watched_;
+    // directories with recent events, rescanned after an overflow.
+    std::unordered_map<string, std::chrono::steady_clock::time_point> hot_;
+    size_t watch_limit_ = 0;
+
+    int fanotify_fd_ = -1;
+    std::unordered_map<uint64_t, int> mount_fds_;
+    std::unordered_map<string, string> handles_;
+    // each fanotify root as given and as the kernel reports it.
+    vector<pair<string, string>> roots_;
+#endif
 
 #ifdef _WIN32
     #define BUFFER_SIZE (1024 * 64)
@@ -0,0 +1,202 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "windownode.h"
+#include <fstream>
+
+
+namespace daisychain {
+using namespace std;
+
+
+WindowNode::WindowNode() :
+    count_ (0),
+    bytes_ (0),
+    interval_ (0),
+    window_bytes_ (0),
+    failed_ (false),
+    windows_ (0)
+{
+    type_ = DaisyNodeType::DC_WINDOW;
+    set_name (DaisyNodeNameByType[type_]);
+}
+
+
+void
+WindowNode::Initialize (json& keydata, bool keep_uuid)
+{
+    Node::Initialize (keydata, keep_uuid);
+
+    json::iterator jit = keydata.begin();
+    const auto& uuid = jit.key();
+    auto data = keydata[uuid];
+
+    set_count (data.count ("count") ? data["count"].get<size_t>() : 0);
+    set_bytes (data.count ("bytes") ? data["bytes"].get<size_t>() : 0);
+    set_interval (data.count ("interval") ? data["interval"].get<int>() : 0);
+}
+
+
+bool
+WindowNode::Execute (vector<string>& inputs, const string& sandbox, json& vars)
+{
+    LINFO << "Executing " << (isroot_ ? "root: " : "node: ") << name_;
+
+    if (count_ == 0 && bytes_ == 0 && interval_ <= 0) {
+        LERROR << LOGNODE << "A window needs a count, bytes or interval limit.";
+        OpenOutputs (sandbox);
+        WriteOutputs ("EOF");
+        CloseOutputs();
+
+        return false;
+    }
+
+    window_.clear();
+    window_bytes_ = 0;
+    failed_ = false;
+    windows_ = 0;
+
+    if (isroot_) {
+        add_ (inputs, sandbox);
+    }
+    else {
+        while (eofs_ <= fd_in_.size() && !terminate_.load()) {
+            add_ (inputs, sandbox);
+            expire_ (sandbox);
+
+            inputs.clear();
+
+            if (eofs_ == fd_in_.size()) {
+                break;
+            }
+            ReadInputs (inputs);
+        }
+        CloseInputs();
+    }
+
+    if (!cancelled_.load()) {
+        failed_ = !flush_ (sandbox) || failed_;
+    }
+
+    // all processing is done for this node. Send EOF downstream.
+    OpenOutputs (sandbox);
+    WriteOutputs ("EOF");
+    CloseOutputs();
+    Stats();
+    Reset();
+
+    window_ = vector<string>();
+
+    return !failed_;
+} // WindowNode::Execute
+
+
+void
+WindowNode::add_ (vector<string>& inputs, const string& sandbox)
+{
+    for (auto& input : inputs) {
+        if (input == "EOF" || cancelled_.load()) {
+            continue;
+        }
+
+        // a list holds paths, as a batch list does.
+        input.resize (token_path (input).size());
+        auto size = input.size() + 1;
+
+        // a token that would overflow the bytes limit starts the next window.
+        if (bytes_ && !window_.empty() && window_bytes_ + size > bytes_) {
+            failed_ = !flush_ (sandbox) || failed_;
+        }
+
+        if (window_.empty()) {
+            opened_ = Clock::now();
+        }
+
+        window_.push_back (std::move (input));
+        window_bytes_ += size;
+
+        if ((count_ && window_.size() >= count_) || (bytes_ && window_bytes_ >= bytes_)) {
+            failed_ = !flush_ (sandbox) || failed_;
+        }
+    }
+} // WindowNode::add_
+
+
+void
+WindowNode::expire_ (const string& sandbox)
+{
+    if (interval_ > 0 && !window_.empty() && Clock::now() - opened_ >= std::chrono::milliseconds (interval_)) {
+        failed_ = !flush_ (sandbox) || failed_;
+    }
+} // WindowNode::expire_
+
+
+bool
+WindowNode::flush_ (const string& sandbox)
+{
+    if (window_.empty()) {
+        return true;
+    }
+
+    auto list = sandbox + "/" + id_ + ".window." + std::to_string (windows_);
+
+    {
+        std::ofstream stream (list, std::ios::out | std::ios::binary | std::ios::trunc);
+
+        for (const auto& token : window_) {
+            stream << token << '\n';
+        }
+
+        stream.flush();
+
+        // the window's tokens are lost; nothing goes downstream for it.
+        if (!stream) {
+            LERROR << LOGNODE << "Cannot write window list: " << list;
+            window_.clear();
+            window_bytes_ = 0;
+
+            return false;
+        }
+    }
+
+    set_token_attribute (list, "tokens", int64_t (window_.size()));
+    set_token_attribute (list, "bytes", int64_t (window_bytes_));
+
+    LDEBUG << LOGNODE << "window " << windows_ << ": " << window_.size() << " tokens.";
+
+    OpenOutputs (sandbox);
+    WriteOutputs (list);
+    CloseOutputs();
+
+    ++windows_;
+    window_.clear();
+    window_bytes_ = 0;
+
+    return true;
+} // WindowNode::flush_
+
+
+json
+WindowNode::Serialize()
+{
+    auto json_ = Node::Serialize();
+    json_[id_]["count"] = count_;
+    json_[id_]["bytes"] = bytes_;
+    json_[id_]["interval"] = interval_;
+
+    if (size_ != std::pair<int, int>(0,0)) {json_[id_]["size"] = size_;}
+
+    return json_;
+} // WindowNode::Serialize
+
+
+void
+WindowNode::Stats()
+{
+    LINFO << LOGNODE << "windows sent: " << windows_;
+
+    Node::Stats();
+} // WindowNode::Stats
+} // namespace daisychain
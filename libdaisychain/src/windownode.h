@@ -0,0 +1,83 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include <chrono>
+#include "node.h"
+
+
+namespace daisychain {
+// Groups tokens into mini-batches between one token at a time and a whole batch. A window
+// closes after count tokens, after bytes of them, or interval milliseconds after its first
+// token, whichever comes first, and what is left closes at EOF. At least one of the three
+// must be set; a window without a limit would hold the whole stream.
+//
+// Each window is written to a list file in the sandbox, one path per line in arrival order,
+// and the path of the list goes downstream with the attributes "tokens" and "bytes". A command
+// reads it like a batch list: `xargs cmd < "${INPUT}"`. The lists are left for the sandbox's
+// cleanup, as downstream may still be reading them when this node is done.
+//
+// On Windows reads block until something arrives, so an interval closes a window when the
+// next token or EOF comes in after it has run out.
+class WindowNode final : public Node
+{
+public:
+    WindowNode();
+
+    void Initialize (json&, bool) override;
+
+    bool Execute (vector<string>& input, const string& sandbox, json& vars) override;
+
+    json Serialize() override;
+
+    void Stats() override;
+
+    // tokens per window; 0 for no limit.
+    void set_count (size_t count) { count_ = count; }
+
+    [[nodiscard]] size_t count() const { return count_; }
+
+    // bytes of tokens per window, newlines included; 0 for no limit. A window holds at least
+    // one token, however long.
+    void set_bytes (size_t bytes) { bytes_ = bytes; }
+
+    [[nodiscard]] size_t bytes() const { return bytes_; }
+
+    // milliseconds a window stays open after its first token; 0 for no limit.
+    void set_interval (int milliseconds) { interval_ = milliseconds; }
+
+    [[nodiscard]] int interval() const { return interval_; }
+
+private:
+    // not exposed
+    using Node::set_batch_flag;
+    using Node::set_outputfile;
+
+    using Clock = std::chrono::steady_clock;
+
+    // adds inputs to the window, closing it whenever it is full.
+    void add_ (vector<string>& inputs, const string& sandbox);
+
+    // closes the window if its interval has run out.
+    void expire_ (const string& sandbox);
+
+    // writes the window to its list and sends the list's path downstream; false if the list
+    // could not be written, in which case the window is dropped.
+    bool flush_ (const string& sandbox);
+
+    size_t count_;
+    size_t bytes_;
+    int interval_;
+
+    vector<string> window_;
+    size_t window_bytes_;
+    Clock::time_point opened_;
+    // a window was dropped because its list could not be written.
+    bool failed_;
+
+    uint64_t windows_;
+};
+} // namespace daisychain
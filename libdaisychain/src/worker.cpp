@@ -0,0 +1,231 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#include "worker.h"
+#include "commandlinenode.h"
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#endif
+
+
+namespace daisychain {
+using namespace std;
+
+
+Worker::Worker (int port, const string& bind_address, const string& secret) :
+    port_ (port),
+    bind_address_ (bind_address.empty() ? "127.0.0.1" : bind_address),
+    secret_ (secret),
+    listen_fd_ (-1)
+{
+    terminate_.store (false);
+}
+
+
+Worker::~Worker()
+{
+#ifndef _WIN32
+    if (listen_fd_ != -1) {
+        close (listen_fd_);
+    }
+#endif
+}
+
+
+bool
+Worker::Run()
+{
+#ifdef _WIN32
+    LERROR << "Worker mode is not supported on Windows.";
+    return false;
+#else
+    if (secret_.empty()) {
+        LERROR << "Worker needs a shared secret: set DAISY_WORKER_SECRET or pass --secret-file.";
+        return false;
+    }
+
+    struct sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons (uint16_t (port_));
+
+    if (inet_pton (AF_INET, bind_address_.c_str(), &address.sin_addr) != 1) {
+        LERROR << "Invalid worker bind address: " << bind_address_;
+        return false;
+    }
+
+    listen_fd_ = socket (AF_INET, SOCK_STREAM, 0);
+
+    if (listen_fd_ == -1) {
+        LERROR << "Cannot create worker socket.";
+        return false;
+    }
+
+    int enable = 1;
+    setsockopt (listen_fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof (enable));
+
+    if (bind (listen_fd_, reinterpret_cast<struct sockaddr*> (&address), sizeof (address)) == -1) {
+        LERROR << "Cannot bind worker to " << bind_address_ << ":" << port_;
+        return false;
+    }
+
+    if (listen (listen_fd_, SOMAXCONN) == -1) {
+        LERROR << "Cannot listen on port: " << port_;
+        return false;
+    }
+
+    LINFO << "Worker listening on " << bind_address_ << ":" << port_;
+
+    struct pollfd pfd{listen_fd_, POLLIN, 0};
+
+    while (!terminate_.load()) {
+        // reap finished sessions.
+        while (waitpid (-1, nullptr, WNOHANG) > 0);
+
+        auto ret = poll (&pfd, 1, 200);
+
+        if (ret <= 0 || !(pfd.revents & POLLIN)) {
+            continue;
+        }
+
+        int fd = accept (listen_fd_, nullptr, nullptr);
+
+        if (fd == -1) {
+            continue;
+        }
+
+        pid_t pid = fork();
+
+        if (pid == 0) {
+            close (listen_fd_);
+            auto stat = serve_ (fd);
+            close (fd);
+            ::_exit (stat ? 0 : 1);
+        }
+
+        LERROR_IF (pid == -1) << "Cannot fork worker session.";
+        close (fd);
+    }
+
+    close (listen_fd_);
+    listen_fd_ = -1;
+
+    while (waitpid (-1, nullptr, 0) > 0);
+
+    LINFO << "Worker stopped.";
+
+    return true;
+#endif
+} // Worker::Run
+
+
+bool
+Worker::serve_ (int fd)
+{
+#ifdef _WIN32
+    return false;
+#else
+    int enable = 1;
+    setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof (enable));
+
+    std::shared_ptr<CommandLineNode> node;
+    string buffer;
+    vector<string> lines;
+    size_t processed = 0;
+    bool stat = true;
+    bool done = false;
+
+    char temp[] = "/tmp/daisy-worker-XXXXXX";
+    string sandbox = mkdtemp (temp) ? temp : "/tmp";
+    setenv ("SANDBOX", sandbox.c_str(), true);
+
+    while (!done && m_recv_lines (fd, buffer, lines)) {
+        for (const auto& line : lines) {
+            if (line.size() < 1) {
+                continue;
+            }
+
+            if (line[0] == 'H') {
+                // header: the command line node to run and the run's environment.
+                try {
+                    auto header = json::parse (line.substr (2));
+
+                    if (!header.count ("secret") || !header["secret"].is_string()
+                        || !m_same_secret (secret_, header["secret"].get<string>())) {
+                        LWARN << "Worker session rejected: wrong or missing secret.";
+                        done = true;
+                        stat = false;
+                        break;
+                    }
+
+                    node = std::make_shared<CommandLineNode>();
+                    node->Initialize (header["node"], true);
+                    node->set_environment (header["env"]);
+                    LINFO << "Worker session: " << node->name();
+                }
+                catch (const std::exception& e) {
+                    LERROR << "Invalid worker header: " << e.what();
+                    done = true;
+                    stat = false;
+                    break;
+                }
+            }
+            else if (node == nullptr) {
+                // nothing runs before a session has been let in.
+                LWARN << "Worker session rejected: no header.";
+                done = true;
+                stat = false;
+                break;
+            }
+            else if (line[0] == 'T') {
+                // T <seq> <token>
+                auto space = line.find (' ', 2);
+                if (space == string::npos) {
+                    continue;
+                }
+
+                auto seq = line.substr (2, space - 2);
+                vector<string> outputs;
+                bool ok = node->Process (line.substr (space + 1), outputs);
+
+                string reply;
+                for (const auto& output : outputs) {
+                    reply += "R " + seq + " " + output + "\n";
+                }
+                reply += "A " + seq + (ok ? " 1\n" : " 0\n");
+
+                if (!m_send_all (fd, reply)) {
+                    done = true;
+                    stat = false;
+                    break;
+                }
+
+                stat = stat && ok;
+                ++processed;
+            }
+            else if (line[0] == 'E') {
+                done = true;
+                break;
+            }
+        }
+
+        lines.clear();
+    }
+
+    std::error_code ec;
+    if (sandbox != "/tmp") {
+        fs::remove_all (sandbox, ec);
+    }
+
+    LINFO << "Worker session finished: " << processed << " tokens.";
+
+    return stat;
+#endif
+} // Worker::serve_
+} // namespace daisychain
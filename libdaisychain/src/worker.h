@@ -0,0 +1,172 @@
+// MIT License
+// Copyright (c) 2025 Stephen J. Parker
+// SPDX-License-Identifier: MIT
+// See LICENSE file for full license text.
+
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+#include "logger.h"
+
+
+namespace daisychain {
+using namespace std;
+
+static constexpr int DAISY_WORKER_PORT = 7433;
+
+// longest protocol line either side buffers; a peer sending more without a newline is dropped,
+// so a connection cannot grow memory before its secret has been checked.
+static constexpr size_t DAISY_MAX_LINE = 1024 * 1024;
+
+
+// Agent started with `daisy --worker`. It accepts RemoteNode connections on a TCP port and
+// runs each connection's command line for the tokens it receives, in a process of its own
+// (the same fork-per-unit model used for graph nodes). See RemoteNode for the protocol.
+//
+// A session runs arbitrary commands, so the worker listens on the loopback address unless
+// told otherwise, and drops any connection whose header does not carry the shared secret
+// (see m_worker_secret). It will not start without one.
+class Worker
+{
+public:
+    explicit Worker (int port = DAISY_WORKER_PORT, const string& bind_address = "127.0.0.1", const string& secret = "");
+
+    ~Worker();
+
+    bool Run();
+
+    void Stop() { terminate_.store (true); }
+
+    [[nodiscard]] int port() const { return port_; }
+
+    [[nodiscard]] string bind_address() const { return bind_address_; }
+
+private:
+    bool serve_ (int fd);
+
+    int port_;
+    string bind_address_;
+    string secret_;
+    int listen_fd_;
+    std::atomic<bool> terminate_;
+};
+
+
+// the secret shared by workers and remote nodes: the contents of file when one is given, else
+// $DAISY_WORKER_SECRET, else the contents of $DAISY_WORKER_SECRET_FILE. Empty if there is none.
+inline string
+m_worker_secret (const string& file = "")
+{
+    auto read = [] (const string& path) {
+        std::ifstream stream (path);
+        string secret;
+        std::getline (stream, secret);
+
+        while (!secret.empty() && (secret.back() == '\r' || secret.back() == ' ')) {
+            secret.pop_back();
+        }
+
+        return secret;
+    };
+
+    if (!file.empty()) {
+        return read (file);
+    }
+
+    if (const char* secret = std::getenv ("DAISY_WORKER_SECRET"); secret != nullptr && *secret) {
+        return secret;
+    }
+
+    if (const char* path = std::getenv ("DAISY_WORKER_SECRET_FILE"); path != nullptr && *path) {
+        return read (path);
+    }
+
+    return "";
+} // m_worker_secret
+
+
+// compares secrets in time that does not depend on where they differ.
+inline bool
+m_same_secret (const string& a, const string& b)
+{
+    unsigned char diff = a.size() == b.size() ? 0 : 1;
+
+    for (size_t i = 0; i < a.size(); ++i) {
+        diff |= (unsigned char) (a[i] ^ (i < b.size() ? b[i] : 0));
+    }
+
+    return diff == 0 && !a.empty();
+} // m_same_secret
+
+
+#ifndef _WIN32
+// writes a whole message, retrying short writes.
+inline bool
+m_send_all (int fd, const string& message)
+{
+    size_t sent = 0;
+
+    while (sent < message.size()) {
+        auto numbytes = write (fd, message.data() + sent, message.size() - sent);
+
+        if (numbytes == -1 && errno == EINTR) {
+            continue;
+        }
+        if (numbytes <= 0) {
+            return false;
+        }
+
+        sent += size_t (numbytes);
+    }
+
+    return true;
+} // m_send_all
+
+
+// reads what is available and moves complete lines from buffer to lines; false on EOF/error
+// or when the unfinished line is longer than DAISY_MAX_LINE.
+inline bool
+m_recv_lines (int fd, string& buffer, vector<string>& lines)
+{
+    char cbuffer[8192];
+    ssize_t numbytes;
+
+    do {
+        numbytes = read (fd, cbuffer, sizeof (cbuffer));
+    } while (numbytes == -1 && errno == EINTR);
+
+    if (numbytes <= 0) {
+        return false;
+    }
+
+    buffer.append (cbuffer, size_t (numbytes));
+
+    size_t start = 0;
+    size_t end;
+
+    while ((end = buffer.find ('\n', start)) != string::npos) {
+        lines.emplace_back (buffer, start, end - start);
+        start = end + 1;
+    }
+
+    buffer.erase (0, start);
+
+    if (buffer.size() > DAISY_MAX_LINE) {
+        LWARN << "Line longer than " << DAISY_MAX_LINE << " bytes, closing connection.";
+        buffer.clear();
+        return false;
+    }
+
+    return true;
+} // m_recv_lines
+#endif
+} // namespace daisychain
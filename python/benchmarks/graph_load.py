@@ -0,0 +1,117 @@
+# MIT License
+# Copyright (c) 2025 Stephen J. Parker
+# SPDX-License-Identifier: MIT
+# See LICENSE file for full license text.
+
+"""Graph load-time benchmark.
+
+Generates a graph of N command line nodes, a chain plus a few cross edges, and times:
+  - loading it from a .dcg file (Graph.Parse connects everything as one batch),
+  - building it in Python and connecting every edge with one bulk Connect,
+  - the same with one Connect call per edge (--per-edge; each call searches from the child),
+  - rejecting a cycle-closing edge inside a bulk Connect.
+
+Usage: python3 graph_load.py [--nodes 10000] [--per-edge] [--repeat 3]
+pydaisychain must be importable (PYTHONPATH pointing at the built module).
+"""
+
+import argparse
+import json
+import os
+import tempfile
+import time
+import uuid
+
+import pydaisychain as dc
+
+
+def make_graph (count):
+    ids = [str (uuid.uuid4()) for _ in range (count)]
+    nodes = {
+        id: {"type": "command", "name": "n%d" % i, "command": "true", "batch": False}
+        for i, id in enumerate (ids)
+    }
+    edges = [(ids[i], ids[i + 1]) for i in range (count - 1)]
+    # forward skips keep the graph acyclic but give the cycle check more than a line to walk.
+    edges += [(ids[i], ids[i + 7]) for i in range (0, count - 7, 13)]
+
+    return ids, nodes, edges
+
+
+def timed (label, repeat, fn):
+    best = None
+
+    for _ in range (repeat):
+        start = time.perf_counter()
+        result = fn()
+        elapsed = time.perf_counter() - start
+        best = elapsed if best is None else min (best, elapsed)
+
+    print ("%-28s %8.3f s" % (label, best))
+    return result
+
+
+def build (nodes):
+    graph = dc.Graph()
+
+    for id, data in nodes.items():
+        node = graph.CreateNode ({id: data}, True)
+        graph.AddNode (node)
+
+    return graph
+
+
+def main():
+    parser = argparse.ArgumentParser (description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument ("--nodes", type=int, default=10000)
+    parser.add_argument ("--repeat", type=int, default=3)
+    parser.add_argument ("--per-edge", action="store_true", help="also time one Connect call per edge")
+    args = parser.parse_args()
+
+    dc.configureLogger ("off")
+
+    ids, nodes, edges = make_graph (args.nodes)
+    print ("%d nodes, %d edges" % (len (nodes), len (edges)))
+
+    with tempfile.TemporaryDirectory() as tmp:
+        path = os.path.join (tmp, "bench.dcg")
+
+        with open (path, "w") as file:
+            json.dump ({"nodes": nodes, "connections": [list (edge) for edge in edges],
+                        "environment": {}, "notes": {}}, file)
+
+        def load():
+            graph = dc.Graph()
+            graph.Initialize (path)
+            return graph
+
+        graph = timed ("load .dcg", args.repeat, load)
+        assert len (graph.edges()) == len (edges), "load dropped edges"
+
+    def bulk():
+        graph = build (nodes)
+        assert graph.Connect (edges)
+        return graph
+
+    timed ("build + bulk Connect", args.repeat, bulk)
+
+    if args.per_edge:
+        def per_edge():
+            graph = build (nodes)
+            for parent, child in edges:
+                graph.Connect (parent, child)
+            return graph
+
+        timed ("build + Connect per edge", 1, per_edge)
+
+    def cycle():
+        graph = build (nodes)
+        ok = graph.Connect (edges + [(ids[-1], ids[0])])
+        assert not ok and len (graph.edges()) == len (edges), "cycle-closing edge was not rejected"
+        return graph
+
+    timed ("bulk Connect with a cycle", args.repeat, cycle)
+
+
+if __name__ == "__main__":
+    main()
@@ -14,6 +14,19 @@ using json = nlohmann::ordered_json;
 namespace py = pybind11;
 
 
+static py::dict
+event_dict (const NodeEvent& event)
+{
+    py::dict item;
+    item["state"] = NodeStateNameByType[event.state];
+    item["node"] = string (event.node);
+    item["tokens_in"] = event.tokens_in;
+    item["tokens_out"] = event.tokens_out;
+
+    return item;
+} // event_dict
+
+
 class PyNode : public Node
 {
     using Node::Node;
@@ -51,11 +64,24 @@ PYBIND11_MODULE (pydaisychain, m) {
         .def ("Serialize", &Graph::Serialize)
         .def ("Parse", &Graph::Parse)
         .def ("Save", &Graph::Save, "", py::arg ("filename") = "")
-        .def ("PrepareFileSystem", &Graph::PrepareFileSystem)
+        .def ("PrepareFileSystem", py::overload_cast<> (&Graph::PrepareFileSystem))
+        .def ("PrepareFileSystem", py::overload_cast<ExecutionContext&> (&Graph::PrepareFileSystem))
+        .def ("CreateContext", &Graph::CreateContext)
         .def ("Execute", static_cast<bool (Graph::*)()> (&Graph::Execute))
         .def ("Execute", py::overload_cast<const string&> (&Graph::Execute))
         .def ("Execute", py::overload_cast<const string&, json&> (&Graph::Execute))
+        .def ("Execute", py::overload_cast<ExecutionContext&> (&Graph::Execute),
+              py::call_guard<py::gil_scoped_release>())
         .def ("Execute", py::overload_cast<const string&, const string&> (&Graph::Execute))
+        .def ("ExecuteAsync", [] (Graph& graph, const string& input, json& env) {
+            // dropping the handle joins the run's threads, and a Python callback on them needs
+            // the GIL, so the last reference lets go of it while the handle is destroyed.
+            auto handle = graph.ExecuteAsync (input, env);
+            return std::shared_ptr<ExecutionHandle> (handle.get(), [handle] (ExecutionHandle*) mutable {
+                py::gil_scoped_release release;
+                handle.reset();
+            });
+        }, "", py::arg ("input") = "", py::arg ("env") = json::object(), py::keep_alive<0, 1>())
         .def ("Test", &Graph::Test)
         .def ("Terminate", &Graph::Terminate)
         .def ("Cleanup", &Graph::Cleanup)
@@ -63,7 +89,8 @@ PYBIND11_MODULE (pydaisychain, m) {
         .def ("CreateNode", &Graph::CreateNode)
         .def ("AddNode", &Graph::AddNode, py::keep_alive<1,2>())
         .def ("RemoveNode", &Graph::RemoveNode)
-        .def ("Connect", &Graph::Connect)
+        .def ("Connect", py::overload_cast<const string&, const string&> (&Graph::Connect))
+        .def ("Connect", py::overload_cast<const list<Edge>&> (&Graph::Connect))
         .def ("Disconnect", &Graph::Disconnect)
         .def ("get_node", &Graph::get_node)
         .def ("set_filename", &Graph::set_filename)
@@ -85,6 +112,74 @@ PYBIND11_MODULE (pydaisychain, m) {
         .def ("edges", &Graph::edges)
         ;
 
+    py::class_<ExecutionContext, std::shared_ptr<ExecutionContext>> (m, "ExecutionContext")
+        .def (py::init<>())
+        .def ("Cancel", &ExecutionContext::Cancel)
+        .def ("Terminate", &ExecutionContext::Terminate)
+        .def ("Cleanup", &ExecutionContext::Cleanup)
+        .def ("id", &ExecutionContext::id)
+        .def ("set_sandbox", &ExecutionContext::set_sandbox, "", py::arg ("sandbox"), py::arg ("owned") = false)
+        .def ("sandbox", &ExecutionContext::sandbox)
+        .def ("logfile", &ExecutionContext::logfile)
+        .def ("set_input", &ExecutionContext::set_input)
+        .def ("input", &ExecutionContext::input)
+        .def ("set_environment", &ExecutionContext::set_environment)
+        .def ("environment", &ExecutionContext::environment)
+        .def ("set_test_flag", &ExecutionContext::set_test_flag)
+        .def ("test_flag", &ExecutionContext::test_flag)
+        .def ("set_cleanup_flag", &ExecutionContext::set_cleanup_flag)
+        .def ("cleanup_flag", &ExecutionContext::cleanup_flag)
+        .def ("running", &ExecutionContext::running)
+        .def ("nodes_started", &ExecutionContext::nodes_started)
+        .def ("nodes_finished", &ExecutionContext::nodes_finished)
+        .def ("nodes_failed", &ExecutionContext::nodes_failed)
+        ;
+
+    // waiting releases the GIL so other Python threads keep running while a graph executes.
+    py::class_<ExecutionHandle, std::shared_ptr<ExecutionHandle>> (m, "ExecutionHandle")
+        .def ("wait", &ExecutionHandle::wait, py::call_guard<py::gil_scoped_release>())
+        .def ("wait_for", &ExecutionHandle::wait_for, py::call_guard<py::gil_scoped_release>())
+        .def ("done", &ExecutionHandle::done)
+        .def ("result", &ExecutionHandle::result, py::call_guard<py::gil_scoped_release>())
+        .def ("cancel", &ExecutionHandle::cancel)
+        .def ("cancelled", &ExecutionHandle::cancelled)
+        .def ("terminate", &ExecutionHandle::terminate)
+        .def ("dropped_events", &ExecutionHandle::dropped_events)
+        .def ("context", &ExecutionHandle::context)
+        .def ("events", [] (ExecutionHandle& handle) {
+            py::list events;
+            for (const auto& event : handle.events()) {
+                events.append (event_dict (event));
+            }
+            return events;
+        })
+        // the callback runs on the handle's collector thread with the GIL held; None removes it.
+        .def ("set_callback", [] (ExecutionHandle& handle, py::object callback) {
+            ExecutionHandle::Callback wrapper;
+
+            if (!callback.is_none()) {
+                // the Python function may only be touched, and released, with the GIL held.
+                std::shared_ptr<py::object> function (new py::object (std::move (callback)), [] (py::object* function) {
+                    py::gil_scoped_acquire acquire;
+                    delete function;
+                });
+
+                wrapper = [function] (const NodeEvent& event) {
+                    py::gil_scoped_acquire acquire;
+                    try {
+                        (*function) (event_dict (event));
+                    }
+                    catch (py::error_already_set& e) {
+                        e.discard_as_unraisable ("ExecutionHandle callback");
+                    }
+                };
+            }
+
+            py::gil_scoped_release release;
+            handle.set_callback (std::move (wrapper));
+        }, py::arg ("callback"))
+        ;
+
     py::enum_<DaisyNodeType> (m, "DaisyNodeType")
         .value ("DC_INVALID", DaisyNodeType::DC_INVALID)
         .value ("DC_COMMANDLINE", DaisyNodeType::DC_COMMANDLINE)
@@ -94,6 +189,15 @@ PYBIND11_MODULE (pydaisychain, m) {
         .value ("DC_DISTRO", DaisyNodeType::DC_DISTRO)
         .value ("DC_FILELIST", DaisyNodeType::DC_FILELIST)
         .value ("DC_WATCHNODE", DaisyNodeType::DC_WATCH)
+        .value ("DC_SUBGRAPH", DaisyNodeType::DC_SUBGRAPH)
+        .value ("DC_ROUTER", DaisyNodeType::DC_ROUTER)
+        .value ("DC_DIRSCAN", DaisyNodeType::DC_DIRSCAN)
+        .value ("DC_DEDUP", DaisyNodeType::DC_DEDUP)
+        .value ("DC_THROTTLE", DaisyNodeType::DC_THROTTLE)
+        .value ("DC_WINDOW", DaisyNodeType::DC_WINDOW)
+        .value ("DC_GROUPBY", DaisyNodeType::DC_GROUPBY)
+        .value ("DC_JOIN", DaisyNodeType::DC_JOIN)
+        .value ("DC_SPLIT", DaisyNodeType::DC_SPLIT)
         .export_values()
         ;
 
@@ -113,6 +217,7 @@ PYBIND11_MODULE (pydaisychain, m) {
         .def ("CloseInputs", &Node::CloseInputs)
         .def ("OpenOutputs", &Node::OpenOutputs)
         .def ("WriteOutputs", &Node::WriteOutputs)
+        .def ("WriteSelectedOutputs", &Node::WriteSelectedOutputs)
         .def ("CloseOutputs", &Node::CloseOutputs)
         .def ("Cleanup", &Node::Cleanup)
         .def ("type", &Node::type)
@@ -128,6 +233,9 @@ PYBIND11_MODULE (pydaisychain, m) {
         .def ("is_root", &Node::is_root)
         .def ("set_batch_flag", &Node::set_batch_flag)
         .def ("batch_flag", &Node::batch_flag)
+        .def ("set_batch_memory", &Node::set_batch_memory)
+        .def ("batch_memory", &Node::batch_memory)
+        .def ("batchfile", &Node::batchfile)
         .def ("set_test_flag", &Node::set_test_flag)
         .def ("test_flag", &Node::test_flag)
         .def ("set_outputfile", &Node::set_outputfile)
@@ -145,6 +253,34 @@ PYBIND11_MODULE (pydaisychain, m) {
         .def ("Serialize", &CommandLineNode::Serialize)
         .def ("set_command", &CommandLineNode::set_command)
         .def ("command", &CommandLineNode::command)
+        .def ("set_batch_input", &CommandLineNode::set_batch_input)
+        .def ("batch_input", &CommandLineNode::batch_input)
+        .def ("set_attributes", &CommandLineNode::set_attributes)
+        .def ("attributes", &CommandLineNode::attributes)
+        ;
+
+    py::class_<RemoteNode, Node, std::shared_ptr<RemoteNode>> (m, "RemoteNode")
+        .def (py::init<>())
+        .def ("Execute", py::overload_cast<vector<string>&, const string&, json&> (&RemoteNode::Execute))
+        .def ("Initialize", &RemoteNode::Initialize)
+        .def ("Serialize", &RemoteNode::Serialize)
+        .def ("set_host_id", &RemoteNode::set_host_id)
+        .def ("host_id", &RemoteNode::host_id)
+        .def ("set_command", &RemoteNode::set_command)
+        .def ("command", &RemoteNode::command)
+        .def ("set_window", &RemoteNode::set_window)
+        .def ("window", &RemoteNode::window)
+        .def ("set_secret_file", &RemoteNode::set_secret_file)
+        .def ("secret_file", &RemoteNode::secret_file)
+        ;
+
+    py::class_<Worker> (m, "Worker")
+        .def (py::init<int, const string&, const string&>(), py::arg ("port") = DAISY_WORKER_PORT,
+              py::arg ("bind_address") = "127.0.0.1", py::arg ("secret") = "")
+        .def ("Run", &Worker::Run, py::call_guard<py::gil_scoped_release>())
+        .def ("Stop", &Worker::Stop)
+        .def ("port", &Worker::port)
+        .def ("bind_address", &Worker::bind_address)
         ;
 
     py::class_<FilterNode, Node, std::shared_ptr<FilterNode>> (m, "FilterNode")
@@ -159,6 +295,121 @@ PYBIND11_MODULE (pydaisychain, m) {
         .def ("regex", &FilterNode::regex)
         .def ("set_invert", &FilterNode::set_invert)
         .def ("negate", &FilterNode::invert)
+        .def ("set_cache_size", &FilterNode::set_cache_size)
+        .def ("cache_size", &FilterNode::cache_size)
+        ;
+
+    py::class_<RouterRule> (m, "RouterRule")
+        .def (py::init<>())
+        .def_readwrite ("pattern", &RouterRule::pattern)
+        .def_readwrite ("regex", &RouterRule::regex)
+        .def_readwrite ("port", &RouterRule::port)
+        ;
+
+    py::class_<RouterNode, Node, std::shared_ptr<RouterNode>> (m, "RouterNode")
+        .def (py::init<>())
+        .def ("Execute", py::overload_cast<vector<string>&, const string&, json&> (&RouterNode::Execute))
+        .def ("Initialize", &RouterNode::Initialize)
+        .def ("Serialize", &RouterNode::Serialize)
+        .def ("AddRule", &RouterNode::AddRule)
+        .def ("set_rules", &RouterNode::set_rules)
+        .def ("rules", &RouterNode::rules)
+        .def ("set_match_all", &RouterNode::set_match_all)
+        .def ("match_all", &RouterNode::match_all)
+        .def ("set_default_port", &RouterNode::set_default_port)
+        .def ("default_port", &RouterNode::default_port)
+        ;
+
+    py::class_<DedupNode, Node, std::shared_ptr<DedupNode>> (m, "DedupNode")
+        .def (py::init<>())
+        .def ("Execute", py::overload_cast<vector<string>&, const string&, json&> (&DedupNode::Execute))
+        .def ("Initialize", &DedupNode::Initialize)
+        .def ("Serialize", &DedupNode::Serialize)
+        .def ("set_mode", &DedupNode::set_mode)
+        .def ("mode", &DedupNode::mode)
+        .def ("set_window", &DedupNode::set_window)
+        .def ("window", &DedupNode::window)
+        .def ("set_capacity", &DedupNode::set_capacity)
+        .def ("capacity", &DedupNode::capacity)
+        .def ("set_memory", &DedupNode::set_memory)
+        .def ("memory", &DedupNode::memory)
+        ;
+
+    py::class_<ThrottleNode, Node, std::shared_ptr<ThrottleNode>> (m, "ThrottleNode")
+        .def (py::init<>())
+        .def ("Execute", py::overload_cast<vector<string>&, const string&, json&> (&ThrottleNode::Execute))
+        .def ("Initialize", &ThrottleNode::Initialize)
+        .def ("Serialize", &ThrottleNode::Serialize)
+        .def ("set_rate", &ThrottleNode::set_rate)
+        .def ("rate", &ThrottleNode::rate)
+        .def ("set_burst", &ThrottleNode::set_burst)
+        .def ("burst", &ThrottleNode::burst)
+        ;
+
+    py::class_<WindowNode, Node, std::shared_ptr<WindowNode>> (m, "WindowNode")
+        .def (py::init<>())
+        .def ("Execute", py::overload_cast<vector<string>&, const string&, json&> (&WindowNode::Execute))
+        .def ("Initialize", &WindowNode::Initialize)
+        .def ("Serialize", &WindowNode::Serialize)
+        .def ("set_count", &WindowNode::set_count)
+        .def ("count", &WindowNode::count)
+        .def ("set_bytes", &WindowNode::set_bytes)
+        .def ("bytes", &WindowNode::bytes)
+        .def ("set_interval", &WindowNode::set_interval)
+        .def ("interval", &WindowNode::interval)
+        ;
+
+    py::class_<GroupByNode, Node, std::shared_ptr<GroupByNode>> (m, "GroupByNode")
+        .def (py::init<>())
+        .def ("Execute", py::overload_cast<vector<string>&, const string&, json&> (&GroupByNode::Execute))
+        .def ("Initialize", &GroupByNode::Initialize)
+        .def ("Serialize", &GroupByNode::Serialize)
+        .def ("set_key", &GroupByNode::set_key)
+        .def ("key", &GroupByNode::key)
+        .def ("set_pattern", &GroupByNode::set_pattern)
+        .def ("pattern", &GroupByNode::pattern)
+        .def ("set_attribute", &GroupByNode::set_attribute)
+        .def ("attribute", &GroupByNode::attribute)
+        .def ("set_idle", &GroupByNode::set_idle)
+        .def ("idle", &GroupByNode::idle)
+        .def ("set_memory", &GroupByNode::set_memory)
+        .def ("memory", &GroupByNode::memory)
+        ;
+
+    py::class_<JoinNode, Node, std::shared_ptr<JoinNode>> (m, "JoinNode")
+        .def (py::init<>())
+        .def ("Execute", py::overload_cast<vector<string>&, const string&, json&> (&JoinNode::Execute))
+        .def ("Initialize", &JoinNode::Initialize)
+        .def ("Serialize", &JoinNode::Serialize)
+        .def ("set_left", &JoinNode::set_left)
+        .def ("left", &JoinNode::left)
+        .def ("set_right", &JoinNode::set_right)
+        .def ("right", &JoinNode::right)
+        .def ("set_regex", &JoinNode::set_regex)
+        .def ("regex", &JoinNode::regex)
+        .def ("set_key", &JoinNode::set_key)
+        .def ("key", &JoinNode::key)
+        .def ("set_pattern", &JoinNode::set_pattern)
+        .def ("pattern", &JoinNode::pattern)
+        .def ("set_attribute", &JoinNode::set_attribute)
+        .def ("attribute", &JoinNode::attribute)
+        .def ("set_memory", &JoinNode::set_memory)
+        .def ("memory", &JoinNode::memory)
+        ;
+
+    py::class_<SplitNode, Node, std::shared_ptr<SplitNode>> (m, "SplitNode")
+        .def (py::init<>())
+        .def ("Execute", py::overload_cast<vector<string>&, const string&, json&> (&SplitNode::Execute))
+        .def ("Initialize", &SplitNode::Initialize)
+        .def ("Serialize", &SplitNode::Serialize)
+        .def ("set_chunk_size", &SplitNode::set_chunk_size)
+        .def ("chunk_size", &SplitNode::chunk_size)
+        .def ("set_chunks", &SplitNode::set_chunks)
+        .def ("chunks", &SplitNode::chunks)
+        .def ("set_delimiter", &SplitNode::set_delimiter)
+        .def ("delimiter", &SplitNode::delimiter)
+        .def ("set_threads", &SplitNode::set_threads)
+        .def ("threads", &SplitNode::threads)
         ;
 
     py::class_<ConcatNode, Node, std::shared_ptr<ConcatNode>> (m, "ConcatNode")
@@ -176,6 +427,29 @@ PYBIND11_MODULE (pydaisychain, m) {
         .def ("Execute", py::overload_cast<vector<string>&, const string&, json&> (&FileListNode::Execute))
         ;
 
+    py::class_<DirScanNode, Node, std::shared_ptr<DirScanNode>> (m, "DirScanNode")
+        .def (py::init<>())
+        .def ("Execute", py::overload_cast<vector<string>&, const string&, json&> (&DirScanNode::Execute))
+        .def ("Initialize", &DirScanNode::Initialize)
+        .def ("Serialize", &DirScanNode::Serialize)
+        .def ("set_directory", &DirScanNode::set_directory)
+        .def ("directory", &DirScanNode::directory)
+        .def ("set_include", &DirScanNode::set_include)
+        .def ("include", &DirScanNode::include)
+        .def ("set_exclude", &DirScanNode::set_exclude)
+        .def ("exclude", &DirScanNode::exclude)
+        .def ("set_regex", &DirScanNode::set_regex)
+        .def ("regex", &DirScanNode::regex)
+        .def ("set_max_depth", &DirScanNode::set_max_depth)
+        .def ("max_depth", &DirScanNode::max_depth)
+        .def ("set_follow_symlinks", &DirScanNode::set_follow_symlinks)
+        .def ("follow_symlinks", &DirScanNode::follow_symlinks)
+        .def ("set_threads", &DirScanNode::set_threads)
+        .def ("threads", &DirScanNode::threads)
+        .def ("set_attributes", &DirScanNode::set_attributes)
+        .def ("attributes", &DirScanNode::attributes)
+        ;
+
     py::class_<WatchNode, Node, std::shared_ptr<WatchNode>> (m, "WatchNode")
         .def (py::init<>())
         .def ("Execute", py::overload_cast<vector<string>&, const string&, json&> (&WatchNode::Execute))
@@ -184,6 +458,38 @@ PYBIND11_MODULE (pydaisychain, m) {
         .def ("Cleanup", &WatchNode::Cleanup)
         .def ("passthru", &WatchNode::passthru)
         .def ("set_passthru", &WatchNode::set_passthru)
+        .def ("recursive", &WatchNode::recursive)
+        .def ("set_recursive", &WatchNode::set_recursive)
+        .def ("quiescence", &WatchNode::quiescence)
+        .def ("set_quiescence", &WatchNode::set_quiescence)
+        .def ("debounce", &WatchNode::debounce)
+        .def ("set_debounce", &WatchNode::set_debounce)
+        .def ("settle", &WatchNode::settle)
+        .def ("set_settle", &WatchNode::set_settle)
+        .def ("marker", &WatchNode::marker)
+        .def ("set_marker", &WatchNode::set_marker)
+        .def ("max_pending", &WatchNode::max_pending)
+        .def ("set_max_pending", &WatchNode::set_max_pending)
+        .def ("threads", &WatchNode::threads)
+        .def ("set_threads", &WatchNode::set_threads)
+        .def ("backend", &WatchNode::backend)
+        .def ("set_backend", &WatchNode::set_backend)
+        .def ("interval", &WatchNode::interval)
+        .def ("set_interval", &WatchNode::set_interval)
+        .def ("max_interval", &WatchNode::max_interval)
+        .def ("set_max_interval", &WatchNode::set_max_interval)
+        .def ("state", &WatchNode::state)
+        .def ("set_state", &WatchNode::set_state)
+        ;
+
+    py::class_<SubgraphNode, Node, std::shared_ptr<SubgraphNode>> (m, "SubgraphNode")
+        .def (py::init<>())
+        .def (py::init<const string&>())
+        .def ("Execute", py::overload_cast<vector<string>&, const string&, json&> (&SubgraphNode::Execute))
+        .def ("Initialize", &SubgraphNode::Initialize)
+        .def ("Serialize", &SubgraphNode::Serialize)
+        .def ("set_filename", &SubgraphNode::set_filename)
+        .def ("filename", &SubgraphNode::filename)
         ;
 }
 